@@ -0,0 +1,31 @@
+#include "parallel.h"
+#include "core/job_system.h"
+
+struct ParallelRunParams {
+  ParallelFunction* func;
+  void* params;
+  u32 taskCount;
+};
+
+static void parallelRunRange(void* ptr, u64 begin, u64 end) {
+  auto* run = (ParallelRunParams*)ptr;
+  for (u64 i = begin; i < end; ++i) {
+    run->func(run->params, (u32)i, run->taskCount);
+  }
+}
+
+void parallelRun(ParallelFunction* func, void* params, u32 taskCount) {
+  if (taskCount <= 1) {
+    func(params, 0, 1);
+    return;
+  }
+
+  ParallelRunParams run = { .func = func, .params = params, .taskCount = taskCount };
+  parallelFor(taskCount, 1, parallelRunRange, &run);
+}
+
+void parallelRange(u64 count, u32 taskIndex, u32 taskCount, u64 align, u64* begin, u64* end) {
+  u64 perTask = AlignPow2((count + taskCount - 1) / taskCount, align);
+  *begin = Min(perTask * taskIndex, count);
+  *end = Min(*begin + perTask, count);
+}
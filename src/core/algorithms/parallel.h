@@ -0,0 +1,16 @@
+#pragma once
+
+#include "core/core.h"
+
+// NOTE(piero): Fork/join for the multi-threaded algorithm variants, on the job system. parallelRun runs
+//              func(params, taskIndex, taskCount) for every index as jobs and returns once all of them ran,
+//              the calling thread runs jobs while it waits. Tasks may run one after another on the same worker,
+//              so they must never wait on each other: algorithms split into phases, one parallelRun each, with
+//              whatever combines the phases run on the calling thread in between.
+using ParallelFunction = void(void* params, u32 taskIndex, u32 taskCount);
+
+void parallelRun(ParallelFunction* func, void* params, u32 taskCount);
+
+// Splits [0, count) into taskCount contiguous ranges. Range starts are multiples of `align` so SIMD loops only
+// have a scalar tail on the last range.
+void parallelRange(u64 count, u32 taskIndex, u32 taskCount, u64 align, u64* begin, u64* end);
@@ -0,0 +1,201 @@
+#include "radix_sort.h"
+#include "parallel.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+template <typename K>
+static u32 radixDigit(K key, u32 pass) {
+  return (u32)(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+}
+
+template <typename K>
+static void radixInsertionSort(K* keys, u32* values, u64 count) {
+  for (u64 i = 1; i < count; ++i) {
+    K key = keys[i];
+    u32 value = values ? values[i] : 0;
+    u64 j = i;
+    while (j > 0 && keys[j - 1] > key) {
+      keys[j] = keys[j - 1];
+      if (values) {
+        values[j] = values[j - 1];
+      }
+      j -= 1;
+    }
+    keys[j] = key;
+    if (values) {
+      values[j] = value;
+    }
+  }
+}
+
+template <typename K>
+static void radixScatter(const K* srcKeys, const u32* srcValues, K* dstKeys, u32* dstValues, u64 begin, u64 end, u32 pass, u64* offsets) {
+  if (srcValues) {
+    for (u64 i = begin; i < end; ++i) {
+      u64 dest = offsets[radixDigit(srcKeys[i], pass)]++;
+      dstKeys[dest] = srcKeys[i];
+      dstValues[dest] = srcValues[i];
+    }
+  } else {
+    for (u64 i = begin; i < end; ++i) {
+      u64 dest = offsets[radixDigit(srcKeys[i], pass)]++;
+      dstKeys[dest] = srcKeys[i];
+    }
+  }
+}
+
+template <typename K>
+static void radixSortSerial(K* keys, u32* values, u64 count) {
+  if (count <= RADIX_SORT_SMALL_COUNT) {
+    radixInsertionSort(keys, values, count);
+    return;
+  }
+
+  constexpr u32 passCount = sizeof(K);
+  Temp scratch = ScratchBegin();
+  u64(*histograms)[RADIX_BUCKETS] = (u64(*)[RADIX_BUCKETS])PushArray(scratch.arena, u64, passCount * RADIX_BUCKETS);
+
+  for (u64 i = 0; i < count; ++i) {
+    K key = keys[i];
+    for (u32 pass = 0; pass < passCount; ++pass) {
+      histograms[pass][radixDigit(key, pass)] += 1;
+    }
+  }
+
+  K* buffers[2] = { keys, PushArrayNoZeroAligned(scratch.arena, K, count, CACHE_LINE_SIZE) };
+  u32* valueBuffers[2] = { values, values ? PushArrayNoZeroAligned(scratch.arena, u32, count, CACHE_LINE_SIZE) : nullptr };
+  u32 src = 0;
+
+  for (u32 pass = 0; pass < passCount; ++pass) {
+    u64* histogram = histograms[pass];
+    // Histograms count the whole input, which every pass only permutes, so any key tells the digit they share
+    if (histogram[radixDigit(buffers[src][0], pass)] == count) {
+      continue;
+    }
+
+    u64 offsets[RADIX_BUCKETS];
+    u64 running = 0;
+    for (u32 digit = 0; digit < RADIX_BUCKETS; ++digit) {
+      offsets[digit] = running;
+      running += histogram[digit];
+    }
+
+    radixScatter(buffers[src], valueBuffers[src], buffers[src ^ 1], valueBuffers[src ^ 1], 0, count, pass, offsets);
+    src ^= 1;
+  }
+
+  if (src != 0) {
+    MemoryCopy(keys, buffers[1], sizeof(K) * count);
+    if (values) {
+      MemoryCopy(values, valueBuffers[1], sizeof(u32) * count);
+    }
+  }
+  ScratchEnd(scratch);
+}
+
+template <typename K>
+struct RadixSortParallelParams {
+  K* buffers[2];
+  u32* valueBuffers[2];
+  u64 count;
+  // taskCount rows of RADIX_BUCKETS counts, turned into that task's scatter offsets
+  u64 (*histograms)[RADIX_BUCKETS];
+  u32 pass;
+  u32 src;
+};
+
+template <typename K>
+static void radixSortParallelHistogram(void* ptr, u32 taskIndex, u32 taskCount) {
+  auto* params = (RadixSortParallelParams<K>*)ptr;
+  u64 begin, end;
+  parallelRange(params->count, taskIndex, taskCount, 1, &begin, &end);
+
+  K* keys = params->buffers[params->src];
+  u64* histogram = params->histograms[taskIndex];
+  MemoryZero(histogram, sizeof(u64) * RADIX_BUCKETS);
+  for (u64 i = begin; i < end; ++i) {
+    histogram[radixDigit(keys[i], params->pass)] += 1;
+  }
+}
+
+template <typename K>
+static void radixSortParallelScatter(void* ptr, u32 taskIndex, u32 taskCount) {
+  auto* params = (RadixSortParallelParams<K>*)ptr;
+  u64 begin, end;
+  parallelRange(params->count, taskIndex, taskCount, 1, &begin, &end);
+
+  u32 src = params->src;
+  radixScatter(params->buffers[src], params->valueBuffers[src], params->buffers[src ^ 1], params->valueBuffers[src ^ 1], begin, end, params->pass, params->histograms[taskIndex]);
+}
+
+// Every pass is two parallelRun phases, histograms then scatter. Offsets are computed in between on this thread.
+template <typename K>
+static void radixSortParallel(K* keys, u32* values, u64 count, u32 threadCount) {
+  if (threadCount <= 1 || count < RADIX_SORT_PARALLEL_MIN_COUNT) {
+    radixSortSerial(keys, values, count);
+    return;
+  }
+
+  Temp scratch = ScratchBegin();
+  auto* params = PushStruct(scratch.arena, RadixSortParallelParams<K>);
+  params->buffers[0] = keys;
+  params->buffers[1] = PushArrayNoZeroAligned(scratch.arena, K, count, CACHE_LINE_SIZE);
+  params->valueBuffers[0] = values;
+  params->valueBuffers[1] = values ? PushArrayNoZeroAligned(scratch.arena, u32, count, CACHE_LINE_SIZE) : nullptr;
+  params->count = count;
+  params->histograms = (u64(*)[RADIX_BUCKETS])PushArrayAligned(scratch.arena, u64, threadCount * RADIX_BUCKETS, CACHE_LINE_SIZE);
+
+  for (u32 pass = 0; pass < sizeof(K); ++pass) {
+    params->pass = pass;
+    parallelRun(radixSortParallelHistogram<K>, params, threadCount);
+
+    b32 skipPass = false;
+    for (u32 digit = 0; digit < RADIX_BUCKETS && !skipPass; ++digit) {
+      u64 total = 0;
+      for (u32 t = 0; t < threadCount; ++t) {
+        total += params->histograms[t][digit];
+      }
+      skipPass = total == count;
+    }
+    if (skipPass) {
+      continue;
+    }
+
+    u64 running = 0;
+    for (u32 digit = 0; digit < RADIX_BUCKETS; ++digit) {
+      for (u32 t = 0; t < threadCount; ++t) {
+        u64 digitCount = params->histograms[t][digit];
+        params->histograms[t][digit] = running;
+        running += digitCount;
+      }
+    }
+
+    parallelRun(radixSortParallelScatter<K>, params, threadCount);
+    params->src ^= 1;
+  }
+
+  if (params->src != 0) {
+    MemoryCopy(keys, params->buffers[1], sizeof(K) * count);
+    if (values) {
+      MemoryCopy(values, params->valueBuffers[1], sizeof(u32) * count);
+    }
+  }
+  ScratchEnd(scratch);
+}
+
+void radixSortU32(u32* keys, u32* values, u64 count) {
+  radixSortSerial(keys, values, count);
+}
+
+void radixSortU64(u64* keys, u32* values, u64 count) {
+  radixSortSerial(keys, values, count);
+}
+
+void radixSortU32Parallel(u32* keys, u32* values, u64 count, u32 threadCount) {
+  radixSortParallel(keys, values, count, threadCount);
+}
+
+void radixSortU64Parallel(u64* keys, u32* values, u64 count, u32 threadCount) {
+  radixSortParallel(keys, values, count, threadCount);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "core/core.h"
+
+// NOTE(piero): LSD radix sort, 8 bits per pass, ascending and stable. `values` is an optional u32 payload moved
+//              along with its key (usually an index into the array the keys were built from), pass nullptr to
+//              sort keys only. The ping-pong buffers come from the calling thread's scratch arena.
+//              A single read pass builds the histograms of every digit up front, and digits where all keys agree
+//              are skipped, so keys that only use their low bits (draw keys, small indices) cost fewer passes.
+//              Float keys need to be mapped to order-preserving integers first (radixKeyFromF32).
+
+// Inputs this small use insertion sort
+#define RADIX_SORT_SMALL_COUNT 64
+// Parallel variants fall back to the single threaded sort below this
+#define RADIX_SORT_PARALLEL_MIN_COUNT Kilobytes(64)
+
+void radixSortU32(u32* keys, u32* values, u64 count);
+void radixSortU64(u64* keys, u32* values, u64 count);
+
+// The keys are split into threadCount contiguous ranges, each histogrammed and scattered by its own job. Offsets
+// are laid out digit-major, range-minor, so the result is the same (stable) order as the single threaded sort.
+void radixSortU32Parallel(u32* keys, u32* values, u64 count, u32 threadCount);
+void radixSortU64Parallel(u64* keys, u32* values, u64 count, u32 threadCount);
+
+// Flips the sign bit of positives and every bit of negatives so unsigned order matches float order
+inline u32 radixKeyFromF32(f32 value) {
+  u32 bits;
+  MemoryCopy(&bits, &value, sizeof(bits));
+  u32 mask = (u32)(-(i32)(bits >> 31)) | 0x80000000u;
+  return bits ^ mask;
+}
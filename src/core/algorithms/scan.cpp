@@ -0,0 +1,236 @@
+#include "scan.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+
+// Prefix sum of the 4 lanes of x: log2(4) shifted adds
+static __m128i scanLanes(__m128i x) {
+  x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+  x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+  return x;
+}
+
+// Scans [0, count) starting from carry, returns carry plus the sum of in
+static u32 scanInclusiveFrom(const u32* in, u32* out, u64 count, u32 carry) {
+  u64 i = 0;
+  __m128i carryLanes = _mm_set1_epi32((i32)carry);
+  for (; i + 4 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i sum = _mm_add_epi32(scanLanes(x), carryLanes);
+    _mm_storeu_si128((__m128i*)(out + i), sum);
+    carryLanes = _mm_shuffle_epi32(sum, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+
+  carry = (u32)_mm_cvtsi128_si32(carryLanes);
+  for (; i < count; ++i) {
+    carry += in[i];
+    out[i] = carry;
+  }
+  return carry;
+}
+
+static u32 scanExclusiveFrom(const u32* in, u32* out, u64 count, u32 carry) {
+  u64 i = 0;
+  __m128i carryLanes = _mm_set1_epi32((i32)carry);
+  for (; i + 4 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i sum = _mm_add_epi32(scanLanes(x), carryLanes);
+    _mm_storeu_si128((__m128i*)(out + i), _mm_sub_epi32(sum, x));
+    carryLanes = _mm_shuffle_epi32(sum, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+
+  carry = (u32)_mm_cvtsi128_si32(carryLanes);
+  for (; i < count; ++i) {
+    u32 value = in[i];
+    out[i] = carry;
+    carry += value;
+  }
+  return carry;
+}
+
+static u32 sumU32(const u32* in, u64 count) {
+  u64 i = 0;
+  __m128i lanes = _mm_setzero_si128();
+  for (; i + 4 <= count; i += 4) {
+    lanes = _mm_add_epi32(lanes, _mm_loadu_si128((const __m128i*)(in + i)));
+  }
+  lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(1, 0, 3, 2)));
+  lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  u32 sum = (u32)_mm_cvtsi128_si32(lanes);
+  for (; i < count; ++i) {
+    sum += in[i];
+  }
+  return sum;
+}
+
+void scanInclusiveU32(const u32* in, u32* out, u64 count) {
+  scanInclusiveFrom(in, out, count, 0);
+}
+
+u32 scanExclusiveU32(const u32* in, u32* out, u64 count) {
+  return scanExclusiveFrom(in, out, count, 0);
+}
+
+// Keep mask of 16 flags, bit i set when keep[i] != 0
+static u32 compactMask(const u8* keep) {
+  __m128i flags = _mm_loadu_si128((const __m128i*)keep);
+  return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(flags, _mm_setzero_si128())) ^ 0xFFFF;
+}
+
+static u64 compactCount(const u8* keep, u64 begin, u64 end) {
+  u64 result = 0;
+  u64 i = begin;
+  for (; i + 16 <= end; i += 16) {
+    result += CountSetBits32(compactMask(keep + i));
+  }
+  for (; i < end; ++i) {
+    result += keep[i] != 0;
+  }
+  return result;
+}
+
+// Compacts [begin, end) to out, writing indices when in is nullptr
+static u64 compactRange(const u32* in, const u8* keep, u64 begin, u64 end, u32* out) {
+  u64 written = 0;
+  u64 i = begin;
+  for (; i + 16 <= end; i += 16) {
+    u32 mask = compactMask(keep + i);
+    if (mask == 0) {
+      continue;
+    }
+
+    if (mask == 0xFFFF) {
+      if (in) {
+        MemoryCopy(out + written, in + i, sizeof(u32) * 16);
+      } else {
+        for (u32 bit = 0; bit < 16; ++bit) {
+          out[written + bit] = (u32)(i + bit);
+        }
+      }
+      written += 16;
+      continue;
+    }
+
+    for (; mask; mask &= mask - 1) {
+      u64 index = i + CountTrailingZeros32(mask);
+      out[written++] = in ? in[index] : (u32)index;
+    }
+  }
+
+  for (; i < end; ++i) {
+    if (keep[i]) {
+      out[written++] = in ? in[i] : (u32)i;
+    }
+  }
+  return written;
+}
+
+u64 compactU32(const u32* in, const u8* keep, u64 count, u32* out) {
+  return compactRange(in, keep, 0, count, out);
+}
+
+u64 compactIndices(const u8* keep, u64 count, u32* outIndices) {
+  return compactRange(nullptr, keep, 0, count, outIndices);
+}
+
+enum ScanKind {
+  ScanKind_Inclusive,
+  ScanKind_Exclusive,
+  ScanKind_Compact,
+};
+
+struct ScanParallelParams {
+  ScanKind kind;
+  const u32* in;
+  const u8* keep;
+  u32* out;
+  u64 count;
+  // Per-task totals, scanned in place into per-task starting offsets
+  u64* offsets;
+};
+
+static void scanParallelReduce(void* ptr, u32 taskIndex, u32 taskCount) {
+  auto* params = (ScanParallelParams*)ptr;
+  u64 begin, end;
+  parallelRange(params->count, taskIndex, taskCount, 16, &begin, &end);
+
+  if (params->kind == ScanKind_Compact) {
+    params->offsets[taskIndex] = compactCount(params->keep, begin, end);
+  } else {
+    params->offsets[taskIndex] = sumU32(params->in + begin, end - begin);
+  }
+}
+
+static void scanParallelWrite(void* ptr, u32 taskIndex, u32 taskCount) {
+  auto* params = (ScanParallelParams*)ptr;
+  u64 begin, end;
+  parallelRange(params->count, taskIndex, taskCount, 16, &begin, &end);
+
+  u64 offset = params->offsets[taskIndex];
+  switch (params->kind) {
+    case ScanKind_Inclusive: {
+      scanInclusiveFrom(params->in + begin, params->out + begin, end - begin, (u32)offset);
+    } break;
+    case ScanKind_Exclusive: {
+      scanExclusiveFrom(params->in + begin, params->out + begin, end - begin, (u32)offset);
+    } break;
+    case ScanKind_Compact: {
+      compactRange(params->in, params->keep, begin, end, params->out + offset);
+    } break;
+  }
+}
+
+static u64 scanParallel(ScanKind kind, const u32* in, const u8* keep, u32* out, u64 count, u32 threadCount) {
+  Temp scratch = ScratchBegin();
+  auto* params = PushStruct(scratch.arena, ScanParallelParams);
+  params->kind = kind;
+  params->in = in;
+  params->keep = keep;
+  params->out = out;
+  params->count = count;
+  params->offsets = PushArrayAligned(scratch.arena, u64, threadCount, CACHE_LINE_SIZE);
+
+  parallelRun(scanParallelReduce, params, threadCount);
+
+  u64 running = 0;
+  for (u32 t = 0; t < threadCount; ++t) {
+    u64 rangeTotal = params->offsets[t];
+    params->offsets[t] = running;
+    running += rangeTotal;
+  }
+
+  parallelRun(scanParallelWrite, params, threadCount);
+
+  ScratchEnd(scratch);
+  return running;
+}
+
+void scanInclusiveU32Parallel(const u32* in, u32* out, u64 count, u32 threadCount) {
+  if (threadCount <= 1 || count < SCAN_PARALLEL_MIN_COUNT) {
+    scanInclusiveU32(in, out, count);
+    return;
+  }
+  scanParallel(ScanKind_Inclusive, in, nullptr, out, count, threadCount);
+}
+
+u32 scanExclusiveU32Parallel(const u32* in, u32* out, u64 count, u32 threadCount) {
+  if (threadCount <= 1 || count < SCAN_PARALLEL_MIN_COUNT) {
+    return scanExclusiveU32(in, out, count);
+  }
+  return (u32)scanParallel(ScanKind_Exclusive, in, nullptr, out, count, threadCount);
+}
+
+u64 compactU32Parallel(const u32* in, const u8* keep, u64 count, u32* out, u32 threadCount) {
+  if (threadCount <= 1 || count < SCAN_PARALLEL_MIN_COUNT) {
+    return compactU32(in, keep, count, out);
+  }
+  return scanParallel(ScanKind_Compact, in, keep, out, count, threadCount);
+}
+
+u64 compactIndicesParallel(const u8* keep, u64 count, u32* outIndices, u32 threadCount) {
+  if (threadCount <= 1 || count < SCAN_PARALLEL_MIN_COUNT) {
+    return compactIndices(keep, count, outIndices);
+  }
+  return scanParallel(ScanKind_Compact, nullptr, keep, outIndices, count, threadCount);
+}
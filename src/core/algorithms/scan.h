@@ -0,0 +1,29 @@
+#pragma once
+
+#include "core/core.h"
+
+// NOTE(piero): Prefix sums and stream compaction over u32, SSE2 with a scalar tail. Sums wrap at 2^32.
+//              in and out may be the same array.
+//              Parallel variants split the input into threadCount ranges and run in two job phases: every range is
+//              reduced, the per-range totals are scanned on the calling thread, then every range is scanned (or
+//              compacted) starting from its offset.
+
+// Parallel variants fall back to the single threaded ones below this
+#define SCAN_PARALLEL_MIN_COUNT Kilobytes(256)
+
+// out[i] = in[0] + ... + in[i]
+void scanInclusiveU32(const u32* in, u32* out, u64 count);
+// out[i] = in[0] + ... + in[i - 1], returns the sum of all of in
+u32 scanExclusiveU32(const u32* in, u32* out, u64 count);
+
+void scanInclusiveU32Parallel(const u32* in, u32* out, u64 count, u32 threadCount);
+u32 scanExclusiveU32Parallel(const u32* in, u32* out, u64 count, u32 threadCount);
+
+// Stream compaction: writes in[i] for every keep[i] != 0 to out, in order, and returns how many were written.
+// out needs room for count elements and must not overlap in.
+u64 compactU32(const u32* in, const u8* keep, u64 count, u32* out);
+// Same, writing the kept indices i instead of the values
+u64 compactIndices(const u8* keep, u64 count, u32* outIndices);
+
+u64 compactU32Parallel(const u32* in, const u8* keep, u64 count, u32* out, u32 threadCount);
+u64 compactIndicesParallel(const u8* keep, u64 count, u32* outIndices, u32 threadCount);
@@ -12,3 +12,8 @@
 #define CONFIG_VALIDATION 0
 #define CONFIG_SYNC_VALIDATION 0
 #endif
+
+// Frame packets the game thread may queue ahead of the render thread
+#ifndef RENDER_FRAME_QUEUE_DEPTH
+#define RENDER_FRAME_QUEUE_DEPTH 1
+#endif
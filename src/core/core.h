@@ -232,6 +232,62 @@ void __asan_unpoison_memory_region(void const volatile *addr, size_t size);
 #define per_thread
 #endif
 
+// Cache line
+#define CACHE_LINE_SIZE 64
+
+// Atomics
+// NOTE(piero): All of these are sequentially consistent. Exchange/Add return the previous value,
+//              CompareExchange returns the value that was there before the call (equals comparand on success).
+#if COMPILER_MSVC
+# include <intrin.h>
+# define AtomicLoadU64(x)                 ((u64)_InterlockedOr64((volatile __int64*)(x), 0))
+# define AtomicStoreU64(x, c)             ((void)_InterlockedExchange64((volatile __int64*)(x), (__int64)(c)))
+# define AtomicExchangeU64(x, c)          ((u64)_InterlockedExchange64((volatile __int64*)(x), (__int64)(c)))
+# define AtomicAddU64(x, c)               ((u64)_InterlockedExchangeAdd64((volatile __int64*)(x), (__int64)(c)))
+# define AtomicCompareExchangeU64(x, e, c) ((u64)_InterlockedCompareExchange64((volatile __int64*)(x), (__int64)(e), (__int64)(c)))
+# define AtomicLoadU32(x)                 ((u32)_InterlockedOr((volatile long*)(x), 0))
+# define AtomicStoreU32(x, c)             ((void)_InterlockedExchange((volatile long*)(x), (long)(c)))
+# define AtomicExchangeU32(x, c)          ((u32)_InterlockedExchange((volatile long*)(x), (long)(c)))
+# define AtomicAddU32(x, c)               ((u32)_InterlockedExchangeAdd((volatile long*)(x), (long)(c)))
+# define AtomicCompareExchangeU32(x, e, c) ((u32)_InterlockedCompareExchange((volatile long*)(x), (long)(e), (long)(c)))
+# define AtomicLoadPtr(x)                 ((void*)AtomicLoadU64(x))
+# define AtomicStorePtr(x, c)             AtomicStoreU64((x), (u64)(c))
+# define AtomicExchangePtr(x, c)          ((void*)_InterlockedExchangePointer((void* volatile*)(x), (void*)(c)))
+# define AtomicCompareExchangePtr(x, e, c) ((void*)_InterlockedCompareExchangePointer((void* volatile*)(x), (void*)(e), (void*)(c)))
+# define CpuPause()                       _mm_pause()
+#elif COMPILER_CLANG || COMPILER_GCC
+# define AtomicLoadU64(x)                 ((u64)__atomic_load_n((x), __ATOMIC_SEQ_CST))
+# define AtomicStoreU64(x, c)             __atomic_store_n((x), (c), __ATOMIC_SEQ_CST)
+# define AtomicExchangeU64(x, c)          ((u64)__atomic_exchange_n((x), (c), __ATOMIC_SEQ_CST))
+# define AtomicAddU64(x, c)               ((u64)__atomic_fetch_add((x), (c), __ATOMIC_SEQ_CST))
+# define AtomicCompareExchangeU64(x, e, c) ((u64)__sync_val_compare_and_swap((x), (c), (e)))
+# define AtomicLoadU32(x)                 ((u32)__atomic_load_n((x), __ATOMIC_SEQ_CST))
+# define AtomicStoreU32(x, c)             __atomic_store_n((x), (c), __ATOMIC_SEQ_CST)
+# define AtomicExchangeU32(x, c)          ((u32)__atomic_exchange_n((x), (c), __ATOMIC_SEQ_CST))
+# define AtomicAddU32(x, c)               ((u32)__atomic_fetch_add((x), (c), __ATOMIC_SEQ_CST))
+# define AtomicCompareExchangeU32(x, e, c) ((u32)__sync_val_compare_and_swap((x), (c), (e)))
+# define AtomicLoadPtr(x)                 ((void*)__atomic_load_n((x), __ATOMIC_SEQ_CST))
+# define AtomicStorePtr(x, c)             __atomic_store_n((x), (c), __ATOMIC_SEQ_CST)
+# define AtomicExchangePtr(x, c)          ((void*)__atomic_exchange_n((x), (c), __ATOMIC_SEQ_CST))
+# define AtomicCompareExchangePtr(x, e, c) ((void*)__sync_val_compare_and_swap((x), (c), (e)))
+# define CpuPause()                       __builtin_ia32_pause()
+#endif
+
+// Bit scanning, undefined for 0
+#if COMPILER_MSVC
+inline u32 CountTrailingZeros32(u32 x) { unsigned long index; _BitScanForward(&index, x); return (u32)index; }
+inline u32 CountTrailingZeros64(u64 x) { unsigned long index; _BitScanForward64(&index, x); return (u32)index; }
+inline u32 CountLeadingZeros64(u64 x) { unsigned long index; _BitScanReverse64(&index, x); return 63 - (u32)index; }
+# define CountSetBits32(x)                ((u32)__popcnt(x))
+# define CountSetBits64(x)                ((u32)__popcnt64(x))
+#elif COMPILER_CLANG || COMPILER_GCC
+# define CountTrailingZeros32(x)          ((u32)__builtin_ctz(x))
+# define CountTrailingZeros64(x)          ((u32)__builtin_ctzll(x))
+# define CountLeadingZeros64(x)           ((u32)__builtin_clzll(x))
+# define CountSetBits32(x)                ((u32)__builtin_popcount(x))
+# define CountSetBits64(x)                ((u32)__builtin_popcountll(x))
+#endif
+
 // Linked List helpers
 // Based on: https://www.youtube.com/watch?v=gAijHHlyD5s
 #define CheckNull(p) ((p)==0)
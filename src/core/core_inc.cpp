@@ -2,8 +2,23 @@
 
 #include "core_strings.cpp"
 #include "thread_context.cpp"
+#include "string_intern.cpp"
 
 #include "memory/arena.cpp"
+#include "memory/concurrent_arena.cpp"
+#include "memory/ring_buffer.cpp"
+#include "memory/tlsf.cpp"
+#include "memory/pool.cpp"
+
+#include "algorithms/parallel.cpp"
+#include "algorithms/radix_sort.cpp"
+#include "algorithms/scan.cpp"
+
+#include "thread_placement.cpp"
+#include "job_system.cpp"
+#include "fiber_jobs.cpp"
+#include "task_graph.cpp"
+#include "coroutine.cpp"
 
 #include "math/core_math.cpp"
 
@@ -8,11 +8,29 @@
 
 #include "core_strings.h"
 #include "thread_context.h"
+#include "string_intern.h"
 
 #include "memory/arena.h"
+#include "memory/concurrent_arena.h"
+#include "memory/ring_buffer.h"
+#include "memory/tlsf.h"
+#include "memory/pool.h"
 
 #include "data_structures/array.h"
 #include "data_structures/stack.h"
+#include "data_structures/slot_map.h"
+#include "data_structures/hash_map.h"
+#include "data_structures/queue.h"
+
+#include "algorithms/parallel.h"
+#include "algorithms/radix_sort.h"
+#include "algorithms/scan.h"
+
+#include "thread_placement.h"
+#include "job_system.h"
+#include "fiber_jobs.h"
+#include "task_graph.h"
+#include "coroutine.h"
 
 #include "math/core_math.h"
 
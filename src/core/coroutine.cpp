@@ -0,0 +1,197 @@
+#include "coroutine.h"
+
+struct TaskWaitList {
+  u32 lock;
+  TaskWaiter* first;
+};
+
+static TaskWaitList taskWaitList = {};
+
+static void taskWaitListLock() {
+  while (AtomicCompareExchangeU32(&taskWaitList.lock, 1, 0) != 0) {
+    CpuPause();
+  }
+}
+
+static void taskWaitListUnlock() {
+  AtomicStoreU32(&taskWaitList.lock, 0);
+}
+
+void taskAddWaiter(TaskWaiter* waiter) {
+  taskWaitListLock();
+  waiter->next = taskWaitList.first;
+  taskWaitList.first = waiter;
+  taskWaitListUnlock();
+}
+
+static void taskIoPoll();
+
+// NOTE(piero): The list is taken whole, so resumed coroutines can register new waiters while it's walked. Those
+//              are looked at by the next poll. next is read before resuming, the waiter dies with its frame.
+u32 taskPoll() {
+  taskIoPoll();
+  if (AtomicLoadPtr(&taskWaitList.first) == nullptr) {
+    return 0;
+  }
+
+  taskWaitListLock();
+  TaskWaiter* waiters = taskWaitList.first;
+  taskWaitList.first = nullptr;
+  taskWaitListUnlock();
+
+  u32 resumed = 0;
+  for (TaskWaiter* waiter = waiters, *next = nullptr; waiter != nullptr; waiter = next) {
+    next = waiter->next;
+    if (waiter->ready(waiter->params)) {
+      waiter->handle.resume();
+      resumed += 1;
+    } else {
+      taskAddWaiter(waiter);
+    }
+  }
+  return resumed;
+}
+
+TaskPollAwaiter taskWaitUntil(TaskPollFunction* ready, void* params) {
+  TaskPollAwaiter result = {};
+  result.waiter.ready = ready;
+  result.waiter.params = params;
+  return result;
+}
+
+static b32 taskCounterReady(void* params) {
+  return AtomicLoadU32(&((JobCounter*)params)->pending) == 0;
+}
+
+TaskPollAwaiter taskWaitCounter(JobCounter* counter) {
+  return taskWaitUntil(taskCounterReady, counter);
+}
+
+static b32 taskAlwaysReady(void* params) {
+  return true;
+}
+
+void TaskMainThreadAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  waiter.ready = taskAlwaysReady;
+  waiter.handle = handle;
+  taskAddWaiter(&waiter);
+}
+
+TaskMainThreadAwaiter taskSwitchToMainThread() {
+  return {};
+}
+
+static void taskResumeJob(void* params) {
+  std::coroutine_handle<>::from_address(params).resume();
+}
+
+void TaskJobAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  jobSubmit(taskResumeJob, handle.address(), nullptr, priority);
+}
+
+TaskJobAwaiter taskSwitchToJob(JobPriority priority) {
+  return TaskJobAwaiter{ .priority = priority };
+}
+
+// Files
+// NOTE(piero): Every file read goes through one OS I/O queue. taskReadFile only records its reads, and the next
+//              taskPoll submits everything recorded since the last one in a single call and marks finished reads,
+//              so a scene asking for a hundred files costs one submission. Files are read unbuffered straight into
+//              the caller's arena, the kernel doesn't keep a second copy in the page cache.
+
+struct TaskIoState {
+  u32 lock;
+  OS_Handle queue;
+};
+
+static TaskIoState taskIoState = {};
+
+static void taskIoLock() {
+  while (AtomicCompareExchangeU32(&taskIoState.lock, 1, 0) != 0) {
+    CpuPause();
+  }
+}
+
+static void taskIoUnlock() {
+  AtomicStoreU32(&taskIoState.lock, 0);
+}
+
+static void taskIoPoll() {
+  if (taskIoState.queue.u64[0] == 0) {
+    return;
+  }
+
+  taskIoLock();
+  OS_ioSubmit(taskIoState.queue);
+  OS_IoRead* completed[64];
+  for (;;) {
+    u32 count = OS_ioComplete(taskIoState.queue, completed, ArrayCount(completed), false);
+    for (u32 i = 0; i < count; ++i) {
+      // userData is the reading coroutine's count of chunks left
+      AtomicAddU32((u32*)completed[i]->userData, (u32)-1);
+    }
+    if (count < ArrayCount(completed)) {
+      break;
+    }
+  }
+  taskIoUnlock();
+}
+
+static b32 taskFileReadReady(void* params) {
+  return AtomicLoadU32((u32*)params) == 0;
+}
+
+Task<String8> taskReadFile(Arena* arena, String8 path, OS_IoPriority priority) {
+  String8 result = {};
+  OS_Handle file = OS_fileOpen(path, OS_FileFlag_Read | OS_FileFlag_Unbuffered);
+  if (!OS_fileIsValid(file)) {
+    // File systems without direct I/O refuse the unbuffered open
+    file = OS_fileOpen(path, OS_FileFlag_Read);
+  }
+  if (!OS_fileIsValid(file)) {
+    co_return result;
+  }
+
+  // Unbuffered reads need aligned sizes and buffers. The extra byte past the file is the null terminator.
+  u64 size = OS_fileSize(file);
+  u64 readSize = AlignPow2(size + 1, OS_FILE_UNBUFFERED_ALIGNMENT);
+  u8* data = PushArrayNoZeroAligned(arena, u8, readSize, OS_FILE_UNBUFFERED_ALIGNMENT);
+
+  // Split so a big file keeps several reads in flight
+  u32 chunkCount = (u32)((readSize + TASK_FILE_READ_CHUNK_SIZE - 1) / TASK_FILE_READ_CHUNK_SIZE);
+  OS_IoRead* reads = PushArray(arena, OS_IoRead, chunkCount);
+  u32 remaining = chunkCount;
+
+  taskIoLock();
+  if (taskIoState.queue.u64[0] == 0) {
+    taskIoState.queue = OS_ioQueueAlloc(TASK_IO_QUEUE_DEPTH);
+  }
+  for (u32 i = 0; i < chunkCount; ++i) {
+    OS_IoRead* read = &reads[i];
+    read->file = file;
+    read->offset = (u64)i * TASK_FILE_READ_CHUNK_SIZE;
+    read->size = Min(readSize - read->offset, (u64)TASK_FILE_READ_CHUNK_SIZE);
+    read->dst = data + read->offset;
+    read->priority = priority;
+    read->userData = &remaining;
+    OS_ioQueueRead(taskIoState.queue, read);
+  }
+  taskIoUnlock();
+
+  co_await taskWaitUntil(taskFileReadReady, &remaining);
+  OS_fileClose(file);
+
+  // Only the last chunk may come back short
+  u64 bytesRead = 0;
+  for (u32 i = 0; i < chunkCount; ++i) {
+    if (reads[i].result < 0 || (i + 1 < chunkCount && (u64)reads[i].result != reads[i].size)) {
+      co_return result;
+    }
+    bytesRead += (u64)reads[i].result;
+  }
+
+  bytesRead = Min(bytesRead, size);
+  data[bytesRead] = 0;
+  result = Str8(data, bytesRead);
+  co_return result;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <coroutine>
+
+#include "core/core.h"
+#include "core/core_strings.h"
+#include "core/memory/arena.h"
+#include "core/job_system.h"
+
+// NOTE(piero): Coroutine tasks for I/O and asset loading. Task<T> is lazy: calling a coroutine allocates its frame
+//              and stops before the body. co_await on it runs it, and the awaiting coroutine continues once it
+//              returns (symmetric transfer, with clang and MSVC long chains don't grow the stack).
+//              Frames come from the Arena passed as the coroutine's first parameter, `Task<T> f(Arena* arena, ...)`.
+//              A coroutine without one doesn't compile. Frames are never freed on their own, they go away with the
+//              arena, so loads should use an arena of their own. Only the thread owning that arena may call them.
+//              Suspending on something that isn't a Task (a job counter, a file read, a GPU fence) registers a
+//              waiter, and taskPoll resumes the ones whose condition holds. The main loop polls once per frame, so
+//              a load runs across frames instead of blocking one.
+//              co_await taskSwitchToJob() continues on a job worker for CPU heavy steps, and
+//              co_await taskSwitchToMainThread() comes back on the next taskPoll for windowing and renderer calls.
+//              taskPoll also drives file reads, see taskReadFile.
+
+// Waiters
+
+using TaskPollFunction = b32(void* params);
+
+struct TaskWaiter {
+  TaskPollFunction* ready;
+  void* params;
+  std::coroutine_handle<> handle;
+  TaskWaiter* next;
+};
+
+void taskAddWaiter(TaskWaiter* waiter);
+// Resumes every waiter that is ready, on the calling thread. Meant for the main thread, once per frame.
+// Returns how many were resumed.
+u32 taskPoll();
+
+// Lives in the suspended coroutine's frame, so waiting allocates nothing
+struct TaskPollAwaiter {
+  TaskWaiter waiter;
+
+  bool await_ready() { return waiter.ready(waiter.params); }
+  void await_suspend(std::coroutine_handle<> handle) {
+    waiter.handle = handle;
+    taskAddWaiter(&waiter);
+  }
+  void await_resume() {}
+};
+
+TaskPollAwaiter taskWaitUntil(TaskPollFunction* ready, void* params);
+TaskPollAwaiter taskWaitCounter(JobCounter* counter);
+
+// Suspends even when called on the main thread, the rest runs from the next taskPoll
+struct TaskMainThreadAwaiter {
+  TaskWaiter waiter;
+
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle);
+  void await_resume() {}
+};
+
+TaskMainThreadAwaiter taskSwitchToMainThread();
+
+struct TaskJobAwaiter {
+  JobPriority priority;
+
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle);
+  void await_resume() {}
+};
+
+TaskJobAwaiter taskSwitchToJob(JobPriority priority = JobPriority_Normal);
+
+// Promise
+
+struct TaskPromiseBase {
+  std::coroutine_handle<> continuation;
+  // Set last thing before the frame is left for good, the frame may be destroyed as soon as it's seen
+  u32 finished;
+
+  template <typename... Args>
+  static void* operator new(size_t size, Arena* arena, Args&&...) {
+    return arenaPush(arena, size, 16);
+  }
+  static void* operator new(size_t size) = delete;
+  // The arena owns the memory
+  static void operator delete(void*) {}
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept {
+      std::coroutine_handle<> continuation = handle.promise().continuation;
+      AtomicStoreU32(&handle.promise().finished, 1);
+      return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { OS_abort(); }
+};
+
+template <typename T>
+struct Task;
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+  T value;
+
+  Task<T> get_return_object();
+  void return_value(T result) { value = result; }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object();
+  void return_void() {}
+};
+
+// Task
+
+template <typename T>
+struct Task {
+  using promise_type = TaskPromise<T>;
+
+  std::coroutine_handle<promise_type> handle;
+  b32 started;
+
+  Task() = default;
+  explicit Task(std::coroutine_handle<promise_type> h) : handle(h), started(false) {}
+  Task(Task&& other) : handle(other.handle), started(other.started) { other.handle = nullptr; }
+  Task& operator=(Task&& other) {
+    if (this != &other) {
+      destroy();
+      handle = other.handle;
+      started = other.started;
+      other.handle = nullptr;
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() { destroy(); }
+
+  // A task that started and hasn't finished may be parked in the waiter list, or awaiting a task that is, and
+  // taskPoll would resume the freed frame. Wait for it (taskWait, taskWaitDone) before letting it go.
+  void destroy() {
+    if (handle) {
+      Assert(!started || AtomicLoadU32(&handle.promise().finished) != 0);
+      handle.destroy();
+      handle = nullptr;
+    }
+  }
+
+  // co_await on a task that wasn't started, use taskWaitDone for ones started with taskStart
+  bool await_ready() { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+    Assert(!started);
+    started = true;
+    handle.promise().continuation = awaiting;
+    return handle;
+  }
+  T await_resume() {
+    if constexpr (!std::is_void_v<T>) {
+      return handle.promise().value;
+    }
+  }
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+  return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// Runs the task until its first suspension. Several started tasks make progress side by side.
+template <typename T>
+void taskStart(Task<T>* task) {
+  if (!task->started) {
+    task->started = true;
+    task->handle.resume();
+  }
+}
+
+template <typename T>
+b32 taskIsDone(Task<T>* task) {
+  return AtomicLoadU32(&task->handle.promise().finished) != 0;
+}
+
+inline b32 taskFinishedReady(void* params) {
+  return AtomicLoadU32((u32*)params) != 0;
+}
+
+// For tasks started with taskStart
+template <typename T>
+TaskPollAwaiter taskWaitDone(Task<T>* task) {
+  return taskWaitUntil(taskFinishedReady, &task->handle.promise().finished);
+}
+
+// Blocking, for code that isn't a coroutine. Polls waiters and runs jobs until the task is done.
+template <typename T>
+T taskWait(Task<T>* task) {
+  taskStart(task);
+  while (!taskIsDone(task)) {
+    if (taskPoll() == 0 && !jobTryRunOne()) {
+      OS_threadYield();
+    }
+  }
+  return task->await_resume();
+}
+
+// Files
+
+#define TASK_IO_QUEUE_DEPTH 64
+#define TASK_FILE_READ_CHUNK_SIZE Megabytes(4)
+
+// Reads the whole file into arena through the async I/O queue, submitted and completed by taskPoll.
+// Empty string if it can't be opened or read.
+Task<String8> taskReadFile(Arena* arena, String8 path, OS_IoPriority priority = OS_IoPriority_Normal);
@@ -11,6 +11,20 @@
    ? DynamicArray_grow(arena, s, sizeof(*(s)->data)), (s)->data + (s)->len++ \
    : (s)->data + (s)->len++)
 
+// NOTE(piero): Grows `data` from oldCapacity to newCapacity elements. If it's the last allocation in the arena it
+//              just bumps pos, otherwise it moves to a fresh buffer and copies `count` elements over.
+inline void* arenaGrowBuffer(Arena* arena, void* data, u64 elementSize, u64 align, u64 count, u64 oldCapacity, u64 newCapacity) {
+  if (data && arenaTryGrow(arena, data, elementSize * oldCapacity, elementSize * newCapacity)) {
+    return data;
+  }
+
+  void* result = arenaPush(arena, elementSize * newCapacity, align);
+  if (count) {
+    MemoryCopy(result, data, elementSize * count);
+  }
+  return result;
+}
+
 static void DynamicArray_grow(Arena* a, void *slice, std::ptrdiff_t size) {
   struct {
     void *data;
@@ -19,14 +33,247 @@ static void DynamicArray_grow(Arena* a, void *slice, std::ptrdiff_t size) {
   } replica{};
   memcpy(&replica, slice, sizeof(replica));
 
-  replica.cap = replica.cap ? replica.cap : 1;
+  ptrdiff_t cap = replica.cap ? replica.cap : 1;
   ptrdiff_t align = 16;
-  void *data = arenaPush(a, 2 * size * replica.cap, align);
-  replica.cap *= 2;
-  if (replica.len) {
-    memcpy(data, replica.data, size * replica.len);
-  }
-  replica.data = data;
+  replica.data = arenaGrowBuffer(a, replica.data, size, align, replica.len, replica.cap, 2 * cap);
+  replica.cap = 2 * cap;
 
   memcpy(slice, &replica, sizeof(replica));
 }
+
+// Typed arena array. Doubles on overflow, in place when it's the arena's last allocation.
+template <typename T>
+struct Array {
+  Arena* arena;
+  T* data;
+  u64 count;
+  u64 capacity;
+
+  T& operator[](u64 index) { Assert(index < count); return data[index]; }
+  T* begin() { return data; }
+  T* end() { return data + count; }
+};
+
+template <typename T>
+void arrayInit(Array<T>* array, Arena* arena, u64 capacity = 0) {
+  MemoryZeroStruct(array);
+  array->arena = arena;
+  if (capacity) {
+    array->data = PushArrayNoZero(arena, T, capacity);
+    array->capacity = capacity;
+  }
+}
+
+template <typename T>
+void arrayReserve(Array<T>* array, u64 capacity) {
+  if (capacity > array->capacity) {
+    array->data = (T*)arenaGrowBuffer(array->arena, array->data, sizeof(T), Max(8, alignof(T)), array->count, array->capacity, capacity);
+    array->capacity = capacity;
+  }
+}
+
+// Appends `count` zeroed elements and returns the first
+template <typename T>
+T* arrayPushN(Array<T>* array, u64 count) {
+  if (array->count + count > array->capacity) {
+    arrayReserve(array, Max(array->capacity * 2, Max(array->count + count, (u64)8)));
+  }
+  T* result = array->data + array->count;
+  MemoryZero(result, sizeof(T) * count);
+  array->count += count;
+  return result;
+}
+
+template <typename T>
+T* arrayPush(Array<T>* array) {
+  return arrayPushN(array, 1);
+}
+
+template <typename T>
+T* arrayPush(Array<T>* array, const T& value) {
+  T* result = arrayPushN(array, 1);
+  *result = value;
+  return result;
+}
+
+template <typename T>
+T arrayPop(Array<T>* array) {
+  Assert(array->count > 0);
+  array->count -= 1;
+  return array->data[array->count];
+}
+
+// O(1), moves the last element into the hole
+template <typename T>
+void arrayRemoveSwap(Array<T>* array, u64 index) {
+  Assert(index < array->count);
+  array->count -= 1;
+  array->data[index] = array->data[array->count];
+}
+
+template <typename T>
+void arrayClear(Array<T>* array) {
+  array->count = 0;
+}
+
+// Array that keeps its first N elements inline and only touches the arena once it outgrows them.
+// NOTE(piero): Don't keep pointers to elements across pushes, the first spill moves everything to the arena.
+template <typename T, u64 N>
+struct SmallArray {
+  Arena* arena;
+  // nullptr while the elements still fit inline
+  T* heap;
+  u64 count;
+  u64 capacity;
+  T inlineData[N];
+
+  T* data() { return heap ? heap : inlineData; }
+  T& operator[](u64 index) { Assert(index < count); return data()[index]; }
+  T* begin() { return data(); }
+  T* end() { return data() + count; }
+};
+
+template <typename T, u64 N>
+void smallArrayInit(SmallArray<T, N>* array, Arena* arena) {
+  array->arena = arena;
+  array->heap = nullptr;
+  array->count = 0;
+  array->capacity = N;
+}
+
+template <typename T, u64 N>
+void smallArrayReserve(SmallArray<T, N>* array, u64 capacity) {
+  if (capacity <= array->capacity) {
+    return;
+  }
+
+  if (array->heap == nullptr) {
+    array->heap = PushArrayNoZero(array->arena, T, capacity);
+    MemoryCopy(array->heap, array->inlineData, sizeof(T) * array->count);
+  } else {
+    array->heap = (T*)arenaGrowBuffer(array->arena, array->heap, sizeof(T), Max(8, alignof(T)), array->count, array->capacity, capacity);
+  }
+  array->capacity = capacity;
+}
+
+template <typename T, u64 N>
+T* smallArrayPush(SmallArray<T, N>* array, const T& value) {
+  if (array->count == array->capacity) {
+    smallArrayReserve(array, array->capacity * 2);
+  }
+  T* result = array->data() + array->count;
+  *result = value;
+  array->count += 1;
+  return result;
+}
+
+template <typename T, u64 N>
+void smallArrayClear(SmallArray<T, N>* array) {
+  array->count = 0;
+}
+
+// Type at index I of a pack
+template <u64 I, typename T, typename... Rest>
+struct TypeAt {
+  using Type = typename TypeAt<I - 1, Rest...>::Type;
+};
+
+template <typename T, typename... Rest>
+struct TypeAt<0, T, Rest...> {
+  using Type = T;
+};
+
+// Structure of arrays: one column per type, all in a single arena allocation laid out as
+// [column 0 x capacity][column 1 x capacity]... Each column starts on a 16 byte boundary so it can be loaded with SIMD.
+// Growing in place bumps the arena and slides the columns up to their new offsets, last column first.
+template <typename... Ts>
+struct SoAArray {
+  static constexpr u64 columnCount = sizeof...(Ts);
+  static constexpr u64 columnSizes[columnCount] = { sizeof(Ts)... };
+
+  Arena* arena;
+  u8* base;
+  u64 count;
+  u64 capacity;
+};
+
+#define SOA_COLUMN_ALIGN 16
+
+template <typename... Ts>
+u64 soaColumnOffset(u64 capacity, u64 column) {
+  u64 offset = 0;
+  for (u64 i = 0; i < column; ++i) {
+    offset += AlignPow2(SoAArray<Ts...>::columnSizes[i] * capacity, SOA_COLUMN_ALIGN);
+  }
+  return offset;
+}
+
+template <typename... Ts>
+u64 soaBytes(u64 capacity) {
+  return soaColumnOffset<Ts...>(capacity, sizeof...(Ts));
+}
+
+template <typename... Ts>
+void soaInit(SoAArray<Ts...>* array, Arena* arena, u64 capacity = 0) {
+  static_assert(((alignof(Ts) <= SOA_COLUMN_ALIGN) && ...), "SoAArray column alignment above 16 isn't supported");
+
+  MemoryZeroStruct(array);
+  array->arena = arena;
+  if (capacity) {
+    array->base = (u8*)arenaPush(arena, soaBytes<Ts...>(capacity), SOA_COLUMN_ALIGN);
+    array->capacity = capacity;
+  }
+}
+
+template <u64 I, typename... Ts>
+typename TypeAt<I, Ts...>::Type* soaColumn(SoAArray<Ts...>* array) {
+  return (typename TypeAt<I, Ts...>::Type*)(array->base + soaColumnOffset<Ts...>(array->capacity, I));
+}
+
+template <typename... Ts>
+void soaReserve(SoAArray<Ts...>* array, u64 capacity) {
+  if (capacity <= array->capacity) {
+    return;
+  }
+
+  constexpr u64 columnCount = sizeof...(Ts);
+  u64 oldBytes = soaBytes<Ts...>(array->capacity);
+  u64 newBytes = soaBytes<Ts...>(capacity);
+
+  if (array->base && arenaTryGrow(array->arena, array->base, oldBytes, newBytes)) {
+    // New offsets are never below the old ones, so moving the last column first never clobbers one not yet moved
+    for (u64 column = columnCount; column > 0; --column) {
+      u64 from = soaColumnOffset<Ts...>(array->capacity, column - 1);
+      u64 to = soaColumnOffset<Ts...>(capacity, column - 1);
+      if (from != to) {
+        MemoryMove(array->base + to, array->base + from, SoAArray<Ts...>::columnSizes[column - 1] * array->count);
+      }
+    }
+  } else {
+    u8* base = (u8*)arenaPush(array->arena, newBytes, SOA_COLUMN_ALIGN);
+    for (u64 column = 0; column < columnCount && array->count; ++column) {
+      MemoryCopy(base + soaColumnOffset<Ts...>(capacity, column), array->base + soaColumnOffset<Ts...>(array->capacity, column), SoAArray<Ts...>::columnSizes[column] * array->count);
+    }
+    array->base = base;
+  }
+  array->capacity = capacity;
+}
+
+// Appends one element to every column, returns its index
+template <typename... Ts>
+u64 soaPush(SoAArray<Ts...>* array, const Ts&... values) {
+  if (array->count == array->capacity) {
+    soaReserve(array, Max(array->capacity * 2, (u64)8));
+  }
+
+  u64 index = array->count;
+  u64 column = 0;
+  ((*((Ts*)(array->base + soaColumnOffset<Ts...>(array->capacity, column++)) + index) = values), ...);
+  array->count += 1;
+  return index;
+}
+
+template <typename... Ts>
+void soaClear(SoAArray<Ts...>* array) {
+  array->count = 0;
+}
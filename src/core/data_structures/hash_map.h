@@ -0,0 +1,268 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include "core/core.h"
+#include "core/memory/arena.h"
+
+// NOTE(piero): Open addressing hash map with SSE2 group probing, Swiss table style.
+//              Every slot has a control byte: 0x80 when empty, otherwise the low 7 bits of the key's hash (h2).
+//              Lookups start at the key's home slot and compare 16 control bytes at once against h2, only
+//              slots whose byte matches get a full key compare.
+//              Probing is linear, which lets removal shift the following run back into the hole (backward
+//              shift deletion) instead of leaving tombstones, so long-lived maps with churn never degrade.
+//              The control array is HASH_MAP_GROUP_WIDTH bytes longer than capacity and the tail mirrors the
+//              first group, so a group load never has to wrap.
+//              Storage comes from the arena, growing abandons the old arrays in it.
+
+#define HASH_MAP_GROUP_WIDTH 16
+
+static constexpr u8 hashMapCtrlEmpty = 0x80;
+static constexpr u64 hashMapMinCapacity = HASH_MAP_GROUP_WIDTH;
+
+// Hashing
+inline u64 hashU64(u64 x) {
+  // splitmix64 finalizer
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+inline u64 hashBytes(const void* data, u64 size, u64 seed = 0) {
+  const u8* bytes = (const u8*)data;
+  u64 h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+
+  u64 i = 0;
+  for (; i + 8 <= size; i += 8) {
+    u64 word;
+    MemoryCopy(&word, bytes + i, 8);
+    h = (h ^ hashU64(word)) * 0x9e3779b97f4a7c15ull;
+  }
+  if (i < size) {
+    u64 word = 0;
+    MemoryCopy(&word, bytes + i, size - i);
+    h = (h ^ hashU64(word)) * 0x9e3779b97f4a7c15ull;
+  }
+
+  return hashU64(h);
+}
+
+inline u64 hashKey(u64 key) { return hashU64(key); }
+inline u64 hashKey(i64 key) { return hashU64((u64)key); }
+inline u64 hashKey(u32 key) { return hashU64(key); }
+inline u64 hashKey(i32 key) { return hashU64((u64)(u32)key); }
+inline u64 hashKey(const void* key) { return hashU64((u64)key); }
+inline u64 hashKey(String8 key) { return hashBytes(key.str, key.size); }
+
+template <typename K>
+inline b32 hashKeyEqual(K a, K b) { return a == b; }
+inline b32 hashKeyEqual(String8 a, String8 b) { return a.size == b.size && memcmp(a.str, b.str, a.size) == 0; }
+
+template <typename K, typename V>
+struct HashMapSlot {
+  K key;
+  V value;
+};
+
+template <typename K, typename V>
+struct HashMap {
+  Arena* arena;
+
+  u8* ctrl;
+  HashMapSlot<K, V>* slots;
+  // Always a power of two
+  u64 capacity;
+  u64 count;
+};
+
+// Max load of 7/8. Linear probing stays short at this load because group probing checks 16 slots per step.
+inline u64 hashMapMaxCount(u64 capacity) { return capacity - capacity / 8; }
+
+inline u32 hashMapGroupMatch(const u8* ctrl, u8 value) {
+  __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+  return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+}
+
+// Only empty control bytes have the high bit set
+inline u32 hashMapGroupEmpty(const u8* ctrl) {
+  return (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+}
+
+template <typename K, typename V>
+void hashMapSetCtrl(HashMap<K, V>* map, u64 index, u8 value) {
+  map->ctrl[index] = value;
+  // Mirror writes to the first group into the tail, lands on `index` itself for every other slot
+  map->ctrl[((index - HASH_MAP_GROUP_WIDTH) & (map->capacity - 1)) + HASH_MAP_GROUP_WIDTH] = value;
+}
+
+template <typename K, typename V>
+void hashMapInit(HashMap<K, V>* map, Arena* arena, u64 capacity = hashMapMinCapacity) {
+  MemoryZeroStruct(map);
+  map->arena = arena;
+
+  u64 cap = hashMapMinCapacity;
+  while (cap < capacity) {
+    cap <<= 1;
+  }
+  map->capacity = cap;
+  map->ctrl = PushArrayNoZeroAligned(arena, u8, cap + HASH_MAP_GROUP_WIDTH, HASH_MAP_GROUP_WIDTH);
+  MemorySet(map->ctrl, hashMapCtrlEmpty, cap + HASH_MAP_GROUP_WIDTH);
+  using Slot = HashMapSlot<K, V>;
+  map->slots = PushArrayNoZero(arena, Slot, cap);
+}
+
+// First empty slot in the probe sequence of `hash`. There is always one since the load is capped.
+template <typename K, typename V>
+u64 hashMapFindEmpty(HashMap<K, V>* map, u64 hash) {
+  u64 mask = map->capacity - 1;
+  u64 pos = (hash >> 7) & mask;
+  for (;;) {
+    u32 empty = hashMapGroupEmpty(map->ctrl + pos);
+    if (empty) {
+      return (pos + CountTrailingZeros32(empty)) & mask;
+    }
+    pos = (pos + HASH_MAP_GROUP_WIDTH) & mask;
+  }
+}
+
+// Resizes to fit at least `capacity` slots and reinserts everything. Never shrinks below the current count.
+template <typename K, typename V>
+void hashMapRehash(HashMap<K, V>* map, u64 capacity) {
+  HashMap<K, V> old = *map;
+
+  u64 cap = hashMapMinCapacity;
+  while (cap < capacity || hashMapMaxCount(cap) < old.count) {
+    cap <<= 1;
+  }
+  hashMapInit(map, old.arena, cap);
+
+  for (u64 i = 0; i < old.capacity; ++i) {
+    if (old.ctrl[i] & hashMapCtrlEmpty) {
+      continue;
+    }
+    u64 index = hashMapFindEmpty(map, hashKey(old.slots[i].key));
+    hashMapSetCtrl(map, index, old.ctrl[i]);
+    map->slots[index] = old.slots[i];
+  }
+  map->count = old.count;
+}
+
+// Makes room for `count` entries without rehashing
+template <typename K, typename V>
+void hashMapReserve(HashMap<K, V>* map, u64 count) {
+  if (hashMapMaxCount(map->capacity) < count) {
+    u64 cap = map->capacity;
+    while (hashMapMaxCount(cap) < count) {
+      cap <<= 1;
+    }
+    hashMapRehash(map, cap);
+  }
+}
+
+template <typename K, typename V>
+u64 hashMapFindIndex(HashMap<K, V>* map, K key, u64 hash) {
+  u64 mask = map->capacity - 1;
+  u64 pos = (hash >> 7) & mask;
+  u8 h2 = (u8)(hash & 0x7F);
+
+  for (u64 probed = 0; probed < map->capacity; probed += HASH_MAP_GROUP_WIDTH) {
+    u32 match = hashMapGroupMatch(map->ctrl + pos, h2);
+    u32 empty = hashMapGroupEmpty(map->ctrl + pos);
+    // The key can't live past the first empty slot of its run
+    if (empty) {
+      match &= (empty & (0 - empty)) - 1;
+    }
+
+    while (match) {
+      u64 index = (pos + CountTrailingZeros32(match)) & mask;
+      if (hashKeyEqual(map->slots[index].key, key)) {
+        return index;
+      }
+      match &= match - 1;
+    }
+
+    if (empty) {
+      break;
+    }
+    pos = (pos + HASH_MAP_GROUP_WIDTH) & mask;
+  }
+  return map->capacity;
+}
+
+template <typename K, typename V>
+V* hashMapFind(HashMap<K, V>* map, K key) {
+  u64 index = hashMapFindIndex(map, key, hashKey(key));
+  return index < map->capacity ? &map->slots[index].value : nullptr;
+}
+
+// Returns the value for `key`, adding a zeroed one if missing. `added` reports which happened.
+// The pointer is valid until the map is next modified.
+template <typename K, typename V>
+V* hashMapGetOrAdd(HashMap<K, V>* map, K key, b32* added = nullptr) {
+  u64 hash = hashKey(key);
+  u64 index = hashMapFindIndex(map, key, hash);
+  if (added) {
+    *added = index == map->capacity;
+  }
+  if (index < map->capacity) {
+    return &map->slots[index].value;
+  }
+
+  if (map->count + 1 > hashMapMaxCount(map->capacity)) {
+    hashMapRehash(map, map->capacity * 2);
+  }
+
+  index = hashMapFindEmpty(map, hash);
+  hashMapSetCtrl(map, index, (u8)(hash & 0x7F));
+  map->slots[index].key = key;
+  MemoryZeroStruct(&map->slots[index].value);
+  map->count += 1;
+  return &map->slots[index].value;
+}
+
+// Inserts or overwrites
+template <typename K, typename V>
+V* hashMapInsert(HashMap<K, V>* map, K key, const V& value) {
+  V* result = hashMapGetOrAdd(map, key);
+  *result = value;
+  return result;
+}
+
+template <typename K, typename V>
+b32 hashMapRemove(HashMap<K, V>* map, K key) {
+  u64 hole = hashMapFindIndex(map, key, hashKey(key));
+  if (hole == map->capacity) {
+    return false;
+  }
+
+  // NOTE(piero): Backward shift. Walk the run after the hole and pull back every entry whose home slot is
+  //              at or before the hole, so lookups never hit a gap in the middle of their run.
+  u64 mask = map->capacity - 1;
+  for (u64 next = (hole + 1) & mask; !(map->ctrl[next] & hashMapCtrlEmpty); next = (next + 1) & mask) {
+    u64 home = (hashKey(map->slots[next].key) >> 7) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      map->slots[hole] = map->slots[next];
+      hashMapSetCtrl(map, hole, map->ctrl[next]);
+      hole = next;
+    }
+  }
+
+  hashMapSetCtrl(map, hole, hashMapCtrlEmpty);
+  map->count -= 1;
+  return true;
+}
+
+template <typename K, typename V>
+void hashMapClear(HashMap<K, V>* map) {
+  MemorySet(map->ctrl, hashMapCtrlEmpty, map->capacity + HASH_MAP_GROUP_WIDTH);
+  map->count = 0;
+}
+
+// Iteration: for (u64 i = 0; i < map.capacity; ++i) if (hashMapSlotIsFull(&map, i)) { map.slots[i] ... }
+template <typename K, typename V>
+b32 hashMapSlotIsFull(HashMap<K, V>* map, u64 index) {
+  return !(map->ctrl[index] & hashMapCtrlEmpty);
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/memory/arena.h"
+#include "core/memory/concurrent_arena.h"
+
+// NOTE(piero): Lock-free queues for handing values between threads. T is copied in and out, keep it small
+//              (a pointer, a handle or a small POD).
+//              SpscQueue:  bounded ring, one producer thread and one consumer thread.
+//              MpmcQueue:  bounded, any number of producers and consumers (Dmitry Vyukov's bounded MPMC queue).
+//              MpscQueue:  unbounded linked queue, any number of producers and one consumer (Vyukov's intrusive MPSC).
+//              Positions and per-side state sit on their own cache lines so producers and consumers don't
+//              false-share.
+
+// SPSC
+// Each side keeps a cached copy of the other side's position and only reloads it when the cached one says the
+// queue is full/empty, so in steady state a push or pop touches no shared cache line except the slot itself.
+template <typename T>
+struct SpscQueue {
+  T* slots;
+  u64 mask;
+
+  alignas(CACHE_LINE_SIZE) u64 writePos;
+  u64 cachedReadPos;
+
+  alignas(CACHE_LINE_SIZE) u64 readPos;
+  u64 cachedWritePos;
+};
+
+// capacity is rounded up to a power of two
+template <typename T>
+SpscQueue<T>* spscQueueAlloc(Arena* arena, u64 capacity) {
+  u64 cap = 1;
+  while (cap < capacity) {
+    cap <<= 1;
+  }
+
+  using Queue = SpscQueue<T>;
+  auto* queue = PushStruct(arena, Queue);
+  queue->slots = PushArrayNoZeroAligned(arena, T, cap, CACHE_LINE_SIZE);
+  queue->mask = cap - 1;
+  return queue;
+}
+
+// Pushes up to count items, returns how many fit
+template <typename T>
+u64 spscQueuePushBatch(SpscQueue<T>* queue, const T* items, u64 count) {
+  u64 writePos = queue->writePos;
+  u64 capacity = queue->mask + 1;
+  if (writePos + count - queue->cachedReadPos > capacity) {
+    queue->cachedReadPos = AtomicLoadU64(&queue->readPos);
+  }
+
+  u64 pushCount = Min(count, capacity - (writePos - queue->cachedReadPos));
+  for (u64 i = 0; i < pushCount; ++i) {
+    queue->slots[(writePos + i) & queue->mask] = items[i];
+  }
+  if (pushCount) {
+    AtomicStoreU64(&queue->writePos, writePos + pushCount);
+  }
+  return pushCount;
+}
+
+// Pops up to count items, returns how many were available
+template <typename T>
+u64 spscQueuePopBatch(SpscQueue<T>* queue, T* items, u64 count) {
+  u64 readPos = queue->readPos;
+  if (readPos + count > queue->cachedWritePos) {
+    queue->cachedWritePos = AtomicLoadU64(&queue->writePos);
+  }
+
+  u64 popCount = Min(count, queue->cachedWritePos - readPos);
+  for (u64 i = 0; i < popCount; ++i) {
+    items[i] = queue->slots[(readPos + i) & queue->mask];
+  }
+  if (popCount) {
+    AtomicStoreU64(&queue->readPos, readPos + popCount);
+  }
+  return popCount;
+}
+
+template <typename T>
+b32 spscQueuePush(SpscQueue<T>* queue, const T& item) {
+  return spscQueuePushBatch(queue, &item, 1) == 1;
+}
+
+template <typename T>
+b32 spscQueuePop(SpscQueue<T>* queue, T* item) {
+  return spscQueuePopBatch(queue, item, 1) == 1;
+}
+
+// MPMC
+// Every cell carries a sequence number telling which lap it's on: seq == pos means free for the producer that
+// claims pos, seq == pos + 1 means it holds the value for the consumer that claims pos. Claiming is a CAS on
+// the shared position, the cell itself is then owned exclusively until its seq is published.
+template <typename T>
+struct MpmcQueueCell {
+  u64 sequence;
+  T value;
+};
+
+template <typename T>
+struct MpmcQueue {
+  MpmcQueueCell<T>* cells;
+  u64 mask;
+
+  alignas(CACHE_LINE_SIZE) u64 enqueuePos;
+  alignas(CACHE_LINE_SIZE) u64 dequeuePos;
+};
+
+// capacity is rounded up to a power of two, minimum 2
+template <typename T>
+MpmcQueue<T>* mpmcQueueAlloc(Arena* arena, u64 capacity) {
+  u64 cap = 2;
+  while (cap < capacity) {
+    cap <<= 1;
+  }
+
+  using Queue = MpmcQueue<T>;
+  using Cell = MpmcQueueCell<T>;
+  auto* queue = PushStruct(arena, Queue);
+  queue->cells = PushArrayNoZeroAligned(arena, Cell, cap, CACHE_LINE_SIZE);
+  queue->mask = cap - 1;
+  for (u64 i = 0; i < cap; ++i) {
+    queue->cells[i].sequence = i;
+  }
+  return queue;
+}
+
+// NOTE(piero): Batches claim a run of consecutive cells with a single CAS. Only the claimer of a position can
+//              change its cell, so cells seen ready before the CAS are still ready after it. The run is cut at
+//              the first cell that isn't ready.
+template <typename T>
+u64 mpmcQueuePushBatch(MpmcQueue<T>* queue, const T* items, u64 count) {
+  u64 pos = AtomicLoadU64(&queue->enqueuePos);
+  for (;;) {
+    u64 ready = 0;
+    while (ready < count && AtomicLoadU64(&queue->cells[(pos + ready) & queue->mask].sequence) == pos + ready) {
+      ready += 1;
+    }
+
+    if (ready == 0) {
+      u64 sequence = AtomicLoadU64(&queue->cells[pos & queue->mask].sequence);
+      if ((i64)(sequence - pos) < 0) {
+        // Full, the cell still holds the value from the previous lap
+        return 0;
+      }
+      // Another producer claimed pos already
+      pos = AtomicLoadU64(&queue->enqueuePos);
+      continue;
+    }
+
+    u64 previous = AtomicCompareExchangeU64(&queue->enqueuePos, pos + ready, pos);
+    if (previous == pos) {
+      for (u64 i = 0; i < ready; ++i) {
+        MpmcQueueCell<T>* cell = &queue->cells[(pos + i) & queue->mask];
+        cell->value = items[i];
+        AtomicStoreU64(&cell->sequence, pos + i + 1);
+      }
+      return ready;
+    }
+    pos = previous;
+  }
+}
+
+template <typename T>
+u64 mpmcQueuePopBatch(MpmcQueue<T>* queue, T* items, u64 count) {
+  u64 pos = AtomicLoadU64(&queue->dequeuePos);
+  for (;;) {
+    u64 ready = 0;
+    while (ready < count && AtomicLoadU64(&queue->cells[(pos + ready) & queue->mask].sequence) == pos + ready + 1) {
+      ready += 1;
+    }
+
+    if (ready == 0) {
+      u64 sequence = AtomicLoadU64(&queue->cells[pos & queue->mask].sequence);
+      if ((i64)(sequence - (pos + 1)) < 0) {
+        // Empty, the producer for pos hasn't published yet
+        return 0;
+      }
+      pos = AtomicLoadU64(&queue->dequeuePos);
+      continue;
+    }
+
+    u64 previous = AtomicCompareExchangeU64(&queue->dequeuePos, pos + ready, pos);
+    if (previous == pos) {
+      for (u64 i = 0; i < ready; ++i) {
+        MpmcQueueCell<T>* cell = &queue->cells[(pos + i) & queue->mask];
+        items[i] = cell->value;
+        // Hand the cell to the producer one lap ahead
+        AtomicStoreU64(&cell->sequence, pos + i + queue->mask + 1);
+      }
+      return ready;
+    }
+    pos = previous;
+  }
+}
+
+template <typename T>
+b32 mpmcQueuePush(MpmcQueue<T>* queue, const T& item) {
+  return mpmcQueuePushBatch(queue, &item, 1) == 1;
+}
+
+template <typename T>
+b32 mpmcQueuePop(MpmcQueue<T>* queue, T* item) {
+  return mpmcQueuePopBatch(queue, item, 1) == 1;
+}
+
+// MPSC
+// Producers swap themselves in as the new head (wait-free) and then link the previous head to them. Between the
+// two steps the chain is briefly broken, the consumer sees that as empty and retries later.
+// Nodes come from a ConcurrentArena so producers never lock. The consumer puts every node it pops on a shared free
+// stack and producers take from it before growing the arena, so the arena only grows to the most nodes ever queued
+// at once. The stack top is a node index tagged with a counter bumped by every change, a producer that read a top
+// which was popped and pushed back in the meantime fails its CAS instead of taking a stale next (ABA).
+// mpscQueueReset drops every node at a point where no producer is running.
+template <typename T>
+struct MpscQueueNode {
+  MpscQueueNode* next;
+  T value;
+};
+
+template <typename T>
+struct MpscQueue {
+  ConcurrentArena* nodeArena;
+
+  alignas(CACHE_LINE_SIZE) MpscQueueNode<T>* head;
+  // Free stack top: tag in the high 32 bits, 1 + the node's offset in nodeArena in the low ones, 0 when empty
+  alignas(CACHE_LINE_SIZE) u64 freeTop;
+
+  alignas(CACHE_LINE_SIZE) MpscQueueNode<T>* tail;
+  MpscQueueNode<T> stub;
+};
+
+template <typename T>
+void mpscQueueReset(MpscQueue<T>* queue) {
+  concurrentArenaClear(queue->nodeArena);
+  queue->stub.next = nullptr;
+  queue->head = &queue->stub;
+  queue->tail = &queue->stub;
+  queue->freeTop = 0;
+}
+
+template <typename T>
+MpscQueue<T>* mpscQueueAlloc(Arena* arena) {
+  using Queue = MpscQueue<T>;
+  auto* queue = PushStruct(arena, Queue);
+  queue->nodeArena = concurrentArenaAlloc({ .reserveSize = Gigabytes(1), .commitSize = concurrentArenaDefaultCommitSize });
+  mpscQueueReset(queue);
+  return queue;
+}
+
+template <typename T>
+void mpscQueueRelease(MpscQueue<T>* queue) {
+  concurrentArenaRelease(queue->nodeArena);
+}
+
+template <typename T>
+void mpscQueuePushNode(MpscQueue<T>* queue, MpscQueueNode<T>* node) {
+  AtomicStorePtr(&node->next, nullptr);
+  auto* previous = (MpscQueueNode<T>*)AtomicExchangePtr(&queue->head, node);
+  AtomicStorePtr(&previous->next, node);
+}
+
+// Nodes are at least 8 byte aligned, so the offset in 8 byte units of a 1GB node arena fits 32 bits
+template <typename T>
+u32 mpscQueueNodeIndex(MpscQueue<T>* queue, MpscQueueNode<T>* node) {
+  if (node == nullptr) {
+    return 0;
+  }
+  return (u32)(((u8*)node - queue->nodeArena->base) / 8) + 1;
+}
+
+template <typename T>
+MpscQueueNode<T>* mpscQueueNodeFromIndex(MpscQueue<T>* queue, u32 index) {
+  if (index == 0) {
+    return nullptr;
+  }
+  return (MpscQueueNode<T>*)(queue->nodeArena->base + (u64)(index - 1) * 8);
+}
+
+template <typename T>
+void mpscQueueFreeNode(MpscQueue<T>* queue, MpscQueueNode<T>* node) {
+  u32 index = mpscQueueNodeIndex(queue, node);
+  u64 top = AtomicLoadU64(&queue->freeTop);
+  for (;;) {
+    AtomicStorePtr(&node->next, mpscQueueNodeFromIndex(queue, (u32)top));
+    u64 newTop = (((top >> 32) + 1) << 32) | index;
+    u64 previous = AtomicCompareExchangeU64(&queue->freeTop, newTop, top);
+    if (previous == top) {
+      return;
+    }
+    top = previous;
+  }
+}
+
+// nullptr when the free stack is empty
+template <typename T>
+MpscQueueNode<T>* mpscQueueTakeNode(MpscQueue<T>* queue) {
+  u64 top = AtomicLoadU64(&queue->freeTop);
+  for (;;) {
+    MpscQueueNode<T>* node = mpscQueueNodeFromIndex(queue, (u32)top);
+    if (node == nullptr) {
+      return nullptr;
+    }
+    // node may already be taken and queued again, its next is then garbage but the tag makes the CAS fail
+    auto* next = (MpscQueueNode<T>*)AtomicLoadPtr(&node->next);
+    u64 newTop = (((top >> 32) + 1) << 32) | mpscQueueNodeIndex(queue, next);
+    u64 previous = AtomicCompareExchangeU64(&queue->freeTop, newTop, top);
+    if (previous == top) {
+      return node;
+    }
+    top = previous;
+  }
+}
+
+// Safe from any thread
+template <typename T>
+void mpscQueuePush(MpscQueue<T>* queue, const T& item) {
+  using Node = MpscQueueNode<T>;
+  Node* node = mpscQueueTakeNode(queue);
+  if (node == nullptr) {
+    node = ConcurrentPushArrayNoZero(queue->nodeArena, Node, 1);
+  }
+  node->value = item;
+  mpscQueuePushNode(queue, node);
+}
+
+// Consumer thread only
+template <typename T>
+b32 mpscQueuePop(MpscQueue<T>* queue, T* item) {
+  MpscQueueNode<T>* tail = queue->tail;
+  auto* next = (MpscQueueNode<T>*)AtomicLoadPtr(&tail->next);
+
+  // Skip the stub, it never carries a value
+  if (tail == &queue->stub) {
+    if (next == nullptr) {
+      return false;
+    }
+    queue->tail = next;
+    tail = next;
+    next = (MpscQueueNode<T>*)AtomicLoadPtr(&tail->next);
+  }
+
+  if (next == nullptr) {
+    // tail might be the last node. Put the stub back behind it so tail can be popped without losing the chain.
+    if (tail != AtomicLoadPtr(&queue->head)) {
+      // A producer is between its exchange and its link
+      return false;
+    }
+    mpscQueuePushNode(queue, &queue->stub);
+    next = (MpscQueueNode<T>*)AtomicLoadPtr(&tail->next);
+    if (next == nullptr) {
+      return false;
+    }
+  }
+
+  *item = tail->value;
+  queue->tail = next;
+  mpscQueueFreeNode(queue, tail);
+  return true;
+}
+
+// Consumer thread only, returns how many were popped
+template <typename T>
+u64 mpscQueuePopBatch(MpscQueue<T>* queue, T* items, u64 count) {
+  u64 popped = 0;
+  while (popped < count && mpscQueuePop(queue, &items[popped])) {
+    popped += 1;
+  }
+  return popped;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/memory/arena.h"
+
+// NOTE(piero): Generational slot map. Values are stored packed in `dense` so iteration is a linear walk, and
+//              handed out as Handle<T> (slot index + generation). Removing a value swaps the last dense entry
+//              into its place and bumps the slot's generation, so stale handles fail to resolve instead of
+//              aliasing whatever reuses the slot. Pointers into `dense` are only valid until the next remove
+//              or insert, hold handles across frames.
+//              Storage grows by doubling out of the arena, the old arrays are left behind in it.
+
+template <typename T>
+struct Handle {
+  u32 index;
+  // 0 is never handed out, a zeroed Handle is always invalid
+  u32 generation;
+};
+
+template <typename T>
+inline b32 handleIsNil(Handle<T> handle) { return handle.generation == 0; }
+
+template <typename T>
+inline b32 operator==(Handle<T> a, Handle<T> b) { return a.index == b.index && a.generation == b.generation; }
+
+struct SlotMapSlot {
+  // Index into dense while alive, next free slot while on the free list
+  u32 denseIndex;
+  u32 generation;
+};
+
+static constexpr u32 slotMapNilIndex = 0xFFFFFFFF;
+
+template <typename T>
+struct SlotMap {
+  Arena* arena;
+
+  T* dense;
+  u32* denseToSlot;
+  u32 count;
+  u32 capacity;
+
+  SlotMapSlot* slots;
+  u32 slotCount;
+  u32 firstFreeSlot;
+};
+
+template <typename T>
+void slotMapInit(SlotMap<T>* map, Arena* arena, u32 capacity = 16) {
+  MemoryZeroStruct(map);
+  map->arena = arena;
+  map->capacity = Max(capacity, 1u);
+  map->dense = PushArrayNoZero(arena, T, map->capacity);
+  map->denseToSlot = PushArrayNoZero(arena, u32, map->capacity);
+  map->slots = PushArrayNoZero(arena, SlotMapSlot, map->capacity);
+  map->firstFreeSlot = slotMapNilIndex;
+}
+
+template <typename T>
+void slotMapGrow(SlotMap<T>* map) {
+  u32 capacity = map->capacity * 2;
+
+  T* dense = PushArrayNoZero(map->arena, T, capacity);
+  u32* denseToSlot = PushArrayNoZero(map->arena, u32, capacity);
+  SlotMapSlot* slots = PushArrayNoZero(map->arena, SlotMapSlot, capacity);
+  MemoryCopy(dense, map->dense, sizeof(T) * map->count);
+  MemoryCopy(denseToSlot, map->denseToSlot, sizeof(u32) * map->count);
+  MemoryCopy(slots, map->slots, sizeof(SlotMapSlot) * map->slotCount);
+
+  map->dense = dense;
+  map->denseToSlot = denseToSlot;
+  map->slots = slots;
+  map->capacity = capacity;
+}
+
+// Reserves a zeroed value and returns its handle, `outValue` points at it until the map is next modified
+template <typename T>
+Handle<T> slotMapAdd(SlotMap<T>* map, T** outValue = nullptr) {
+  if (map->count == map->capacity) {
+    slotMapGrow(map);
+  }
+
+  u32 slotIndex = map->firstFreeSlot;
+  if (slotIndex != slotMapNilIndex) {
+    map->firstFreeSlot = map->slots[slotIndex].denseIndex;
+  } else {
+    slotIndex = map->slotCount++;
+    map->slots[slotIndex].generation = 1;
+  }
+
+  SlotMapSlot* slot = &map->slots[slotIndex];
+  slot->denseIndex = map->count;
+
+  T* value = &map->dense[map->count];
+  MemoryZeroStruct(value);
+  map->denseToSlot[map->count] = slotIndex;
+  map->count += 1;
+
+  if (outValue) {
+    *outValue = value;
+  }
+  return { slotIndex, slot->generation };
+}
+
+template <typename T>
+Handle<T> slotMapInsert(SlotMap<T>* map, const T& value) {
+  T* dst = nullptr;
+  Handle<T> handle = slotMapAdd(map, &dst);
+  *dst = value;
+  return handle;
+}
+
+template <typename T>
+T* slotMapGet(SlotMap<T>* map, Handle<T> handle) {
+  if (handle.index >= map->slotCount) {
+    return nullptr;
+  }
+  SlotMapSlot* slot = &map->slots[handle.index];
+  if (slot->generation != handle.generation || handle.generation == 0) {
+    return nullptr;
+  }
+  return &map->dense[slot->denseIndex];
+}
+
+template <typename T>
+b32 slotMapContains(SlotMap<T>* map, Handle<T> handle) {
+  return slotMapGet(map, handle) != nullptr;
+}
+
+// Handle of the value at a dense index, for going back from iteration to a handle
+template <typename T>
+Handle<T> slotMapHandleAt(SlotMap<T>* map, u32 denseIndex) {
+  Assert(denseIndex < map->count);
+  u32 slotIndex = map->denseToSlot[denseIndex];
+  return { slotIndex, map->slots[slotIndex].generation };
+}
+
+template <typename T>
+b32 slotMapRemove(SlotMap<T>* map, Handle<T> handle) {
+  if (!slotMapContains(map, handle)) {
+    return false;
+  }
+
+  SlotMapSlot* slot = &map->slots[handle.index];
+  u32 lastIndex = map->count - 1;
+  if (slot->denseIndex != lastIndex) {
+    map->dense[slot->denseIndex] = map->dense[lastIndex];
+    u32 movedSlot = map->denseToSlot[lastIndex];
+    map->denseToSlot[slot->denseIndex] = movedSlot;
+    map->slots[movedSlot].denseIndex = slot->denseIndex;
+  }
+  map->count -= 1;
+
+  // Bump now so handles die immediately, not only once the slot is reused. Skip 0 on wrap so a zeroed
+  // handle never resolves.
+  slot->generation += 1;
+  if (slot->generation == 0) {
+    slot->generation = 1;
+  }
+  slot->denseIndex = map->firstFreeSlot;
+  map->firstFreeSlot = handle.index;
+  return true;
+}
+
+template <typename T>
+void slotMapClear(SlotMap<T>* map) {
+  for (u32 i = map->count; i > 0; --i) {
+    slotMapRemove(map, slotMapHandleAt(map, i - 1));
+  }
+}
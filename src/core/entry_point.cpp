@@ -7,15 +7,19 @@ void mainEntryPoint(int argc, char** argv) {
 
   // Init all subsystems
   OS_init();
+  StrIntern_init();
+  JobSystem_init();
 
   Render_init();
 
   // Entry point is defined by the OS layer
   entryPoint();
 
+  JobSystem_shutdown();
+
 #if ENABLE_PROFILING
   EndProfile();
 #endif
 }
 
-static_assert(__COUNTER__ < ArrayCount(Profiler::anchors), "Number of profile points exceeds size of profiler::Anchors array");
+static_assert(__COUNTER__ < PROFILE_ANCHOR_COUNT, "Number of profile points exceeds size of ProfileThread::anchors");
@@ -0,0 +1,278 @@
+#include "fiber_jobs.h"
+
+static FiberJobsState* fiberJobsState = nullptr;
+per_thread FiberWorker* fiberWorkerTls = nullptr;
+
+// NOTE(piero): A fiber can leave on one thread and come back on another, and compilers are free to keep a
+//              per_thread address around across calls. Fiber code reads the worker through this instead.
+#if COMPILER_MSVC
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+static FiberWorker* fiberCurrentWorker() {
+  FiberWorker* volatile worker = fiberWorkerTls;
+  return worker;
+}
+
+static void fiberLock(u32* lock) {
+  while (AtomicCompareExchangeU32(lock, 1, 0) != 0) {
+    CpuPause();
+  }
+}
+
+static void fiberUnlock(u32* lock) {
+  AtomicStoreU32(lock, 0);
+}
+
+static void fiberWakeOne() {
+  FiberJobsState* state = fiberJobsState;
+  if (AtomicLoadU32(&state->sleeperCount) != 0) {
+    AtomicAddU32(&state->wakeEpoch, 1);
+    OS_futexWakeOne(&state->wakeEpoch);
+  }
+}
+
+static void fiberCounterDecrement(FiberCounter* counter) {
+  if (AtomicAddU32(&counter->pending, (u32)-1) != 1) {
+    return;
+  }
+
+  // Waiters register under the lock after checking pending, so taking it here catches every one of them
+  fiberLock(&counter->lock);
+  Fiber* waiters = counter->waiters;
+  counter->waiters = nullptr;
+  fiberUnlock(&counter->lock);
+
+  for (Fiber* fiber = waiters, *next = nullptr; fiber != nullptr; fiber = next) {
+    next = fiber->nextWaiter;
+    fiber->nextWaiter = nullptr;
+    // Never full, it holds at most every fiber
+    mpmcQueuePush(fiberJobsState->readyFibers, fiber);
+    fiberWakeOne();
+  }
+}
+
+static void fiberMain(void* params) {
+  auto* fiber = (Fiber*)params;
+  for (;;) {
+    FiberJob job = fiber->job;
+    job.func(job.params);
+    if (job.counter) {
+      fiberCounterDecrement(job.counter);
+    }
+
+    fiber->state = FiberState_Finished;
+    OS_fiberSwitch(fiber->handle, fiberCurrentWorker()->schedulerFiber);
+  }
+}
+
+static void fiberRun(FiberWorker* worker, Fiber* fiber) {
+  fiber->state = FiberState_Running;
+  worker->current = fiber;
+  ThreadCtx_set(&fiber->threadCtx);
+
+  OS_fiberSwitch(worker->schedulerFiber, fiber->handle);
+
+  ThreadCtx_set(worker->threadCtx);
+  worker->current = nullptr;
+
+  // A parked fiber can be resumed elsewhere as soon as its counter lock is released, so look at it before that
+  if (fiber->state == FiberState_Finished) {
+    fiber->state = FiberState_Free;
+    mpmcQueuePush(fiberJobsState->freeFibers, fiber);
+  }
+  if (worker->unlockAfterSwitch) {
+    fiberUnlock(worker->unlockAfterSwitch);
+    worker->unlockAfterSwitch = nullptr;
+  }
+}
+
+// Resumed fibers first, they hold on to a fiber and whatever their job allocated
+static Fiber* fiberFindWork() {
+  FiberJobsState* state = fiberJobsState;
+  Fiber* fiber = nullptr;
+  if (mpmcQueuePop(state->readyFibers, &fiber)) {
+    return fiber;
+  }
+
+  if (!mpmcQueuePop(state->freeFibers, &fiber)) {
+    return nullptr;
+  }
+  for (u32 priority = 0; priority < JobPriority_COUNT; ++priority) {
+    if (mpmcQueuePop(state->jobQueues[priority], &fiber->job)) {
+      return fiber;
+    }
+  }
+  mpmcQueuePush(state->freeFibers, fiber);
+  return nullptr;
+}
+
+static void fiberWorkerMain(void* params) {
+  auto* worker = (FiberWorker*)params;
+  FiberJobsState* state = fiberJobsState;
+  fiberWorkerTls = worker;
+  worker->threadCtx = ThreadCtx_get();
+  worker->schedulerFiber = OS_fiberThreadEnter();
+
+  u32 spins = 0;
+  while (AtomicLoadU32(&state->stop) == 0) {
+    Fiber* fiber = fiberFindWork();
+    if (fiber) {
+      fiberRun(worker, fiber);
+      spins = 0;
+      continue;
+    }
+
+    if (++spins < JOB_SPIN_COUNT) {
+      CpuPause();
+      continue;
+    }
+    spins = 0;
+
+    // Same sleep protocol as the job system, see jobWakeOne
+    u32 epoch = AtomicLoadU32(&state->wakeEpoch);
+    AtomicAddU32(&state->sleeperCount, 1);
+    fiber = fiberFindWork();
+    if (!fiber && AtomicLoadU32(&state->stop) == 0) {
+      OS_futexWait(&state->wakeEpoch, epoch);
+    }
+    AtomicAddU32(&state->sleeperCount, (u32)-1);
+    if (fiber) {
+      fiberRun(worker, fiber);
+    }
+  }
+
+  OS_fiberThreadExit(worker->schedulerFiber);
+}
+
+void FiberJobs_init(FiberJobsParams params) {
+  u32 workerCount = params.workerCount ? params.workerCount : OS_logicalProcessorCount();
+  u64 pageSize = OS_pageSize();
+  u64 stackSize = AlignPow2(params.stackSize, pageSize);
+
+  Arena* arena = ArenaAllocDefault();
+  FiberJobsState* state = PushStruct(arena, FiberJobsState);
+  state->arena = arena;
+  state->workerCount = workerCount;
+  state->fiberCount = params.fiberCount;
+  state->workers = PushArrayAligned(arena, FiberWorker, workerCount, CACHE_LINE_SIZE);
+  state->fibers = PushArray(arena, Fiber, params.fiberCount);
+  state->freeFibers = mpmcQueueAlloc<Fiber*>(arena, params.fiberCount);
+  state->readyFibers = mpmcQueueAlloc<Fiber*>(arena, params.fiberCount);
+  for (u32 priority = 0; priority < JobPriority_COUNT; ++priority) {
+    state->jobQueues[priority] = mpmcQueueAlloc<FiberJob>(arena, FIBER_JOB_QUEUE_CAPACITY);
+  }
+
+  // Each stack gets a guard page below it, decommitted so an overflow faults instead of running into the next stack
+#if PLATFORM_LINUX
+  state->stackArena = arenaAlloc({ .flags = ArenaFlag_NoChain, .reserveSize = (stackSize + pageSize) * params.fiberCount + ARENA_HEADER_SIZE + pageSize, .name = Str8L("Fiber Stacks") });
+#endif
+  for (u32 i = 0; i < params.fiberCount; ++i) {
+    Fiber* fiber = &state->fibers[i];
+    u8* stack = nullptr;
+#if PLATFORM_LINUX
+    u8* guard = (u8*)arenaPush(state->stackArena, stackSize + pageSize, pageSize);
+    OS_decommit(guard, pageSize);
+    stack = guard + pageSize;
+#endif
+    fiber->handle = OS_fiberCreate(stack, stackSize, fiberMain, fiber);
+    fiber->threadCtx = ThreadCtx_alloc();
+    mpmcQueuePush(state->freeFibers, fiber);
+  }
+
+  fiberJobsState = state;
+
+  Temp scratch = ScratchBegin();
+  for (u32 i = 0; i < workerCount; ++i) {
+    FiberWorker* worker = &state->workers[i];
+    worker->index = i;
+    String8 name = PushStr8F(scratch.arena, "Fiber Worker %u", i);
+    worker->thread = OS_threadLaunch(fiberWorkerMain, worker, { .name = name });
+  }
+  ScratchEnd(scratch);
+}
+
+void FiberJobs_shutdown() {
+  FiberJobsState* state = fiberJobsState;
+  if (state == nullptr) {
+    return;
+  }
+
+  AtomicStoreU32(&state->stop, 1);
+  AtomicAddU32(&state->wakeEpoch, 1);
+  OS_futexWakeAll(&state->wakeEpoch);
+  for (u32 i = 0; i < state->workerCount; ++i) {
+    OS_threadJoin(state->workers[i].thread);
+  }
+
+  ThreadCtx* threadCtx = ThreadCtx_get();
+  for (u32 i = 0; i < state->fiberCount; ++i) {
+    Fiber* fiber = &state->fibers[i];
+    OS_fiberRelease(fiber->handle);
+    ThreadCtx_set(&fiber->threadCtx);
+    ThreadCtx_release();
+  }
+  ThreadCtx_set(threadCtx);
+
+  fiberJobsState = nullptr;
+  if (state->stackArena) {
+    arenaRelease(state->stackArena);
+  }
+  arenaRelease(state->arena);
+}
+
+b32 fiberJobIsInFiber() {
+  FiberWorker* worker = fiberCurrentWorker();
+  return worker != nullptr && worker->current != nullptr;
+}
+
+void fiberJobSubmit(JobFunction* func, void* params, FiberCounter* counter, JobPriority priority) {
+  FiberJob job = { .func = func, .params = params, .counter = counter };
+  if (counter) {
+    AtomicAddU32(&counter->pending, 1);
+  }
+
+  if (fiberJobsState == nullptr || !mpmcQueuePush(fiberJobsState->jobQueues[priority], job)) {
+    // Not running, or the queue is full
+    func(params);
+    if (counter) {
+      fiberCounterDecrement(counter);
+    }
+    return;
+  }
+  fiberWakeOne();
+}
+
+void fiberJobWait(FiberCounter* counter) {
+  if (AtomicLoadU32(&counter->pending) == 0) {
+    return;
+  }
+
+  FiberWorker* worker = fiberCurrentWorker();
+  if (worker == nullptr || worker->current == nullptr) {
+    u32 spins = 0;
+    while (AtomicLoadU32(&counter->pending) != 0) {
+      if (++spins < JOB_SPIN_COUNT) {
+        CpuPause();
+      } else {
+        OS_threadYield();
+      }
+    }
+    return;
+  }
+
+  Fiber* fiber = worker->current;
+  fiberLock(&counter->lock);
+  if (AtomicLoadU32(&counter->pending) == 0) {
+    fiberUnlock(&counter->lock);
+    return;
+  }
+
+  fiber->nextWaiter = counter->waiters;
+  counter->waiters = fiber;
+  fiber->state = FiberState_Waiting;
+  // Still holding the lock: until this context is saved nobody may pick the fiber off the waiters list
+  worker->unlockAfterSwitch = &counter->lock;
+  OS_fiberSwitch(fiber->handle, worker->schedulerFiber);
+}
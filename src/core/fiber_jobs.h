@@ -0,0 +1,98 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/thread_context.h"
+#include "core/job_system.h"
+#include "core/data_structures/queue.h"
+
+// NOTE(piero): Fiber job runtime. Every job runs on a fiber from a fixed pool, and fiberJobWait parks the fiber
+//              instead of the worker thread: the worker goes back to its scheduler loop and runs something else,
+//              and the fiber is put on the ready queue by whoever finishes the last job of the counter. Any worker
+//              may resume it, so dependency chains (load -> decode -> upload) can be written as straight code.
+//              Fibers have their own ThreadCtx: a parked fiber keeps its scratch arenas across the wait, and the
+//              worker switches ThreadCtx along with the fiber.
+//              A queued job only starts once a fiber is free. If every fiber is parked waiting on jobs that are
+//              still queued nothing can run them, so size fiberCount for the most waits in flight, or give the
+//              jobs being waited on a higher priority than the jobs waiting on them.
+//              Don't cache per_thread values across fiberJobWait, the fiber may come back on another thread.
+
+static constexpr u32 fiberJobsDefaultFiberCount = 128;
+static constexpr u64 fiberJobsDefaultStackSize = Kilobytes(256);
+#define FIBER_JOB_QUEUE_CAPACITY 4096
+
+struct FiberJobsParams {
+  // 0 picks one worker per logical processor
+  u32 workerCount{};
+  u32 fiberCount{ fiberJobsDefaultFiberCount };
+  u64 stackSize{ fiberJobsDefaultStackSize };
+};
+
+struct Fiber;
+
+// Submitting increments pending, finishing a job decrements it. Fibers waiting on it sit in waiters until it hits 0.
+struct FiberCounter {
+  u32 pending;
+  u32 lock;
+  Fiber* waiters;
+};
+
+struct FiberJob {
+  JobFunction* func;
+  void* params;
+  FiberCounter* counter;
+};
+
+enum FiberState {
+  FiberState_Free,
+  FiberState_Running,
+  FiberState_Waiting,
+  FiberState_Finished,
+};
+
+struct Fiber {
+  OS_Handle handle;
+  ThreadCtx threadCtx;
+  FiberJob job;
+  FiberState state;
+  Fiber* nextWaiter;
+};
+
+struct alignas(CACHE_LINE_SIZE) FiberWorker {
+  OS_Handle thread;
+  // The worker thread itself, turned into a fiber. Runs the scheduler loop.
+  OS_Handle schedulerFiber;
+  ThreadCtx* threadCtx;
+  Fiber* current;
+  // Counter lock a fiber still holds when it parks itself, released by the scheduler once the switch is done
+  u32* unlockAfterSwitch;
+  u32 index;
+};
+
+struct FiberJobsState {
+  Arena* arena;
+  Arena* stackArena;
+
+  FiberWorker* workers;
+  u32 workerCount;
+
+  Fiber* fibers;
+  u32 fiberCount;
+  MpmcQueue<Fiber*>* freeFibers;
+  MpmcQueue<Fiber*>* readyFibers;
+  MpmcQueue<FiberJob>* jobQueues[JobPriority_COUNT];
+
+  alignas(CACHE_LINE_SIZE) u32 wakeEpoch;
+  u32 sleeperCount;
+  u32 stop;
+};
+
+void FiberJobs_init(FiberJobsParams params = {});
+// Outstanding jobs are dropped, wait on their counters first
+void FiberJobs_shutdown();
+
+// counter may be nullptr
+void fiberJobSubmit(JobFunction* func, void* params, FiberCounter* counter, JobPriority priority = JobPriority_Normal);
+// Inside a fiber job this parks the fiber until counter reaches 0. Elsewhere it spins and yields the thread.
+void fiberJobWait(FiberCounter* counter);
+// True when called from a fiber job
+b32 fiberJobIsInFiber();
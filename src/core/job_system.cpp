@@ -0,0 +1,350 @@
+#include "job_system.h"
+#include "core/core_strings.h"
+#include "core/thread_context.h"
+#include "core/thread_placement.h"
+
+static JobSystemState* jobSystemState = nullptr;
+per_thread u32 jobWorkerIndexTls = 0xFFFFFFFF;
+
+// Deque
+// NOTE(piero): Chase-Lev with every access sequentially consistent. A thief may read a slot the owner is about to
+//              reuse, but the owner only reuses slot top once top has moved past it, which makes the thief's CAS fail.
+
+static b32 jobDequePush(JobDeque* deque, Job job) {
+  u64 bottom = deque->bottom;
+  u64 top = AtomicLoadU64(&deque->top);
+  if ((i64)(bottom - top) >= JOB_DEQUE_CAPACITY) {
+    return false;
+  }
+  deque->slots[bottom & (JOB_DEQUE_CAPACITY - 1)] = job;
+  AtomicStoreU64(&deque->bottom, bottom + 1);
+  return true;
+}
+
+// Owner only, takes the newest job
+static b32 jobDequePop(JobDeque* deque, Job* job) {
+  u64 bottom = deque->bottom - 1;
+  AtomicStoreU64(&deque->bottom, bottom);
+  u64 top = AtomicLoadU64(&deque->top);
+
+  if ((i64)(bottom - top) < 0) {
+    // Empty
+    AtomicStoreU64(&deque->bottom, top);
+    return false;
+  }
+
+  *job = deque->slots[bottom & (JOB_DEQUE_CAPACITY - 1)];
+  if (bottom != top) {
+    return true;
+  }
+
+  // Last job, race the thieves for it
+  b32 won = AtomicCompareExchangeU64(&deque->top, top + 1, top) == top;
+  AtomicStoreU64(&deque->bottom, top + 1);
+  return won;
+}
+
+// Any thread, takes the oldest job
+static b32 jobDequeSteal(JobDeque* deque, Job* job) {
+  u64 top = AtomicLoadU64(&deque->top);
+  u64 bottom = AtomicLoadU64(&deque->bottom);
+  if ((i64)(bottom - top) <= 0) {
+    return false;
+  }
+
+  *job = deque->slots[top & (JOB_DEQUE_CAPACITY - 1)];
+  return AtomicCompareExchangeU64(&deque->top, top + 1, top) == top;
+}
+
+// Scheduling
+
+u32 jobWorkerIndex() {
+  return jobWorkerIndexTls;
+}
+
+static JobWorker* jobCurrentWorker() {
+  u32 index = jobWorkerIndexTls;
+  return index != 0xFFFFFFFF ? &jobSystemState->workers[index] : nullptr;
+}
+
+// Own deque first, then submissions from outside, then other workers, one priority level at a time
+static b32 jobFind(JobWorker* self, Job* job) {
+  JobSystemState* state = jobSystemState;
+  for (u32 priority = 0; priority < JobPriority_COUNT; ++priority) {
+    if (self && jobDequePop(&self->deques[priority], job)) {
+      return true;
+    }
+    if (mpmcQueuePop(state->injectQueues[priority], job)) {
+      return true;
+    }
+
+    u32 start = self ? self->stealSeed++ : 0;
+    for (u32 i = 0; i < state->workerCount; ++i) {
+      JobWorker* victim = &state->workers[(start + i) % state->workerCount];
+      if (victim != self && jobDequeSteal(&victim->deques[priority], job)) {
+        if (self) {
+          self->jobsStolen += 1;
+        }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static void jobRun(JobWorker* self, Job job) {
+  job.func(job.params);
+  if (job.counter) {
+    AtomicAddU32(&job.counter->pending, (u32)-1);
+  }
+  if (self) {
+    self->jobsRun += 1;
+  }
+}
+
+// NOTE(piero): A worker going to sleep reads wakeEpoch, registers as a sleeper and looks for work once more before
+//              waiting on the epoch it read. A submitter pushes first and only then checks for sleepers, so either
+//              the worker's last look finds the job or the submitter sees the sleeper and bumps the epoch.
+static void jobWakeOne() {
+  JobSystemState* state = jobSystemState;
+  if (AtomicLoadU32(&state->sleeperCount) != 0) {
+    AtomicAddU32(&state->wakeEpoch, 1);
+    OS_futexWakeOne(&state->wakeEpoch);
+  }
+}
+
+static void jobWorkerMain(void* params) {
+  auto* worker = (JobWorker*)params;
+  JobSystemState* state = jobSystemState;
+  jobWorkerIndexTls = worker->index;
+
+  u32 spins = 0;
+  while (AtomicLoadU32(&state->stop) == 0) {
+    Job job;
+    if (jobFind(worker, &job)) {
+      jobRun(worker, job);
+      spins = 0;
+      continue;
+    }
+
+    if (++spins < JOB_SPIN_COUNT) {
+      CpuPause();
+      continue;
+    }
+    spins = 0;
+
+    u32 epoch = AtomicLoadU32(&state->wakeEpoch);
+    AtomicAddU32(&state->sleeperCount, 1);
+    b32 found = jobFind(worker, &job);
+    if (!found && AtomicLoadU32(&state->stop) == 0) {
+      // Workers have no frame of their own, every sleep counts as one for the scratch decommit policy. A worker
+      // that never runs dry keeps its scratch committed, it's using it.
+      ThreadCtx_endFrame();
+      OS_futexWait(&state->wakeEpoch, epoch);
+    }
+    AtomicAddU32(&state->sleeperCount, (u32)-1);
+    if (found) {
+      jobRun(worker, job);
+    }
+  }
+}
+
+void JobSystem_init(u32 workerCount) {
+  const ThreadPlacement* placement = threadPlacement();
+  if (workerCount == 0) {
+    workerCount = placement->workerCount;
+  }
+
+  Arena* arena = ArenaAllocDefault();
+  JobSystemState* state = PushStruct(arena, JobSystemState);
+  state->arena = arena;
+  state->workerCount = workerCount;
+  state->workers = PushArrayAligned(arena, JobWorker, workerCount, CACHE_LINE_SIZE);
+  for (u32 priority = 0; priority < JobPriority_COUNT; ++priority) {
+    state->injectQueues[priority] = mpmcQueueAlloc<Job>(arena, JOB_INJECT_QUEUE_CAPACITY);
+  }
+
+  for (u32 i = 0; i < workerCount; ++i) {
+    JobWorker* worker = &state->workers[i];
+    worker->index = i;
+    worker->stealSeed = i + 1;
+    for (u32 priority = 0; priority < JobPriority_COUNT; ++priority) {
+      worker->deques[priority].slots = PushArrayNoZeroAligned(arena, Job, JOB_DEQUE_CAPACITY, CACHE_LINE_SIZE);
+    }
+  }
+  jobSystemState = state;
+
+  // The calling thread is worker 0
+  jobWorkerIndexTls = 0;
+  if (placement->mainMask != 0) {
+    ThreadCtx_setAffinity(placement->mainMask);
+  }
+  Temp scratch = ScratchBegin();
+  for (u32 i = 1; i < workerCount; ++i) {
+    String8 name = PushStr8F(scratch.arena, "Job Worker %u", i);
+    state->workers[i].thread = OS_threadLaunch(jobWorkerMain, &state->workers[i], { .name = name, .affinityMask = threadPlacementWorkerMask(i) });
+  }
+  ScratchEnd(scratch);
+}
+
+// Outstanding jobs are dropped, wait on their counters first
+void JobSystem_shutdown() {
+  JobSystemState* state = jobSystemState;
+  if (state == nullptr) {
+    return;
+  }
+
+  AtomicStoreU32(&state->stop, 1);
+  AtomicAddU32(&state->wakeEpoch, 1);
+  OS_futexWakeAll(&state->wakeEpoch);
+  for (u32 i = 1; i < state->workerCount; ++i) {
+    OS_threadJoin(state->workers[i].thread);
+  }
+
+  jobSystemState = nullptr;
+  jobWorkerIndexTls = 0xFFFFFFFF;
+  arenaRelease(state->arena);
+}
+
+u32 JobSystem_workerCount() {
+  return jobSystemState ? jobSystemState->workerCount : 1;
+}
+
+JobSystemStats JobSystem_stats() {
+  JobSystemStats stats = {};
+  if (jobSystemState) {
+    stats.workerCount = jobSystemState->workerCount;
+    for (u32 i = 0; i < jobSystemState->workerCount; ++i) {
+      stats.jobsRun += jobSystemState->workers[i].jobsRun;
+      stats.jobsStolen += jobSystemState->workers[i].jobsStolen;
+    }
+  }
+  return stats;
+}
+
+void jobSubmit(JobFunction* func, void* params, JobCounter* counter, JobPriority priority) {
+  Job job = { .func = func, .params = params, .counter = counter };
+  if (counter) {
+    AtomicAddU32(&counter->pending, 1);
+  }
+
+  JobSystemState* state = jobSystemState;
+  if (state == nullptr || state->workerCount <= 1) {
+    jobRun(nullptr, job);
+    return;
+  }
+
+  JobWorker* self = jobCurrentWorker();
+  b32 queued = self ? jobDequePush(&self->deques[priority], job) : mpmcQueuePush(state->injectQueues[priority], job);
+  if (!queued) {
+    // Full, running it here is the back pressure
+    jobRun(self, job);
+    return;
+  }
+  jobWakeOne();
+}
+
+void jobWait(JobCounter* counter) {
+  JobWorker* self = jobSystemState ? jobCurrentWorker() : nullptr;
+  u32 spins = 0;
+  while (AtomicLoadU32(&counter->pending) != 0) {
+    Job job;
+    if (jobSystemState && jobFind(self, &job)) {
+      jobRun(self, job);
+      spins = 0;
+    } else if (++spins < JOB_SPIN_COUNT) {
+      CpuPause();
+    } else {
+      // The last jobs are running on other workers
+      OS_threadYield();
+    }
+  }
+}
+
+b32 jobTryRunOne() {
+  if (jobSystemState == nullptr) {
+    return false;
+  }
+
+  JobWorker* self = jobCurrentWorker();
+  Job job;
+  if (!jobFind(self, &job)) {
+    return false;
+  }
+  jobRun(self, job);
+  return true;
+}
+
+// ParallelFor
+
+struct ParallelForState;
+
+struct ParallelForRange {
+  ParallelForState* state;
+  u64 begin;
+  u64 end;
+};
+
+struct ParallelForState {
+  ParallelForFunction* func;
+  void* params;
+  u64 grain;
+  JobPriority priority;
+  JobCounter counter;
+
+  // Every split takes one. Halving down to grain leaves fewer than 2 * count / grain + 1 ranges.
+  ParallelForRange* ranges;
+  u64 rangeCapacity;
+  u64 rangeCount;
+};
+
+static void parallelForJob(void* ptr) {
+  auto* range = (ParallelForRange*)ptr;
+  ParallelForState* state = range->state;
+  u64 begin = range->begin;
+  u64 end = range->end;
+
+  while (end - begin > state->grain) {
+    u64 middle = begin + (end - begin) / 2;
+    u64 index = AtomicAddU64(&state->rangeCount, 1);
+    Assert(index < state->rangeCapacity);
+
+    ParallelForRange* split = &state->ranges[index];
+    split->state = state;
+    split->begin = middle;
+    split->end = end;
+    jobSubmit(parallelForJob, split, &state->counter, state->priority);
+    end = middle;
+  }
+
+  state->func(state->params, begin, end);
+}
+
+void parallelFor(u64 count, u64 grain, ParallelForFunction* func, void* params, JobPriority priority) {
+  if (count == 0) {
+    return;
+  }
+
+  u32 workerCount = JobSystem_workerCount();
+  if (grain == 0) {
+    grain = Max(count / (8 * (u64)workerCount), (u64)1);
+  }
+  if (workerCount <= 1 || count <= grain) {
+    func(params, 0, count);
+    return;
+  }
+
+  Temp scratch = ScratchBegin();
+  ParallelForState* state = PushStruct(scratch.arena, ParallelForState);
+  state->func = func;
+  state->params = params;
+  state->grain = grain;
+  state->priority = priority;
+  state->rangeCapacity = 2 * (count / grain) + 2;
+  state->ranges = PushArrayNoZero(scratch.arena, ParallelForRange, state->rangeCapacity);
+
+  ParallelForRange root = { .state = state, .begin = 0, .end = count };
+  parallelForJob(&root);
+  jobWait(&state->counter);
+  ScratchEnd(scratch);
+}
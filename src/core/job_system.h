@@ -0,0 +1,98 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/data_structures/queue.h"
+
+// NOTE(piero): Work-stealing job system. Every worker owns one Chase-Lev deque per priority: it pushes and pops
+//              its own jobs at the bottom (LIFO, cache warm) while idle workers steal from the top (FIFO, oldest
+//              and usually biggest work first). Threads that aren't workers submit through a shared MPMC queue.
+//              The thread that calls JobSystem_init becomes worker 0 and runs jobs while it waits on a counter.
+//              Workers are OS_threadLaunch threads, so each has its own ThreadCtx and ScratchBegin works in jobs.
+//              Scratch memory must be released before the job returns, the worker runs other jobs next.
+//              Idle workers spin briefly, then sleep on a futex until something is submitted.
+//              Before JobSystem_init (and with 0 extra workers) jobs simply run inline on the submitting thread.
+
+using JobFunction = void(void* params);
+
+enum JobPriority {
+  JobPriority_High,
+  JobPriority_Normal,
+  JobPriority_Low,
+  JobPriority_COUNT
+};
+
+// Tracks a group of jobs. Submitting increments it, finishing a job decrements it, 0 means the group is done.
+struct JobCounter {
+  u32 pending;
+};
+
+struct Job {
+  JobFunction* func;
+  void* params;
+  JobCounter* counter;
+};
+
+// Power of two. A full deque runs the job inline instead of pushing it.
+#define JOB_DEQUE_CAPACITY 4096
+#define JOB_INJECT_QUEUE_CAPACITY 4096
+#define JOB_SPIN_COUNT 256
+
+// top only moves forward (thieves CAS it), bottom is written by the owner only. Compared as i64 since the owner
+// briefly sets bottom below top when popping from an empty deque.
+struct JobDeque {
+  alignas(CACHE_LINE_SIZE) u64 top;
+  alignas(CACHE_LINE_SIZE) u64 bottom;
+  Job* slots;
+};
+
+struct alignas(CACHE_LINE_SIZE) JobWorker {
+  JobDeque deques[JobPriority_COUNT];
+  OS_Handle thread;
+  u32 index;
+  // Where this worker starts looking for a victim, so idle workers don't all hammer the same deque
+  u32 stealSeed;
+  u64 jobsRun;
+  u64 jobsStolen;
+};
+
+struct JobSystemState {
+  Arena* arena;
+  JobWorker* workers;
+  u32 workerCount;
+
+  MpmcQueue<Job>* injectQueues[JobPriority_COUNT];
+
+  alignas(CACHE_LINE_SIZE) u32 wakeEpoch;
+  u32 sleeperCount;
+  u32 stop;
+};
+
+struct JobSystemStats {
+  u32 workerCount;
+  u64 jobsRun;
+  u64 jobsStolen;
+};
+
+// workerCount counts the calling thread, 0 takes threadPlacement's workers, one per physical core it hands out.
+// The calling thread is pinned to the placement's main core and workers to theirs.
+void JobSystem_init(u32 workerCount = 0);
+void JobSystem_shutdown();
+u32 JobSystem_workerCount();
+JobSystemStats JobSystem_stats();
+
+// Index of the calling worker, u32Max on threads that aren't workers
+u32 jobWorkerIndex();
+
+// counter may be nullptr for fire-and-forget jobs
+void jobSubmit(JobFunction* func, void* params, JobCounter* counter, JobPriority priority = JobPriority_Normal);
+// Runs other jobs until counter reaches 0
+void jobWait(JobCounter* counter);
+// Runs one queued job if there is any, for threads that wait on something other than a JobCounter
+b32 jobTryRunOne();
+
+// Calls func(params, begin, end) over disjoint ranges covering [0, count) and returns once all of them ran.
+// grain is the largest range run as a single call, 0 picks count / (8 * workerCount) so every worker gets several
+// pieces to balance with. A range job halves itself until it is down to grain, keeping the lower half and pushing
+// the upper one, so the biggest pieces sit at the top of the deque where thieves take them first.
+using ParallelForFunction = void(void* params, u64 begin, u64 end);
+void parallelFor(u64 count, u64 grain, ParallelForFunction* func, void* params, JobPriority priority = JobPriority_Normal);
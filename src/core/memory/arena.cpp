@@ -8,17 +8,112 @@ Arena* arenaAlloc(u64 size) {
   return arenaAlloc({ .flags = arenaDefaultFlags, .reserveSize = size, .commitSize = arenaDefaultCommitSize });
 }
 
+static void arenaPrefaultThread(void* params) {
+  auto* prefaulter = (ArenaPrefaulter*)params;
+  u64 pageSize = OS_pageSize();
+
+  for (;;) {
+    OS_semaphoreWait(prefaulter->wakeup);
+    if (AtomicLoadU32(&prefaulter->stop)) {
+      break;
+    }
+
+    auto* block = (Arena*)AtomicLoadPtr(&prefaulter->requestBlock);
+    if (block == nullptr) {
+      continue;
+    }
+
+    // NOTE(piero): Claim the block, then make sure the owner didn't retract it in the meantime.
+    //              Paired with arenaPrefaultDetach.
+    AtomicStorePtr(&prefaulter->activeBlock, block);
+    if (AtomicLoadPtr(&prefaulter->requestBlock) == block) {
+      u64 target = AlignDownPow2(ClampTop(AtomicLoadU64(&prefaulter->requestTarget), block->reserved), pageSize);
+      u64 prefaulted = AtomicLoadU64(&block->prefaulted);
+      if (target > prefaulted) {
+        u8* ptr = (u8*)block + prefaulted;
+        OS_commit(ptr, target - prefaulted);
+        OS_prefault(ptr, target - prefaulted);
+        AtomicStoreU64(&block->prefaulted, target);
+      }
+    }
+    AtomicStorePtr(&prefaulter->activeBlock, nullptr);
+  }
+}
+
+static ArenaPrefaulter* arenaPrefaulterAlloc(u64 distance) {
+  u64 size = AlignPow2(sizeof(ArenaPrefaulter), OS_pageSize());
+  auto* prefaulter = (ArenaPrefaulter*)OS_reserve(size);
+  OS_commit(prefaulter, size);
+  MemoryZeroStruct(prefaulter);
+  prefaulter->distance = distance;
+  prefaulter->wakeup = OS_semaphoreAlloc(0, u32Max >> 1);
+  prefaulter->thread = OS_threadLaunch(arenaPrefaultThread, prefaulter, { .name = Str8L("Arena Prefault") });
+  return prefaulter;
+}
+
+static void arenaPrefaulterRelease(ArenaPrefaulter* prefaulter) {
+  AtomicStoreU32(&prefaulter->stop, 1);
+  OS_semaphoreSignal(prefaulter->wakeup);
+  OS_threadJoin(prefaulter->thread);
+  OS_semaphoreRelease(prefaulter->wakeup);
+  OS_release(prefaulter, AlignPow2(sizeof(ArenaPrefaulter), OS_pageSize()));
+}
+
+static void arenaPrefaultRequest(ArenaPrefaulter* prefaulter, Arena* block, u64 target) {
+  AtomicStoreU64(&prefaulter->requestTarget, target);
+  AtomicStorePtr(&prefaulter->requestBlock, block);
+  OS_semaphoreSignal(prefaulter->wakeup);
+}
+
+// Must be called before releasing a block the helper might be working on
+static void arenaPrefaultDetach(ArenaPrefaulter* prefaulter, Arena* block) {
+  if (AtomicLoadPtr(&prefaulter->requestBlock) == block) {
+    AtomicStorePtr(&prefaulter->requestBlock, nullptr);
+  }
+  while (AtomicLoadPtr(&prefaulter->activeBlock) == block) {
+    CpuPause();
+  }
+}
+
 Arena* arenaAlloc(ArenaParams params) {
   auto reserveSize = params.reserveSize;
   auto commitSize = params.commitSize;
 
   reserveSize = AlignPow2(reserveSize, OS_pageSize());
   commitSize = AlignPow2(commitSize, OS_pageSize());
+  commitSize = ClampTop(commitSize, reserveSize);
+
+  u64 commitGranularity = params.commitSize;
+  ArenaPageKind pageKind = ArenaPageKind_Small;
 
   void* base = params.optionalBackingBuffer;
   if (base == nullptr) {
-    base = OS_reserve(reserveSize);
-    OS_commit(base, commitSize);
+    if (params.flags & ArenaFlag_LargePages) {
+      u64 largePageSize = OS_largePageSize();
+      reserveSize = AlignPow2(reserveSize, largePageSize);
+      base = OS_reserveLarge(reserveSize);
+      if (base != nullptr) {
+        pageKind = ArenaPageKind_Large;
+        commitSize = reserveSize;
+      } else {
+        base = OS_reserve(reserveSize);
+        if (base != nullptr && OS_adviseHugePages(base, reserveSize)) {
+          // NOTE(piero): Commit in whole huge pages, partial mprotects would split them again
+          pageKind = ArenaPageKind_TransparentHuge;
+          commitSize = ClampTop(AlignPow2(commitSize, largePageSize), reserveSize);
+          commitGranularity = Max(commitGranularity, largePageSize);
+        }
+      }
+    } else {
+      base = OS_reserve(reserveSize);
+    }
+
+    if (base != nullptr && pageKind != ArenaPageKind_Large) {
+      OS_commit(base, commitSize);
+    }
+    if (base != nullptr && (params.flags & ArenaFlag_Prefault)) {
+      OS_prefault(base, commitSize);
+    }
   }
 
   if (base == nullptr) {
@@ -26,15 +121,29 @@ Arena* arenaAlloc(ArenaParams params) {
   }
 
   auto* arena = (Arena*)base;
+  arena->prev = nullptr;
   arena->current = arena;
   arena->flags = params.flags;
   arena->nameSize = params.name.size;
-  arena->commitedSize = (u32)params.commitSize;
+  arena->pageKind = pageKind;
+  arena->commitedSize = commitGranularity;
   arena->reservedSize = params.reserveSize;
   arena->basePos = 0;
   arena->pos = ARENA_HEADER_SIZE;
   arena->commited = commitSize;
   arena->reserved = reserveSize;
+  arena->prefaulted = commitSize;
+  arena->prefaulter = nullptr;
+  arena->decommitThreshold = params.decommitThreshold;
+  arena->decommitFrames = params.decommitFrames;
+  arena->framesInWindow = 0;
+  arena->highWater = ARENA_HEADER_SIZE;
+  arena->frameHighWater = ARENA_HEADER_SIZE;
+  arena->windowHighWater = ARENA_HEADER_SIZE;
+  arena->decommitted = 0;
+  if (params.flags & ArenaFlag_BackgroundPrefault) {
+    arena->prefaulter = arenaPrefaulterAlloc(params.prefaultDistance);
+  }
   AsanPoisonMemoryRegion(base, commitSize);
   AsanUnpoisonMemoryRegion(base, ARENA_HEADER_SIZE);
 
@@ -47,6 +156,9 @@ Arena* arenaAlloc(ArenaParams params) {
   return arena;
 }
 void arenaRelease(Arena* arena) {
+  if (arena->prefaulter != nullptr) {
+    arenaPrefaulterRelease(arena->prefaulter);
+  }
   for (Arena *a = arena->current, *prev = nullptr; a != nullptr; a = prev) {
     prev = a->prev;
     OS_release(a, a->reserved);
@@ -62,26 +174,91 @@ String8 arenaName(Arena* arena) {
   return result;
 }
 
+ArenaStats arenaStats(Arena* arena) {
+  ArenaStats stats = {};
+  for (Arena* block = arena->current; block != nullptr; block = block->prev) {
+    stats.blockCount += 1;
+    stats.reserved += block->reserved;
+    stats.commited += block->commited;
+    stats.used += block->pos;
+    if (block->pageKind == ArenaPageKind_Large) {
+      stats.largePageCommited += block->commited;
+    } else if (block->pageKind == ArenaPageKind_TransparentHuge) {
+      stats.hugePageAdvised += block->commited;
+    }
+  }
+  if (arena->prefaulter != nullptr) {
+    stats.prefaultPagesAvoided = arena->prefaulter->pagesAvoided;
+    stats.prefaultPagesTaken = arena->prefaulter->pagesTaken;
+  }
+  stats.highWater = Max(arena->highWater, arenaPos(arena));
+  stats.decommitted = arena->decommitted;
+  return stats;
+}
+
+static void arenaCommitTo(Arena* arena, Arena* current, u64 newPos) {
+  if (current->commited < newPos) {
+    ArenaPrefaulter* prefaulter = arena->prefaulter;
+    u64 prefaulted = (prefaulter != nullptr) ? AtomicLoadU64(&current->prefaulted) : 0;
+
+    if (prefaulted >= newPos) {
+      // the prefault thread already got here
+      prefaulter->pagesAvoided += (prefaulted - current->commited) / OS_pageSize();
+      current->commited = prefaulted;
+    } else {
+      auto commitAligned = newPos + current->commitedSize - 1;
+      commitAligned -= commitAligned % current->commitedSize;
+      auto commitClamped = ClampTop(commitAligned, current->reserved);
+      auto commitSize = commitClamped - current->commited;
+
+      u8* commitPtr = (u8*)current + current->commited;
+      OS_commit(commitPtr, commitSize);
+      if (current->flags & ArenaFlag_Prefault) {
+        OS_prefault(commitPtr, commitSize);
+      }
+
+      current->commited = commitClamped;
+      if (prefaulter != nullptr) {
+        prefaulter->pagesTaken += commitSize / OS_pageSize();
+      }
+    }
+
+    if (prefaulter != nullptr) {
+      arenaPrefaultRequest(prefaulter, current, newPos + prefaulter->distance);
+    }
+  }
+}
+
 void* arenaPush(Arena* arena, u64 size, u64 align) {
   Arena* current = arena->current;
   u64 lastPos = AlignPow2(current->pos, align);
   u64 newPos = lastPos + size;
 
-  // TODO(piero): Implement chaining logic
+  // chain a new block if needed
+  if (current->reserved < newPos && !(current->flags & ArenaFlag_NoChain)) {
+    u64 reserveSize = Max(ClampTop(current->reservedSize * 2, arenaMaxBlockReserveSize), current->reservedSize);
+    u64 commitSize = current->commitedSize;
+    u64 fitSize = ARENA_HEADER_SIZE + align + size;
+    if (reserveSize < fitSize) {
+      reserveSize = fitSize;
+      commitSize = fitSize;
+    }
 
-  // commit memory if needed
-  if (current->commited < newPos) {
-    auto commitAligned = newPos + current->commitedSize - 1;
-    commitAligned -= commitAligned % current->commitedSize;
-    auto commitClamped = ClampTop(commitAligned, current->reserved);
-    auto commitSize = commitClamped - current->commited;
+    // NOTE(piero): Chained blocks share the first block's prefault thread
+    Arena* block = arenaAlloc({ .flags = current->flags & ~ArenaFlag_BackgroundPrefault, .reserveSize = reserveSize, .commitSize = commitSize });
+    block->flags = current->flags;
+    block->commitedSize = current->commitedSize;
+    block->basePos = current->basePos + current->reserved;
+    StackPush_N(arena->current, block, prev);
 
-    u8* commitPtr = (u8*)current + current->commited;
-    OS_commit(commitPtr, commitSize);
-
-    current->commited = commitClamped;
+    current = block;
+    lastPos = AlignPow2(current->pos, align);
+    newPos = lastPos + size;
   }
 
+  // commit memory if needed
+  arenaCommitTo(arena, current, newPos);
+
   void* result = nullptr;
   if (current->commited >= newPos) {
     result = (u8*)current + lastPos;
@@ -96,17 +273,74 @@ void* arenaPush(Arena* arena, u64 size, u64 align) {
   return result;
 }
 
+b32 arenaTryGrow(Arena* arena, void* ptr, u64 oldSize, u64 newSize) {
+  Arena* current = arena->current;
+  u8* blockStart = (u8*)current;
+  u8* end = (u8*)ptr + oldSize;
+
+  // Only the most recent allocation of the current block can grow without moving
+  if ((u8*)ptr < blockStart + ARENA_HEADER_SIZE || end != blockStart + current->pos) {
+    return false;
+  }
+
+  u64 newPos = (u64)((u8*)ptr - blockStart) + newSize;
+  if (newPos > current->reserved) {
+    return false;
+  }
+
+  if (newPos > current->pos) {
+    arenaCommitTo(arena, current, newPos);
+    if (current->commited < newPos) {
+      return false;
+    }
+    AsanUnpoisonMemoryRegion(end, newPos - current->pos);
+  }
+  current->pos = newPos;
+  return true;
+}
+
 u64 arenaPos(Arena* arena) {
   Arena* current = arena->current;
   u64 pos = current->basePos + current->pos;
   return pos;
 }
 
+// Decommits whatever is committed in block past keepPos, rounded up to the block's commit granularity
+static void arenaDecommitAbove(Arena* arena, Arena* block, u64 keepPos) {
+  // NOTE(piero): Explicit large pages are committed for the whole block at reserve time
+  if (block->pageKind == ArenaPageKind_Large) {
+    return;
+  }
+
+  u64 keep = keepPos + block->commitedSize - 1;
+  keep -= keep % block->commitedSize;
+  keep = ClampTop(AlignPow2(keep, OS_pageSize()), block->reserved);
+
+  u64 top = Max(block->commited, block->prefaulted);
+  if (top > keep) {
+    if (arena->prefaulter != nullptr) {
+      arenaPrefaultDetach(arena->prefaulter, block);
+      top = Max(block->commited, AtomicLoadU64(&block->prefaulted));
+    }
+    OS_decommit((u8*)block + keep, top - keep);
+    arena->decommitted += top - keep;
+    block->commited = keep;
+    block->prefaulted = keep;
+  }
+}
+
 void arenaPopTo(Arena* arena, u64 pos) {
+  u64 oldPos = arenaPos(arena);
+  arena->highWater = Max(arena->highWater, oldPos);
+  arena->frameHighWater = Max(arena->frameHighWater, oldPos);
+
   u64 big_pos = (ARENA_HEADER_SIZE > pos) ? ARENA_HEADER_SIZE : pos;
   Arena* current = arena->current;
   for (Arena* prev = nullptr; current->basePos >= big_pos; current = prev) {
     prev = current->prev;
+    if (arena->prefaulter != nullptr) {
+      arenaPrefaultDetach(arena->prefaulter, current);
+    }
     OS_release(current, current->reserved);
   }
   arena->current = current;
@@ -114,6 +348,10 @@ void arenaPopTo(Arena* arena, u64 pos) {
   assert(new_pos <= current->pos);
   AsanPoisonMemoryRegion((u8*)current + new_pos, (current->pos - new_pos));
   current->pos = new_pos;
+
+  if (arena->decommitThreshold != 0) {
+    arenaDecommitAbove(arena, current, new_pos + arena->decommitThreshold);
+  }
 }
 
 void arenaClear(Arena* arena) {
@@ -129,6 +367,27 @@ void arenaPop(Arena* arena, u64 amt) {
   arenaPopTo(arena, pos_new);
 }
 
+void arenaEndFrame(Arena* arena) {
+  if (arena->decommitFrames == 0) {
+    return;
+  }
+
+  u64 pos = arenaPos(arena);
+  arena->windowHighWater = Max(arena->windowHighWater, Max(arena->frameHighWater, pos));
+  arena->frameHighWater = pos;
+  arena->framesInWindow += 1;
+
+  if (arena->framesInWindow >= arena->decommitFrames) {
+    Arena* current = arena->current;
+    u64 keepPos = ClampBot(arena->windowHighWater, current->basePos) - current->basePos;
+    arenaDecommitAbove(arena, current, Max(keepPos, current->pos));
+
+    arena->highWater = Max(arena->highWater, arena->windowHighWater);
+    arena->windowHighWater = pos;
+    arena->framesInWindow = 0;
+  }
+}
+
 Temp tempBegin(Arena* arena) {
   u64 pos = arenaPos(arena);
   Temp temp = { .arena = arena, .pos = pos };
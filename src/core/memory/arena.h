@@ -1,18 +1,38 @@
 #pragma once
 
 #include "core/core.h"
+#include "platform/os/core/os_core.h"
 
-constexpr u32 ARENA_HEADER_SIZE = 128;
+constexpr u32 ARENA_HEADER_SIZE = 256;
 
 using ArenaFlags = u32;
 enum {
   ArenaFlag_NoChain = (1 << 0),
+  // Back blocks with large pages, falling back to transparent huge pages and then to regular pages.
+  ArenaFlag_LargePages = (1 << 1),
+  // Fault in pages as they get committed instead of on first touch.
+  ArenaFlag_Prefault = (1 << 2),
+  // Spawn a helper thread that commits and faults in pages prefaultDistance bytes ahead of pos.
+  ArenaFlag_BackgroundPrefault = (1 << 3),
+};
+
+enum ArenaPageKind {
+  ArenaPageKind_Small,
+  ArenaPageKind_Large,
+  ArenaPageKind_TransparentHuge,
 };
 
 
 static constexpr u64 arenaDefaultReserveSize = Megabytes(64);
 static constexpr u64 arenaDefaultCommitSize = Kilobytes(64);
 static constexpr ArenaFlags arenaDefaultFlags = 0;
+static constexpr u64 arenaDefaultPrefaultDistance = Megabytes(4);
+static constexpr u64 arenaDefaultDecommitThreshold = 0;
+static constexpr u32 arenaDefaultDecommitFrames = 0;
+
+// NOTE(piero): Chained blocks double the reserve size of the block before them, up to this cap.
+//              Pushes bigger than a block get a block sized to fit them.
+static constexpr u64 arenaMaxBlockReserveSize = Gigabytes(1);
 
 struct ArenaParams {
   ArenaFlags flags{ arenaDefaultFlags };
@@ -20,6 +40,33 @@ struct ArenaParams {
   u64 commitSize{ arenaDefaultCommitSize };
   void* optionalBackingBuffer{};
   String8 name{};
+  u64 prefaultDistance{ arenaDefaultPrefaultDistance };
+  // Decommit policy, 0 disables each of them.
+  // decommitThreshold: on pop, decommit everything committed more than this many bytes past the new pos.
+  // decommitFrames: every N calls to arenaEndFrame, decommit everything above the peak of those N frames.
+  u64 decommitThreshold{ arenaDefaultDecommitThreshold };
+  u32 decommitFrames{ arenaDefaultDecommitFrames };
+};
+
+struct Arena;
+
+// NOTE(piero): State shared between an arena's owning thread and its background prefault thread.
+//              The owner publishes a (block, target) request, the helper commits and touches the block up
+//              to target and publishes block->prefaulted. activeBlock lets the owner wait for the helper
+//              to be done with a block before releasing it.
+struct ArenaPrefaulter {
+  OS_Handle thread;
+  OS_Handle wakeup;
+  u64 distance;
+
+  Arena* requestBlock;
+  u64 requestTarget;
+  Arena* activeBlock;
+  u32 stop;
+
+  // Pages the owner found already committed by the helper vs pages it had to commit itself
+  u64 pagesAvoided;
+  u64 pagesTaken;
 };
 
 struct Arena {
@@ -27,12 +74,42 @@ struct Arena {
   Arena* current;
   ArenaFlags flags;
   u32 nameSize;
+  ArenaPageKind pageKind;
   u64 commitedSize;
   u64 reservedSize;
   u64 basePos;
   u64 pos;
   u64 commited;
   u64 reserved;
+  u64 prefaulted;
+  ArenaPrefaulter* prefaulter;
+
+  // Only used on the first block
+  u64 decommitThreshold;
+  u32 decommitFrames;
+  u32 framesInWindow;
+  u64 highWater;
+  u64 frameHighWater;
+  u64 windowHighWater;
+  u64 decommitted;
+};
+
+static_assert(sizeof(Arena) <= ARENA_HEADER_SIZE, "Arena header doesn't fit in ARENA_HEADER_SIZE");
+
+struct ArenaStats {
+  u64 blockCount;
+  u64 reserved;
+  u64 commited;
+  u64 used;
+  // Committed bytes backed by explicit large pages
+  u64 largePageCommited;
+  // Committed bytes in blocks advised for transparent huge pages. The kernel decides the actual backing.
+  u64 hugePageAdvised;
+  u64 prefaultPagesAvoided;
+  u64 prefaultPagesTaken;
+  // Highest arenaPos ever reached, and total bytes handed back to the OS by the decommit policy
+  u64 highWater;
+  u64 decommitted;
 };
 
 struct Temp {
@@ -46,14 +123,21 @@ Arena* arenaAlloc(ArenaParams params);
 void arenaRelease(Arena* arena);
 
 String8 arenaName(Arena* arena);
+ArenaStats arenaStats(Arena* arena);
 
 void* arenaPush(Arena* arena, u64 size, u64 align);
+// Grows the most recent allocation of the arena in place to newSize by bumping pos. Fails (returns false) when ptr
+// isn't the last allocation or the current block can't fit it.
+b32 arenaTryGrow(Arena* arena, void* ptr, u64 oldSize, u64 newSize);
 u64 arenaPos(Arena* arena);
 void arenaPopTo(Arena* arena, u64 pos);
 
 void arenaClear(Arena* arena);
 void arenaPop(Arena* arena, u64 amt);
 
+// Applies the decommitFrames policy. Call once per frame for arenas that use it.
+void arenaEndFrame(Arena* arena);
+
 Temp tempBegin(Arena* arena);
 void tempEnd(Temp temp);
 
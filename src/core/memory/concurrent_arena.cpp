@@ -0,0 +1,110 @@
+#include "concurrent_arena.h"
+#include "platform/os/core/os_core.h"
+
+ConcurrentArena* concurrentArenaAlloc(ArenaParams params) {
+  u64 reserveSize = AlignPow2(params.reserveSize, OS_pageSize());
+  u64 commitSize = AlignPow2(params.commitSize, OS_pageSize());
+  u64 headerSize = AlignPow2(sizeof(ConcurrentArena) + params.name.size, CACHE_LINE_SIZE);
+  commitSize = ClampTop(Max(commitSize, headerSize), reserveSize);
+
+  u8* base = (u8*)OS_reserve(reserveSize);
+  if (base == nullptr) {
+    OS_abort();
+  }
+  OS_commit(base, commitSize);
+
+  auto* arena = (ConcurrentArena*)base;
+  arena->pos = headerSize;
+  arena->commited = commitSize;
+  arena->commitSize = commitSize;
+  arena->reserved = reserveSize;
+  arena->base = base;
+  arena->name = Str8(base + sizeof(ConcurrentArena), params.name.size);
+  MemoryCopy(arena->name.str, params.name.str, params.name.size);
+
+  AsanPoisonMemoryRegion(base + headerSize, commitSize - headerSize);
+
+  return arena;
+}
+
+void concurrentArenaRelease(ConcurrentArena* arena) {
+  OS_release(arena->base, arena->reserved);
+}
+
+// Makes sure [0, endPos) is committed. Lock-free: threads that race here may commit overlapping ranges,
+// which is harmless, and the watermark only ever moves forward once the commit it describes is done.
+static void concurrentArenaEnsureCommitted(ConcurrentArena* arena, u64 endPos) {
+  u64 commited = AtomicLoadU64(&arena->commited);
+  if (Likely(endPos <= commited)) {
+    return;
+  }
+
+  u64 target = AlignPow2(endPos, arena->commitSize);
+  target = ClampTop(target, arena->reserved);
+  OS_commit(arena->base + commited, target - commited);
+
+  for (;;) {
+    u64 prev = AtomicCompareExchangeU64(&arena->commited, target, commited);
+    if (prev == commited || prev >= target) {
+      break;
+    }
+    commited = prev;
+  }
+}
+
+void* concurrentArenaPush(ConcurrentArena* arena, u64 size, u64 align) {
+  // NOTE(piero): pos always stays 8-aligned, so only bigger alignments need padding in the claimed range
+  u64 claimSize = AlignPow2(size, 8) + (align > 8 ? align - 8 : 0);
+  u64 claimPos = AtomicAddU64(&arena->pos, claimSize);
+  u64 lastPos = AlignPow2(claimPos, align);
+  u64 newPos = lastPos + size;
+
+  if (Unlikely(newPos > arena->reserved)) {
+    OS_abort();
+  }
+
+  concurrentArenaEnsureCommitted(arena, newPos);
+
+  void* result = arena->base + lastPos;
+  AsanUnpoisonMemoryRegion(result, size);
+  return result;
+}
+
+u64 concurrentArenaPos(ConcurrentArena* arena) {
+  return AtomicLoadU64(&arena->pos);
+}
+
+void concurrentArenaClear(ConcurrentArena* arena) {
+  u64 headerSize = AlignPow2(sizeof(ConcurrentArena) + arena->name.size, CACHE_LINE_SIZE);
+  AsanPoisonMemoryRegion(arena->base + headerSize, arena->pos - headerSize);
+  AtomicStoreU64(&arena->pos, headerSize);
+}
+
+ConcurrentArenaBlock concurrentArenaBlockBegin(ConcurrentArena* arena, u64 blockSize) {
+  ConcurrentArenaBlock block = { .arena = arena, .base = nullptr };
+  block.blockSize = blockSize;
+  return block;
+}
+
+void* concurrentArenaBlockPush(ConcurrentArenaBlock* block, u64 size, u64 align) {
+  u64 basePtr = IntFromPtr(block->base);
+  u64 lastPos = AlignPow2(basePtr + block->pos, align) - basePtr;
+  u64 newPos = lastPos + size;
+
+  if (Unlikely(block->base == nullptr || newPos > block->size)) {
+    // Pushes bigger than a block go straight to the shared arena, so the current block keeps its tail
+    if (size + align > block->blockSize) {
+      return concurrentArenaPush(block->arena, size, align);
+    }
+
+    block->base = (u8*)concurrentArenaPush(block->arena, block->blockSize, CACHE_LINE_SIZE);
+    block->size = block->blockSize;
+
+    basePtr = IntFromPtr(block->base);
+    lastPos = AlignPow2(basePtr, align) - basePtr;
+    newPos = lastPos + size;
+  }
+
+  block->pos = newPos;
+  return block->base + lastPos;
+}
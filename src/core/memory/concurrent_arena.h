@@ -0,0 +1,52 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/memory/arena.h"
+
+// NOTE(piero): Multi-producer bump allocator. The whole range is reserved up front and never chained,
+//              so a push is a single atomic add on pos. Commits are done by whichever thread crosses the
+//              commit watermark; OS_commit on an already committed range is a no-op, so racing threads
+//              never wait on each other.
+//              Clearing is not thread safe: it must happen while no thread is pushing (e.g. once per frame).
+
+static constexpr u64 concurrentArenaDefaultReserveSize = Gigabytes(8);
+static constexpr u64 concurrentArenaDefaultCommitSize = Megabytes(1);
+static constexpr u64 concurrentArenaDefaultBlockSize = Kilobytes(64);
+
+struct ConcurrentArena {
+  alignas(CACHE_LINE_SIZE) u64 pos;
+  alignas(CACHE_LINE_SIZE) u64 commited;
+  alignas(CACHE_LINE_SIZE) u64 commitSize;
+  u64 reserved;
+  u8* base;
+  String8 name;
+};
+
+// Thread-local sub-block carved out of a ConcurrentArena. Workers push into their own block without
+// touching shared state, and only go back to the shared arena when the block runs out.
+struct ConcurrentArenaBlock {
+  ConcurrentArena* arena;
+  u8* base;
+  u64 pos;
+  u64 size;
+  u64 blockSize;
+};
+
+ConcurrentArena* concurrentArenaAlloc(ArenaParams params);
+#define ConcurrentArenaAllocDefault() concurrentArenaAlloc({ .reserveSize = concurrentArenaDefaultReserveSize, .commitSize = concurrentArenaDefaultCommitSize })
+void concurrentArenaRelease(ConcurrentArena* arena);
+
+void* concurrentArenaPush(ConcurrentArena* arena, u64 size, u64 align);
+u64 concurrentArenaPos(ConcurrentArena* arena);
+void concurrentArenaClear(ConcurrentArena* arena);
+
+ConcurrentArenaBlock concurrentArenaBlockBegin(ConcurrentArena* arena, u64 blockSize = concurrentArenaDefaultBlockSize);
+void* concurrentArenaBlockPush(ConcurrentArenaBlock* block, u64 size, u64 align);
+
+#define ConcurrentPushArrayNoZero(a, T, c) (T*)concurrentArenaPush((a), sizeof(T) * (c), Max(8, alignof(T)))
+#define ConcurrentPushArray(a, T, c) (T*)MemoryZero(ConcurrentPushArrayNoZero(a, T, c), sizeof(T) * (c))
+#define ConcurrentPushStruct(a, T) ConcurrentPushArray(a, T, 1)
+
+#define BlockPushArrayNoZero(b, T, c) (T*)concurrentArenaBlockPush((b), sizeof(T) * (c), Max(8, alignof(T)))
+#define BlockPushArray(b, T, c) (T*)MemoryZero(BlockPushArrayNoZero(b, T, c), sizeof(T) * (c))
+#define BlockPushStruct(b, T) BlockPushArray(b, T, 1)
@@ -0,0 +1,116 @@
+#include "pool.h"
+
+void poolInit(Pool* pool, Arena* arena, u64 elementSize, u64 elementAlign, u64 slabSize) {
+  Assert((elementAlign & (elementAlign - 1)) == 0);
+
+  MemoryZeroStruct(pool);
+  pool->arena = arena;
+  pool->elementSize = AlignPow2(Max(elementSize, (u64)sizeof(PoolFreeNode)), Max(elementAlign, (u64)alignof(PoolFreeNode)));
+  pool->elementsPerSlab = Max(slabSize / pool->elementSize, (u64)1);
+}
+
+Pool* poolCreate(Arena* arena, u64 elementSize, u64 elementAlign, u64 slabSize) {
+  Pool* pool = PushStruct(arena, Pool);
+  poolInit(pool, arena, elementSize, elementAlign, slabSize);
+  return pool;
+}
+
+static void poolRefill(Pool* pool) {
+  u64 slabBytes = pool->elementSize * pool->elementsPerSlab;
+  u8* slab = (u8*)arenaPush(pool->arena, slabBytes, CACHE_LINE_SIZE);
+
+  // Thread back to front so the free list pops in address order
+  for (u64 i = pool->elementsPerSlab; i > 0; --i) {
+    auto* node = (PoolFreeNode*)(slab + (i - 1) * pool->elementSize);
+    StackPush(pool->freeList, node);
+  }
+  pool->slabCount += 1;
+  pool->freeCount += pool->elementsPerSlab;
+}
+
+void* poolAllocNoZero(Pool* pool) {
+  if (pool->freeList == nullptr) {
+    poolRefill(pool);
+  }
+
+  PoolFreeNode* node = pool->freeList;
+  StackPop(pool->freeList);
+  pool->freeCount -= 1;
+  pool->usedCount += 1;
+  return node;
+}
+
+void* poolAlloc(Pool* pool) {
+  return MemoryZero(poolAllocNoZero(pool), pool->elementSize);
+}
+
+void poolFree(Pool* pool, void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  auto* node = (PoolFreeNode*)ptr;
+  StackPush(pool->freeList, node);
+  pool->freeCount += 1;
+  pool->usedCount -= 1;
+}
+
+u64 poolAllocBatch(Pool* pool, void** out, u64 count) {
+  while (pool->freeCount < count) {
+    poolRefill(pool);
+  }
+
+  PoolFreeNode* node = pool->freeList;
+  for (u64 i = 0; i < count; ++i) {
+    out[i] = node;
+    node = node->next;
+  }
+  pool->freeList = node;
+  pool->freeCount -= count;
+  pool->usedCount += count;
+  return count;
+}
+
+void poolFreeBatch(Pool* pool, void** ptrs, u64 count) {
+  if (count == 0) {
+    return;
+  }
+
+  // Link the batch together first so it's spliced onto the free list with a single head update
+  for (u64 i = 0; i + 1 < count; ++i) {
+    ((PoolFreeNode*)ptrs[i])->next = (PoolFreeNode*)ptrs[i + 1];
+  }
+  ((PoolFreeNode*)ptrs[count - 1])->next = pool->freeList;
+  pool->freeList = (PoolFreeNode*)ptrs[0];
+  pool->freeCount += count;
+  pool->usedCount -= count;
+}
+
+PoolClasses* poolClassesCreate(Arena* arena) {
+  PoolClasses* classes = PushStruct(arena, PoolClasses);
+  for (u32 i = 0; i < POOL_CLASS_COUNT; ++i) {
+    u64 size = (u64)1 << (POOL_CLASS_MIN_LOG2 + i);
+    poolInit(&classes->pools[i], arena, size, Min(size, (u64)CACHE_LINE_SIZE));
+  }
+  return classes;
+}
+
+static u32 poolClassIndex(u64 size) {
+  u32 index = 0;
+  u64 classSize = (u64)1 << POOL_CLASS_MIN_LOG2;
+  while (classSize < size) {
+    classSize <<= 1;
+    index += 1;
+  }
+  return index;
+}
+
+void* poolClassesAlloc(PoolClasses* classes, u64 size) {
+  Assert(size <= poolClassMaxSize);
+  return poolAlloc(&classes->pools[poolClassIndex(size)]);
+}
+
+void poolClassesFree(PoolClasses* classes, void* ptr, u64 size) {
+  Assert(size <= poolClassMaxSize);
+  poolFree(&classes->pools[poolClassIndex(size)], ptr);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/memory/arena.h"
+
+// NOTE(piero): Fixed-size block pool on top of an Arena. Blocks come from cache-line aligned slabs pushed on
+//              the arena and are recycled through an intrusive free list, so steady-state alloc/free is O(1)
+//              and never grows the arena. A fresh slab is threaded in address order, consecutive allocations
+//              are adjacent in memory.
+//              Slabs are never handed back, they live as long as the arena. Not thread safe.
+
+static constexpr u64 poolDefaultSlabSize = Kilobytes(16);
+
+struct PoolFreeNode {
+  PoolFreeNode* next;
+};
+
+struct Pool {
+  Arena* arena;
+  PoolFreeNode* freeList;
+
+  u64 elementSize;
+  u64 elementsPerSlab;
+
+  u64 slabCount;
+  u64 usedCount;
+  u64 freeCount;
+};
+
+Pool* poolCreate(Arena* arena, u64 elementSize, u64 elementAlign = 8, u64 slabSize = poolDefaultSlabSize);
+void poolInit(Pool* pool, Arena* arena, u64 elementSize, u64 elementAlign = 8, u64 slabSize = poolDefaultSlabSize);
+
+void* poolAllocNoZero(Pool* pool);
+void* poolAlloc(Pool* pool);
+void poolFree(Pool* pool, void* ptr);
+
+// Batch versions refill slabs up front and touch the free list head once
+u64 poolAllocBatch(Pool* pool, void** out, u64 count);
+void poolFreeBatch(Pool* pool, void** ptrs, u64 count);
+
+#define PoolPushStructNoZero(p, T) (T*)poolAllocNoZero(p)
+#define PoolPushStruct(p, T) (T*)poolAlloc(p)
+#define PoolCreateTyped(a, T) poolCreate((a), sizeof(T), Max(8, alignof(T)))
+
+// Size classes: one pool per power of two from 16 to 1KB. The caller passes the size back on free, so
+// blocks carry no header.
+#define POOL_CLASS_MIN_LOG2 4
+#define POOL_CLASS_COUNT 7
+static constexpr u64 poolClassMaxSize = (u64)1 << (POOL_CLASS_MIN_LOG2 + POOL_CLASS_COUNT - 1);
+
+struct PoolClasses {
+  Pool pools[POOL_CLASS_COUNT];
+};
+
+PoolClasses* poolClassesCreate(Arena* arena);
+void* poolClassesAlloc(PoolClasses* classes, u64 size);
+void poolClassesFree(PoolClasses* classes, void* ptr, u64 size);
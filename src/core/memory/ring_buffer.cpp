@@ -0,0 +1,80 @@
+#include "ring_buffer.h"
+
+RingBuffer* ringBufferAlloc(Arena* arena, u64 size) {
+  u64 granularity = OS_allocationGranularity();
+  u64 ringSize = granularity;
+  while (ringSize < size) {
+    ringSize <<= 1;
+  }
+
+  OS_Handle handle = {};
+  u8* base = (u8*)OS_ringAlloc(ringSize, &handle);
+  if (base == nullptr) {
+    OS_abort();
+  }
+
+  RingBuffer* ring = PushStruct(arena, RingBuffer);
+  ring->base = base;
+  ring->size = ringSize;
+  ring->handle = handle;
+  return ring;
+}
+
+void ringBufferRelease(RingBuffer* ring) {
+  OS_ringRelease(ring->base, ring->size, ring->handle);
+  MemoryZeroStruct(ring);
+}
+
+u64 ringBufferReadable(RingBuffer* ring) {
+  return AtomicLoadU64(&ring->writePos) - AtomicLoadU64(&ring->readPos);
+}
+
+u64 ringBufferWritable(RingBuffer* ring) {
+  return ring->size - ringBufferReadable(ring);
+}
+
+u8* ringBufferWriteBegin(RingBuffer* ring, u64 size) {
+  u8* result = nullptr;
+  if (size <= ringBufferWritable(ring)) {
+    result = ring->base + (ring->writePos & (ring->size - 1));
+  }
+  return result;
+}
+
+void ringBufferWriteEnd(RingBuffer* ring, u64 size) {
+  Assert(size <= ringBufferWritable(ring));
+  AtomicStoreU64(&ring->writePos, ring->writePos + size);
+}
+
+u8* ringBufferReadBegin(RingBuffer* ring, u64 size) {
+  u8* result = nullptr;
+  if (size <= ringBufferReadable(ring)) {
+    result = ring->base + (ring->readPos & (ring->size - 1));
+  }
+  return result;
+}
+
+void ringBufferReadEnd(RingBuffer* ring, u64 size) {
+  Assert(size <= ringBufferReadable(ring));
+  AtomicStoreU64(&ring->readPos, ring->readPos + size);
+}
+
+u64 ringBufferWrite(RingBuffer* ring, void* data, u64 size) {
+  u8* dst = ringBufferWriteBegin(ring, size);
+  if (dst == nullptr) {
+    return 0;
+  }
+  MemoryCopy(dst, data, size);
+  ringBufferWriteEnd(ring, size);
+  return size;
+}
+
+u64 ringBufferRead(RingBuffer* ring, void* data, u64 size) {
+  u8* src = ringBufferReadBegin(ring, size);
+  if (src == nullptr) {
+    return 0;
+  }
+  MemoryCopy(data, src, size);
+  ringBufferReadEnd(ring, size);
+  return size;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/memory/arena.h"
+#include "platform/os/core/os_core.h"
+
+// NOTE(piero): Ring buffer backed by a mirrored mapping: the same physical pages are mapped twice back to
+//              back, so any range of up to size bytes starting anywhere in the ring is contiguous in memory.
+//              Readers and writers never have to split a copy at the wrap point and can work in place.
+//              Single producer / single consumer safe; readPos and writePos only ever grow.
+
+struct RingBuffer {
+  u8* base;
+  u64 size;
+  OS_Handle handle;
+  alignas(CACHE_LINE_SIZE) u64 writePos;
+  alignas(CACHE_LINE_SIZE) u64 readPos;
+};
+
+// size is rounded up to a power of two multiple of the OS allocation granularity
+RingBuffer* ringBufferAlloc(Arena* arena, u64 size);
+void ringBufferRelease(RingBuffer* ring);
+
+u64 ringBufferReadable(RingBuffer* ring);
+u64 ringBufferWritable(RingBuffer* ring);
+
+// Zero-copy access. Begin returns a contiguous pointer (nullptr if there isn't enough data/space),
+// End publishes/consumes the bytes.
+u8* ringBufferWriteBegin(RingBuffer* ring, u64 size);
+void ringBufferWriteEnd(RingBuffer* ring, u64 size);
+u8* ringBufferReadBegin(RingBuffer* ring, u64 size);
+void ringBufferReadEnd(RingBuffer* ring, u64 size);
+
+// Copying helpers, return the number of bytes written/read (all or nothing)
+u64 ringBufferWrite(RingBuffer* ring, void* data, u64 size);
+u64 ringBufferRead(RingBuffer* ring, void* data, u64 size);
+
+#define RingBufferWriteStruct(ring, ptr) ringBufferWrite((ring), (ptr), sizeof(*(ptr)))
+#define RingBufferReadStruct(ring, ptr) ringBufferRead((ring), (ptr), sizeof(*(ptr)))
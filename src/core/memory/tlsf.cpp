@@ -0,0 +1,520 @@
+#include "tlsf.h"
+
+#if COMPILER_MSVC
+#include <intrin.h>
+#endif
+
+// Block layout helpers
+static constexpr u64 heapBlockFreeBit = (1 << 0);
+static constexpr u64 heapBlockPrevFreeBit = (1 << 1);
+
+// Only the size field is paid per block, prevPhys lives in the previous block's payload
+static constexpr u64 heapBlockOverhead = sizeof(u64);
+static constexpr u64 heapBlockStartOffset = sizeof(HeapBlock*) + sizeof(u64);
+static constexpr u64 heapBlockSizeMin = sizeof(HeapBlock) - sizeof(HeapBlock*);
+static constexpr u64 heapBlockSizeMax = (u64)1 << HEAP_FL_MAX;
+static constexpr u64 heapPoolOverhead = 2 * heapBlockOverhead;
+
+static u32 heapFfs(u32 word) {
+#if COMPILER_MSVC
+  unsigned long index = 0;
+  _BitScanForward(&index, word);
+  return index;
+#else
+  return __builtin_ctz(word);
+#endif
+}
+
+static u32 heapFls(u64 word) {
+#if COMPILER_MSVC
+  unsigned long index = 0;
+  _BitScanReverse64(&index, word);
+  return index;
+#else
+  return 63 - __builtin_clzll(word);
+#endif
+}
+
+static u64 heapBlockGetSize(HeapBlock* block) {
+  return block->size & ~(heapBlockFreeBit | heapBlockPrevFreeBit);
+}
+
+static void heapBlockSetSize(HeapBlock* block, u64 size) {
+  block->size = size | (block->size & (heapBlockFreeBit | heapBlockPrevFreeBit));
+}
+
+static b32 heapBlockIsLast(HeapBlock* block) {
+  return heapBlockGetSize(block) == 0;
+}
+
+static b32 heapBlockIsFree(HeapBlock* block) {
+  return (block->size & heapBlockFreeBit) != 0;
+}
+
+static b32 heapBlockIsPrevFree(HeapBlock* block) {
+  return (block->size & heapBlockPrevFreeBit) != 0;
+}
+
+static void heapBlockSetFree(HeapBlock* block) { block->size |= heapBlockFreeBit; }
+static void heapBlockSetUsed(HeapBlock* block) { block->size &= ~heapBlockFreeBit; }
+static void heapBlockSetPrevFree(HeapBlock* block) { block->size |= heapBlockPrevFreeBit; }
+static void heapBlockSetPrevUsed(HeapBlock* block) { block->size &= ~heapBlockPrevFreeBit; }
+
+static HeapBlock* heapBlockFromPtr(void* ptr) {
+  return (HeapBlock*)((u8*)ptr - heapBlockStartOffset);
+}
+
+static void* heapBlockToPtr(HeapBlock* block) {
+  return (u8*)block + heapBlockStartOffset;
+}
+
+static HeapBlock* heapBlockNext(HeapBlock* block) {
+  return (HeapBlock*)((u8*)heapBlockToPtr(block) + heapBlockGetSize(block) - heapBlockOverhead);
+}
+
+static HeapBlock* heapBlockLinkNext(HeapBlock* block) {
+  HeapBlock* next = heapBlockNext(block);
+  next->prevPhys = block;
+  return next;
+}
+
+static void heapBlockMarkAsFree(HeapBlock* block) {
+  HeapBlock* next = heapBlockLinkNext(block);
+  heapBlockSetPrevFree(next);
+  heapBlockSetFree(block);
+}
+
+static void heapBlockMarkAsUsed(HeapBlock* block) {
+  HeapBlock* next = heapBlockNext(block);
+  heapBlockSetPrevUsed(next);
+  heapBlockSetUsed(block);
+}
+
+// Size class mapping
+static void heapMappingInsert(u64 size, u32* fl, u32* sl) {
+  if (size < HEAP_SMALL_BLOCK_SIZE) {
+    *fl = 0;
+    *sl = (u32)size / (HEAP_SMALL_BLOCK_SIZE / HEAP_SL_COUNT);
+  } else {
+    u32 f = heapFls(size);
+    *sl = (u32)(size >> (f - HEAP_SL_LOG2)) ^ (1 << HEAP_SL_LOG2);
+    *fl = f - (HEAP_FL_SHIFT - 1);
+  }
+}
+
+// Rounds size up to the next list so any block found there is big enough
+static void heapMappingSearch(u64 size, u32* fl, u32* sl) {
+  if (size >= HEAP_SMALL_BLOCK_SIZE) {
+    u64 round = ((u64)1 << (heapFls(size) - HEAP_SL_LOG2)) - 1;
+    size += round;
+  }
+  heapMappingInsert(size, fl, sl);
+}
+
+static HeapBlock* heapSearchSuitableBlock(Heap* heap, u32* fl, u32* sl) {
+  u32 slMap = heap->slBitmap[*fl] & (~0U << *sl);
+  if (slMap == 0) {
+    u32 flMap = (*fl + 1 < 32) ? (heap->flBitmap & (~0U << (*fl + 1))) : 0;
+    if (flMap == 0) {
+      return nullptr;
+    }
+    *fl = heapFfs(flMap);
+    slMap = heap->slBitmap[*fl];
+  }
+  *sl = heapFfs(slMap);
+  return heap->blocks[*fl][*sl];
+}
+
+// Free lists
+static void heapRemoveFreeBlock(Heap* heap, HeapBlock* block, u32 fl, u32 sl) {
+  HeapBlock* prev = block->prevFree;
+  HeapBlock* next = block->nextFree;
+  if (next != nullptr) {
+    next->prevFree = prev;
+  }
+  if (prev != nullptr) {
+    prev->nextFree = next;
+  }
+
+  if (heap->blocks[fl][sl] == block) {
+    heap->blocks[fl][sl] = next;
+    if (next == nullptr) {
+      heap->slBitmap[fl] &= ~(1U << sl);
+      if (heap->slBitmap[fl] == 0) {
+        heap->flBitmap &= ~(1U << fl);
+      }
+    }
+  }
+}
+
+static void heapInsertFreeBlock(Heap* heap, HeapBlock* block, u32 fl, u32 sl) {
+  HeapBlock* current = heap->blocks[fl][sl];
+  block->nextFree = current;
+  block->prevFree = nullptr;
+  if (current != nullptr) {
+    current->prevFree = block;
+  }
+  heap->blocks[fl][sl] = block;
+  heap->flBitmap |= (1U << fl);
+  heap->slBitmap[fl] |= (1U << sl);
+}
+
+static void heapBlockRemove(Heap* heap, HeapBlock* block) {
+  u32 fl, sl;
+  heapMappingInsert(heapBlockGetSize(block), &fl, &sl);
+  heapRemoveFreeBlock(heap, block, fl, sl);
+}
+
+static void heapBlockInsert(Heap* heap, HeapBlock* block) {
+  u32 fl, sl;
+  heapMappingInsert(heapBlockGetSize(block), &fl, &sl);
+  heapInsertFreeBlock(heap, block, fl, sl);
+}
+
+// Splitting / merging
+static b32 heapBlockCanSplit(HeapBlock* block, u64 size) {
+  return heapBlockGetSize(block) >= sizeof(HeapBlock) + size;
+}
+
+static HeapBlock* heapBlockSplit(HeapBlock* block, u64 size) {
+  auto* remaining = (HeapBlock*)((u8*)heapBlockToPtr(block) + size - heapBlockOverhead);
+  u64 remainingSize = heapBlockGetSize(block) - (size + heapBlockOverhead);
+  remaining->size = remainingSize;
+  heapBlockSetSize(block, size);
+  heapBlockMarkAsFree(remaining);
+  return remaining;
+}
+
+static HeapBlock* heapBlockAbsorb(HeapBlock* prev, HeapBlock* block) {
+  prev->size += heapBlockGetSize(block) + heapBlockOverhead;
+  heapBlockLinkNext(prev);
+  return prev;
+}
+
+static HeapBlock* heapBlockMergePrev(Heap* heap, HeapBlock* block) {
+  if (heapBlockIsPrevFree(block)) {
+    HeapBlock* prev = block->prevPhys;
+    heapBlockRemove(heap, prev);
+    block = heapBlockAbsorb(prev, block);
+  }
+  return block;
+}
+
+static HeapBlock* heapBlockMergeNext(Heap* heap, HeapBlock* block) {
+  HeapBlock* next = heapBlockNext(block);
+  if (heapBlockIsFree(next)) {
+    heapBlockRemove(heap, next);
+    block = heapBlockAbsorb(block, next);
+  }
+  return block;
+}
+
+static void heapBlockTrimFree(Heap* heap, HeapBlock* block, u64 size) {
+  if (heapBlockCanSplit(block, size)) {
+    HeapBlock* remaining = heapBlockSplit(block, size);
+    heapBlockLinkNext(block);
+    heapBlockSetPrevFree(remaining);
+    heapBlockInsert(heap, remaining);
+  }
+}
+
+static void heapBlockTrimUsed(Heap* heap, HeapBlock* block, u64 size) {
+  if (heapBlockCanSplit(block, size)) {
+    HeapBlock* remaining = heapBlockSplit(block, size);
+    heapBlockSetPrevUsed(remaining);
+    remaining = heapBlockMergeNext(heap, remaining);
+    heapBlockInsert(heap, remaining);
+  }
+}
+
+static HeapBlock* heapBlockTrimFreeLeading(Heap* heap, HeapBlock* block, u64 size) {
+  HeapBlock* remaining = block;
+  if (heapBlockCanSplit(block, size)) {
+    remaining = heapBlockSplit(block, size - heapBlockOverhead);
+    heapBlockSetPrevFree(remaining);
+    heapBlockLinkNext(block);
+    heapBlockInsert(heap, block);
+  }
+  return remaining;
+}
+
+static u64 heapAdjustRequestSize(u64 size, u64 align) {
+  u64 adjust = 0;
+  if (size != 0) {
+    u64 aligned = AlignPow2(size, align);
+    if (aligned < heapBlockSizeMax) {
+      adjust = Max(aligned, heapBlockSizeMin);
+    }
+  }
+  return adjust;
+}
+
+// Pools
+static void heapAddPool(Heap* heap, void* mem, u64 bytes) {
+  u64 poolBytes = AlignDownPow2(bytes - heapPoolOverhead, HEAP_ALIGN);
+
+  // NOTE(piero): The first block's prevPhys sits before the pool and is never touched, since its prev-free bit is never set
+  auto* block = (HeapBlock*)((u8*)mem - heapBlockOverhead);
+  block->size = poolBytes;
+  heapBlockSetFree(block);
+  heapBlockSetPrevUsed(block);
+  heapBlockInsert(heap, block);
+
+  // Zero-sized used sentinel so merges stop at the end of the pool
+  HeapBlock* next = heapBlockLinkNext(block);
+  next->size = 0;
+  heapBlockSetUsed(next);
+  heapBlockSetPrevFree(next);
+
+  HeapPool* pool = PushStruct(heap->arena, HeapPool);
+  pool->firstBlock = block;
+  StackPush(heap->firstPool, pool);
+
+  heap->poolBytes += poolBytes;
+  heap->poolCount += 1;
+}
+
+static HeapBlock* heapLocateFree(Heap* heap, u64 size) {
+  HeapBlock* block = nullptr;
+  if (size != 0) {
+    for (u32 attempt = 0; attempt < 2 && block == nullptr; ++attempt) {
+      u32 fl = 0, sl = 0;
+      heapMappingSearch(size, &fl, &sl);
+      if (fl < HEAP_FL_COUNT) {
+        block = heapSearchSuitableBlock(heap, &fl, &sl);
+      }
+
+      if (block != nullptr) {
+        heapRemoveFreeBlock(heap, block, fl, sl);
+      } else if (attempt == 0) {
+        // Grow: room for the request rounded up to its search class plus the pool sentinels
+        u64 needed = size + ((u64)1 << (heapFls(size | 1) - HEAP_SL_LOG2 + 1)) + heapPoolOverhead + sizeof(HeapBlock);
+        u64 bytes = Max(heap->poolSize, AlignPow2(needed, HEAP_ALIGN));
+        void* mem = arenaPush(heap->arena, bytes, 16);
+        heapAddPool(heap, mem, bytes);
+      }
+    }
+  }
+  return block;
+}
+
+static void* heapBlockPrepareUsed(Heap* heap, HeapBlock* block, u64 size) {
+  void* result = nullptr;
+  if (block != nullptr) {
+    heapBlockTrimFree(heap, block, size);
+    heapBlockMarkAsUsed(block);
+    heap->usedBytes += heapBlockGetSize(block);
+    result = heapBlockToPtr(block);
+  }
+  return result;
+}
+
+static void heapLock(Heap* heap) {
+  if (heap->flags & HeapFlag_ThreadSafe) {
+    while (AtomicCompareExchangeU32(&heap->lock, 1, 0) != 0) {
+      CpuPause();
+    }
+  }
+}
+
+static void heapUnlock(Heap* heap) {
+  if (heap->flags & HeapFlag_ThreadSafe) {
+    AtomicStoreU32(&heap->lock, 0);
+  }
+}
+
+Heap* heapCreate(Arena* arena, u64 poolSize, HeapFlags flags) {
+  Heap* heap = PushStruct(arena, Heap);
+  heap->arena = arena;
+  heap->flags = flags;
+  heap->poolSize = Max(poolSize, (u64)Kilobytes(4));
+  return heap;
+}
+
+static void* heapAllocAlignedLocked(Heap* heap, u64 size, u64 align) {
+  u64 adjust = heapAdjustRequestSize(size, HEAP_ALIGN);
+  if (align <= HEAP_ALIGN) {
+    HeapBlock* block = heapLocateFree(heap, adjust);
+    return heapBlockPrepareUsed(heap, block, adjust);
+  }
+
+  // NOTE(piero): Ask for enough extra space to carve off a leading free block that is at least a block
+  //              header in size, so the aligned pointer always leaves a valid free block in front of it.
+  u64 gapMinimum = sizeof(HeapBlock);
+  u64 sizeWithGap = heapAdjustRequestSize(adjust + align + gapMinimum, align);
+  HeapBlock* block = heapLocateFree(heap, adjust ? sizeWithGap : 0);
+
+  if (block != nullptr) {
+    u8* ptr = (u8*)heapBlockToPtr(block);
+    u8* aligned = (u8*)AlignPow2(IntFromPtr(ptr), align);
+    u64 gap = (u64)(aligned - ptr);
+
+    if (gap != 0 && gap < gapMinimum) {
+      u64 gapRemain = gapMinimum - gap;
+      u64 offset = Max(gapRemain, align);
+      aligned = (u8*)AlignPow2(IntFromPtr(aligned + offset), align);
+      gap = (u64)(aligned - ptr);
+    }
+
+    if (gap != 0) {
+      block = heapBlockTrimFreeLeading(heap, block, gap);
+    }
+  }
+
+  return heapBlockPrepareUsed(heap, block, adjust);
+}
+
+static void heapFreeLocked(Heap* heap, void* ptr) {
+  HeapBlock* block = heapBlockFromPtr(ptr);
+  Assert(!heapBlockIsFree(block));
+  heap->usedBytes -= heapBlockGetSize(block);
+  heapBlockMarkAsFree(block);
+  block = heapBlockMergePrev(heap, block);
+  block = heapBlockMergeNext(heap, block);
+  heapBlockInsert(heap, block);
+}
+
+void* heapAlloc(Heap* heap, u64 size) {
+  heapLock(heap);
+  void* result = heapAllocAlignedLocked(heap, size, HEAP_ALIGN);
+  heapUnlock(heap);
+  return result;
+}
+
+void* heapAllocAligned(Heap* heap, u64 size, u64 align) {
+  heapLock(heap);
+  void* result = heapAllocAlignedLocked(heap, size, align);
+  heapUnlock(heap);
+  return result;
+}
+
+void heapFree(Heap* heap, void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  heapLock(heap);
+  heapFreeLocked(heap, ptr);
+  heapUnlock(heap);
+}
+
+void* heapRealloc(Heap* heap, void* ptr, u64 size) {
+  if (ptr == nullptr) {
+    return heapAlloc(heap, size);
+  }
+  if (size == 0) {
+    heapFree(heap, ptr);
+    return nullptr;
+  }
+
+  heapLock(heap);
+
+  void* result = ptr;
+  HeapBlock* block = heapBlockFromPtr(ptr);
+  HeapBlock* next = heapBlockNext(block);
+
+  u64 currentSize = heapBlockGetSize(block);
+  u64 combinedSize = currentSize + heapBlockGetSize(next) + heapBlockOverhead;
+  u64 adjust = heapAdjustRequestSize(size, HEAP_ALIGN);
+
+  if (adjust > currentSize && (!heapBlockIsFree(next) || adjust > combinedSize)) {
+    // Can't grow in place, move it
+    result = heapAllocAlignedLocked(heap, size, HEAP_ALIGN);
+    if (result != nullptr) {
+      MemoryCopy(result, ptr, Min(currentSize, size));
+      heapFreeLocked(heap, ptr);
+    }
+  } else {
+    heap->usedBytes -= currentSize;
+    if (adjust > currentSize) {
+      heapBlockMergeNext(heap, block);
+      heapBlockMarkAsUsed(block);
+    }
+    heapBlockTrimUsed(heap, block, adjust);
+    heap->usedBytes += heapBlockGetSize(block);
+  }
+
+  heapUnlock(heap);
+  return result;
+}
+
+u64 heapBlockSize(void* ptr) {
+  return heapBlockGetSize(heapBlockFromPtr(ptr));
+}
+
+HeapStats heapStats(Heap* heap) {
+  HeapStats stats = {};
+  u64 poolLargestFreeBlocks = 0;
+
+  heapLock(heap);
+  stats.poolCount = heap->poolCount;
+  stats.poolBytes = heap->poolBytes;
+  stats.usedBytes = heap->usedBytes;
+  for (HeapPool* pool = heap->firstPool; pool != nullptr; pool = pool->next) {
+    u64 largest = 0;
+    for (HeapBlock* block = pool->firstBlock; !heapBlockIsLast(block); block = heapBlockNext(block)) {
+      if (heapBlockIsFree(block)) {
+        u64 size = heapBlockGetSize(block);
+        stats.freeBytes += size;
+        stats.freeBlockCount += 1;
+        largest = Max(largest, size);
+      }
+    }
+    stats.largestFreeBlock = Max(stats.largestFreeBlock, largest);
+    poolLargestFreeBlocks += largest;
+  }
+  heapUnlock(heap);
+
+  if (stats.freeBytes != 0) {
+    stats.fragmentation = 1.0f - (f32)((f64)poolLargestFreeBlocks / (f64)stats.freeBytes);
+  }
+  return stats;
+}
+
+// Thread cache
+void heapCacheInit(HeapCache* cache, Heap* heap) {
+  MemoryZeroStruct(cache);
+  cache->heap = heap;
+}
+
+void* heapCacheAlloc(HeapCache* cache, u64 size) {
+  u64 binSize = AlignPow2(Max(size, (u64)1), HEAP_CACHE_BIN_SIZE);
+  u64 bin = binSize / HEAP_CACHE_BIN_SIZE - 1;
+  if (bin < HEAP_CACHE_BIN_COUNT && cache->bins[bin] != nullptr) {
+    HeapCacheNode* node = cache->bins[bin];
+    StackPop(cache->bins[bin]);
+    cache->binCounts[bin] -= 1;
+    return node;
+  }
+
+  // NOTE(piero): Small allocations are rounded to their bin so they can be recycled by any request of that bin
+  return heapAlloc(cache->heap, bin < HEAP_CACHE_BIN_COUNT ? binSize : size);
+}
+
+void heapCacheFree(HeapCache* cache, void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  // A block can serve any request up to its size, so it goes in the largest bin it fully covers
+  u64 bin = heapBlockSize(ptr) / HEAP_CACHE_BIN_SIZE - 1;
+  if (bin < HEAP_CACHE_BIN_COUNT && cache->binCounts[bin] < HEAP_CACHE_MAX_PER_BIN) {
+    auto* node = (HeapCacheNode*)ptr;
+    StackPush(cache->bins[bin], node);
+    cache->binCounts[bin] += 1;
+  } else {
+    heapFree(cache->heap, ptr);
+  }
+}
+
+void heapCacheFlush(HeapCache* cache) {
+  heapLock(cache->heap);
+  for (u32 bin = 0; bin < HEAP_CACHE_BIN_COUNT; ++bin) {
+    for (HeapCacheNode *node = cache->bins[bin], *next = nullptr; node != nullptr; node = next) {
+      next = node->next;
+      heapFreeLocked(cache->heap, node);
+    }
+    cache->bins[bin] = nullptr;
+    cache->binCounts[bin] = 0;
+  }
+  heapUnlock(cache->heap);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/memory/arena.h"
+
+// NOTE(piero): Two-level segregated fit allocator (http://www.gii.upv.es/tlsf/), O(1) alloc and free.
+//              Memory comes from an Arena in pools; the heap grows by pushing a new pool when nothing fits
+//              and never gives pools back (they live as long as the arena).
+//              First level splits sizes by power of two, second level splits each power of two into
+//              HEAP_SL_COUNT linear ranges. A bitmap per level finds the first non-empty free list in O(1).
+
+#define HEAP_ALIGN_LOG2 3
+#define HEAP_ALIGN (1 << HEAP_ALIGN_LOG2)
+#define HEAP_SL_LOG2 5
+#define HEAP_SL_COUNT (1 << HEAP_SL_LOG2)
+#define HEAP_FL_MAX 32
+#define HEAP_FL_SHIFT (HEAP_SL_LOG2 + HEAP_ALIGN_LOG2)
+#define HEAP_FL_COUNT (HEAP_FL_MAX - HEAP_FL_SHIFT + 1)
+#define HEAP_SMALL_BLOCK_SIZE (1 << HEAP_FL_SHIFT)
+
+static constexpr u64 heapDefaultPoolSize = Megabytes(4);
+
+using HeapFlags = u32;
+enum {
+  // Guard every call with a spin lock so several threads can share the heap
+  HeapFlag_ThreadSafe = (1 << 0),
+};
+
+// NOTE(piero): prevPhys overlaps the last bytes of the previous block's payload and is only valid when
+//              that block is free. The low bits of size hold the free / prev-free flags.
+struct HeapBlock {
+  HeapBlock* prevPhys;
+  u64 size;
+  HeapBlock* nextFree;
+  HeapBlock* prevFree;
+};
+
+// Pools never merge, so fragmentation is measured within each of them
+struct HeapPool {
+  HeapPool* next;
+  HeapBlock* firstBlock;
+};
+
+struct Heap {
+  Arena* arena;
+  HeapFlags flags;
+  u32 lock;
+  u64 poolSize;
+
+  u32 flBitmap;
+  u32 slBitmap[HEAP_FL_COUNT];
+  HeapBlock* blocks[HEAP_FL_COUNT][HEAP_SL_COUNT];
+
+  u64 poolBytes;
+  u64 usedBytes;
+  u64 poolCount;
+  HeapPool* firstPool;
+};
+
+struct HeapStats {
+  u64 poolCount;
+  u64 poolBytes;
+  u64 usedBytes;
+  u64 freeBytes;
+  u64 freeBlockCount;
+  u64 largestFreeBlock;
+  // 1 - (sum of each pool's largest free block) / freeBytes. 0 means every pool has all its free memory in a
+  // single block, a heap whose pools are all empty reports 0.
+  f32 fragmentation;
+};
+
+// Optional per-thread cache of small freed blocks. Owned by a single thread, so hits never take the heap lock.
+#define HEAP_CACHE_BIN_SIZE 16
+#define HEAP_CACHE_BIN_COUNT 32
+#define HEAP_CACHE_MAX_PER_BIN 64
+
+struct HeapCacheNode {
+  HeapCacheNode* next;
+};
+
+struct HeapCache {
+  Heap* heap;
+  HeapCacheNode* bins[HEAP_CACHE_BIN_COUNT];
+  u32 binCounts[HEAP_CACHE_BIN_COUNT];
+};
+
+Heap* heapCreate(Arena* arena, u64 poolSize = heapDefaultPoolSize, HeapFlags flags = 0);
+
+void* heapAlloc(Heap* heap, u64 size);
+void* heapAllocAligned(Heap* heap, u64 size, u64 align);
+void* heapRealloc(Heap* heap, void* ptr, u64 size);
+void heapFree(Heap* heap, void* ptr);
+u64 heapBlockSize(void* ptr);
+
+HeapStats heapStats(Heap* heap);
+
+void heapCacheInit(HeapCache* cache, Heap* heap);
+void* heapCacheAlloc(HeapCache* cache, u64 size);
+void heapCacheFree(HeapCache* cache, void* ptr);
+void heapCacheFlush(HeapCache* cache);
+
+#define HeapPushArrayNoZero(h, T, c) (T*)heapAllocAligned((h), sizeof(T) * (c), Max(8, alignof(T)))
+#define HeapPushArray(h, T, c) (T*)MemoryZero(HeapPushArrayNoZero(h, T, c), sizeof(T) * (c))
+#define HeapPushStruct(h, T) HeapPushArray(h, T, 1)
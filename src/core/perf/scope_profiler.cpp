@@ -1,30 +1,56 @@
 #include "scope_profiler.h"
+#include "core/thread_context.h"
 #include "platform/os/core/os_core.h"
 #include <cstdio>
 
 static Profiler globalProfiler;
-static u32 globalProfilerParent;
 
+// Once per thread, the lock only guards the thread list
+static ProfileThread* profileThreadAlloc() {
+  while (AtomicCompareExchangeU32(&globalProfiler.lock, 1, 0) != 0) {
+    CpuPause();
+  }
+  if (globalProfiler.arena == nullptr) {
+    globalProfiler.arena = ArenaAllocDefault();
+  }
+  ProfileThread* thread = PushStruct(globalProfiler.arena, ProfileThread);
+  thread->next = globalProfiler.firstThread;
+  globalProfiler.firstThread = thread;
+  globalProfiler.threadCount += 1;
+  AtomicStoreU32(&globalProfiler.lock, 0);
+
+  thread->threadId = OS_threadId();
+  String8 name = ThreadCtx_getName();
+  thread->nameSize = Min(name.size, sizeof(thread->name));
+  MemoryCopy(thread->name, name.str, thread->nameSize);
+
+  ThreadCtx_get()->profiler = thread;
+  return thread;
+}
 
 ProfileBlock::ProfileBlock(char const* _label, u32 _index) {
-  parentIndex = globalProfilerParent;
+  thread = ThreadCtx_get()->profiler;
+  if (thread == nullptr) {
+    thread = profileThreadAlloc();
+  }
+  parentIndex = thread->parentIndex;
 
   anchorIndex = _index;
   label = _label;
 
-  ProfileAnchor* Anchor = globalProfiler.anchors + anchorIndex;
+  ProfileAnchor* Anchor = thread->anchors + anchorIndex;
   oldTSCElapsedInclusive = Anchor->tscElapsedInclusive;
 
-  globalProfilerParent = anchorIndex;
+  thread->parentIndex = anchorIndex;
   startTSC = OS_readCPUTimer();
 }
 
 ProfileBlock::~ProfileBlock() {
   u64 elapsed = OS_readCPUTimer() - startTSC;
-  globalProfilerParent = parentIndex;
+  thread->parentIndex = parentIndex;
 
-  ProfileAnchor* parent = globalProfiler.anchors + parentIndex;
-  ProfileAnchor* anchor = globalProfiler.anchors + anchorIndex;
+  ProfileAnchor* parent = thread->anchors + parentIndex;
+  ProfileAnchor* anchor = thread->anchors + anchorIndex;
 
   parent->tscElapsedExclusive -= elapsed;
   anchor->tscElapsedExclusive += elapsed;
@@ -48,6 +74,8 @@ static void BeginProfile() {
   globalProfiler.startTSC = OS_readCPUTimer();
 }
 
+// NOTE(piero): Percentages are of the wall time between BeginProfile and EndProfile. Merged anchors add up the
+//              time of every thread, so with several threads busy at once they can go past 100%.
 static void EndProfile() {
   globalProfiler.endTSC = OS_readCPUTimer();
   u64 cpuFreq = OS_estimateCPUTimerFreq();
@@ -58,10 +86,54 @@ static void EndProfile() {
     printf("\nTotal time: %0.4fms (CPU freq %.2f GHz)\n", 1000.0 * (f64)totalCPUElapsed / (f64)cpuFreq, (f32)cpuFreq / 1e9);
   }
 
-  for (u32 index = 0; index < ArrayCount(globalProfiler.anchors); ++index) {
-    ProfileAnchor* anchor = globalProfiler.anchors + index;
+  while (AtomicCompareExchangeU32(&globalProfiler.lock, 1, 0) != 0) {
+    CpuPause();
+  }
+  ProfileThread* firstThread = globalProfiler.firstThread;
+  u32 threadCount = globalProfiler.threadCount;
+  AtomicStoreU32(&globalProfiler.lock, 0);
+
+  Temp scratch = ScratchBegin();
+  ProfileAnchor* merged = PushArray(scratch.arena, ProfileAnchor, PROFILE_ANCHOR_COUNT);
+  for (ProfileThread* thread = firstThread; thread != nullptr; thread = thread->next) {
+    for (u32 index = 1; index < PROFILE_ANCHOR_COUNT; ++index) {
+      ProfileAnchor* anchor = thread->anchors + index;
+      if (anchor->hitCount) {
+        merged[index].tscElapsedExclusive += anchor->tscElapsedExclusive;
+        merged[index].tscElapsedInclusive += anchor->tscElapsedInclusive;
+        merged[index].hitCount += anchor->hitCount;
+        merged[index].label = anchor->label;
+      }
+    }
+  }
+
+  printf("All threads (%u):\n", threadCount);
+  for (u32 index = 1; index < PROFILE_ANCHOR_COUNT; ++index) {
+    ProfileAnchor* anchor = merged + index;
     if (anchor->tscElapsedInclusive) {
       PrintTimeElapsed(totalCPUElapsed, anchor, cpuFreq);
     }
   }
+
+  for (ProfileThread* thread = firstThread; thread != nullptr; thread = thread->next) {
+    // Anchor 0 lost the time of every top level block
+    u64 threadElapsed = 0 - thread->anchors[0].tscElapsedExclusive;
+    if (thread->nameSize) {
+      printf("\n%.*s", (int)thread->nameSize, thread->name);
+    } else {
+      printf("\nThread %u", thread->threadId);
+    }
+    if (cpuFreq) {
+      printf(": %.4fms in blocks (%.2f%%)", 1000.0 * (f64)threadElapsed / (f64)cpuFreq, 100.0 * (f64)threadElapsed / (f64)totalCPUElapsed);
+    }
+    printf("\n");
+
+    for (u32 index = 1; index < PROFILE_ANCHOR_COUNT; ++index) {
+      ProfileAnchor* anchor = thread->anchors + index;
+      if (anchor->tscElapsedInclusive) {
+        PrintTimeElapsed(totalCPUElapsed, anchor, cpuFreq);
+      }
+    }
+  }
+  ScratchEnd(scratch);
 }
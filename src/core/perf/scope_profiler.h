@@ -1,6 +1,15 @@
 #pragma once
 
 #include "core/core.h"
+#include "core/memory/arena.h"
+
+// NOTE(piero): Every thread times its blocks into an anchor table of its own, hanging off its ThreadCtx, so timing
+//              a block touches no shared state and takes no lock. A thread's table is made the first time it enters
+//              a block and is never freed, threads that ended before EndProfile still show up in the report.
+//              EndProfile adds up the tables of every thread and then prints each thread on its own.
+//              Fibers have their own ThreadCtx, so a fiber's blocks go to its table whichever worker runs it.
+
+#define PROFILE_ANCHOR_COUNT 4096
 
 struct ProfileAnchor {
   u64 tscElapsedExclusive;
@@ -9,8 +18,21 @@ struct ProfileAnchor {
   const char* label;
 };
 
+struct ProfileThread {
+  ProfileAnchor anchors[PROFILE_ANCHOR_COUNT];
+  // Innermost open block, 0 outside of every block. Anchor 0 collects top level blocks.
+  u32 parentIndex;
+  u32 threadId;
+  u8 name[64];
+  u64 nameSize;
+  ProfileThread* next;
+};
+
 struct Profiler {
-  ProfileAnchor anchors[4096];
+  u32 lock;
+  Arena* arena;
+  ProfileThread* firstThread;
+  u32 threadCount;
   u64 startTSC;
   u64 endTSC;
 };
@@ -19,6 +41,7 @@ struct ProfileBlock {
   ProfileBlock(const char* _label, u32 _index);
   ~ProfileBlock();
 
+  ProfileThread* thread;
   const char* label;
   u64 oldTSCElapsedInclusive;
   u64 startTSC;
@@ -43,4 +66,5 @@ struct ProfileBlock {
 static void PrintTimeElapsed(u64 TotalTSCElapsed, ProfileAnchor* Anchor, u64 cpuFreq);
 
 static void BeginProfile();
+// Threads still running keep timing into their tables while they're read, join them first for exact numbers
 static void EndProfile();
@@ -0,0 +1,156 @@
+#include "string_intern.h"
+#include "core/core_strings.h"
+#include "core/data_structures/hash_map.h"
+
+static StrInternState* strInternState = nullptr;
+
+static StrInternTable* strInternTableAlloc(Arena* arena, u32 capacity) {
+  StrInternTable* table = PushStruct(arena, StrInternTable);
+  table->capacity = capacity;
+  table->slots = PushArray(arena, StrId, capacity);
+  return table;
+}
+
+void StrIntern_init() {
+  Arena* arena = ArenaAllocDefault();
+  strInternState = PushStruct(arena, StrInternState);
+  // Id 0 is reserved for the empty string
+  strInternState->nextId = 1;
+
+  for (u32 i = 0; i < STR_INTERN_SHARD_COUNT; ++i) {
+    StrInternShard* shard = &strInternState->shards[i];
+    shard->arena = i == 0 ? arena : ArenaAllocDefault();
+    shard->table = strInternTableAlloc(shard->arena, 256);
+  }
+  strInternState->chunks[0] = PushArray(arena, StrInternEntry, STR_INTERN_CHUNK_SIZE);
+}
+
+static StrInternEntry* strInternEntry(StrId id) {
+  StrInternEntry* chunk = (StrInternEntry*)AtomicLoadPtr(&strInternState->chunks[id >> STR_INTERN_CHUNK_SIZE_LOG2]);
+  return &chunk[id & (STR_INTERN_CHUNK_SIZE - 1)];
+}
+
+static StrInternShard* strInternShard(u64 hash) {
+  return &strInternState->shards[hash >> (64 - STR_INTERN_SHARD_COUNT_LOG2)];
+}
+
+// Walks the probe sequence of `hash`, returns the id if found or 0 with `outSlot` set to the empty slot it stopped at
+static StrId strInternProbe(StrInternTable* table, String8 string, u64 hash, u32* outSlot) {
+  u32 mask = table->capacity - 1;
+  for (u32 slot = (u32)hash & mask;; slot = (slot + 1) & mask) {
+    StrId id = AtomicLoadU32(&table->slots[slot]);
+    if (id == 0) {
+      if (outSlot) {
+        *outSlot = slot;
+      }
+      return 0;
+    }
+
+    StrInternEntry* entry = strInternEntry(id);
+    if (entry->hash == hash && hashKeyEqual(entry->string, string)) {
+      return id;
+    }
+  }
+}
+
+static void strInternLock(StrInternShard* shard) {
+  while (AtomicCompareExchangeU32(&shard->lock, 1, 0) != 0) {
+    CpuPause();
+  }
+}
+
+static void strInternUnlock(StrInternShard* shard) {
+  AtomicStoreU32(&shard->lock, 0);
+}
+
+StrId Str8InternFind(String8 string) {
+  if (string.size == 0) {
+    return 0;
+  }
+
+  u64 hash = hashKey(string);
+  StrInternShard* shard = strInternShard(hash);
+  auto* table = (StrInternTable*)AtomicLoadPtr(&shard->table);
+  return strInternProbe(table, string, hash, nullptr);
+}
+
+// Replaces the shard's table with one twice as big. The old table stays in the arena for readers still on it.
+static void strInternGrow(StrInternShard* shard) {
+  StrInternTable* old = shard->table;
+  StrInternTable* table = strInternTableAlloc(shard->arena, old->capacity * 2);
+  u32 mask = table->capacity - 1;
+
+  for (u32 i = 0; i < old->capacity; ++i) {
+    StrId id = old->slots[i];
+    if (id == 0) {
+      continue;
+    }
+    u32 slot = (u32)strInternEntry(id)->hash & mask;
+    while (table->slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    table->slots[slot] = id;
+  }
+  table->count = old->count;
+
+  AtomicStorePtr(&shard->table, table);
+}
+
+StrId Str8Intern(String8 string) {
+  if (string.size == 0) {
+    return 0;
+  }
+
+  u64 hash = hashKey(string);
+  StrInternShard* shard = strInternShard(hash);
+
+  // Fast path, most strings are already interned
+  StrId id = strInternProbe((StrInternTable*)AtomicLoadPtr(&shard->table), string, hash, nullptr);
+  if (id != 0) {
+    return id;
+  }
+
+  strInternLock(shard);
+
+  // Another thread may have inserted it between our probe and taking the lock
+  u32 slot = 0;
+  id = strInternProbe(shard->table, string, hash, &slot);
+  if (id == 0) {
+    if ((shard->table->count + 1) * 2 > shard->table->capacity) {
+      strInternGrow(shard);
+      strInternProbe(shard->table, string, hash, &slot);
+    }
+
+    id = AtomicAddU32(&strInternState->nextId, 1);
+    u32 chunkIndex = id >> STR_INTERN_CHUNK_SIZE_LOG2;
+    Assert(chunkIndex < STR_INTERN_MAX_CHUNKS);
+
+    // First id of a chunk allocates it. Ids are handed out in order but shards race, so use a CAS.
+    if (AtomicLoadPtr(&strInternState->chunks[chunkIndex]) == nullptr) {
+      StrInternEntry* chunk = PushArray(shard->arena, StrInternEntry, STR_INTERN_CHUNK_SIZE);
+      AtomicCompareExchangePtr(&strInternState->chunks[chunkIndex], chunk, nullptr);
+    }
+
+    StrInternEntry* entry = strInternEntry(id);
+    entry->hash = hash;
+    entry->string = PushStr8Copy(shard->arena, string);
+
+    // Publishing the id is what makes the entry visible to lock-free readers, it has to come last
+    AtomicStoreU32(&shard->table->slots[slot], id);
+    shard->table->count += 1;
+  }
+
+  strInternUnlock(shard);
+  return id;
+}
+
+String8 Str8FromId(StrId id) {
+  if (id == 0) {
+    return {};
+  }
+  return strInternEntry(id)->string;
+}
+
+u32 StrIntern_count() {
+  return AtomicLoadU32(&strInternState->nextId) - 1;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/memory/arena.h"
+
+// NOTE(piero): Global string interner. Every distinct string is stored once and gets a 32-bit id, so equality
+//              is an integer compare. Ids are never freed and stay valid for the whole run, 0 is the empty string.
+//              The table is split in shards picked by hash, each with its own spin lock, arena and open addressing
+//              table of ids. Lookups never take a lock: tables are only ever replaced (never mutated in place
+//              apart from filling empty slots), so a reader holding an old table still sees every id it had.
+//              A miss on the lock-free path is rechecked under the shard lock before inserting.
+
+using StrId = u32;
+
+#define STR_INTERN_SHARD_COUNT_LOG2 6
+#define STR_INTERN_SHARD_COUNT (1 << STR_INTERN_SHARD_COUNT_LOG2)
+#define STR_INTERN_CHUNK_SIZE_LOG2 12
+#define STR_INTERN_CHUNK_SIZE (1 << STR_INTERN_CHUNK_SIZE_LOG2)
+#define STR_INTERN_MAX_CHUNKS (1 << 14)
+
+struct StrInternEntry {
+  u64 hash;
+  String8 string;
+};
+
+struct StrInternTable {
+  u32 capacity;
+  u32 count;
+  // Ids, 0 is empty
+  StrId* slots;
+};
+
+struct alignas(CACHE_LINE_SIZE) StrInternShard {
+  u32 lock;
+  Arena* arena;
+  StrInternTable* table;
+};
+
+struct StrInternState {
+  StrInternShard shards[STR_INTERN_SHARD_COUNT];
+
+  // Id -> entry, in fixed size chunks so growing never moves entries under readers
+  StrInternEntry* chunks[STR_INTERN_MAX_CHUNKS];
+  u32 nextId;
+};
+
+void StrIntern_init();
+
+// Returns the id of `string`, copying it into the interner on first sight
+StrId Str8Intern(String8 string);
+// Returns 0 if `string` was never interned
+StrId Str8InternFind(String8 string);
+String8 Str8FromId(StrId id);
+u32 StrIntern_count();
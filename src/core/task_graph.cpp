@@ -0,0 +1,239 @@
+#include "task_graph.h"
+#include "core/thread_context.h"
+
+TaskGraph* taskGraphAlloc(Arena* arena) {
+  TaskGraph* graph = PushStruct(arena, TaskGraph);
+  graph->arena = arena;
+  arrayInit(&graph->nodes, arena);
+  return graph;
+}
+
+u32 taskGraphAddNode(TaskGraph* graph, String8 name, TaskFunction* func, void* params, TaskFlags flags) {
+  Assert(!graph->built);
+  u32 index = (u32)graph->nodes.count;
+  TaskNode* node = arrayPush(&graph->nodes);
+  node->graph = graph;
+  node->name = name;
+  node->func = func;
+  node->params = params;
+  node->flags = flags;
+  arrayInit(&node->reads, graph->arena);
+  arrayInit(&node->writes, graph->arena);
+  arrayInit(&node->successors, graph->arena);
+  return index;
+}
+
+void taskGraphRead(TaskGraph* graph, u32 node, TaskResource resource) {
+  Assert(!graph->built);
+  arrayPush(&graph->nodes[node].reads, resource);
+}
+
+void taskGraphWrite(TaskGraph* graph, u32 node, TaskResource resource) {
+  Assert(!graph->built);
+  arrayPush(&graph->nodes[node].writes, resource);
+}
+
+// Build
+
+struct TaskResourceState {
+  u32 lastWriter;
+  b32 hasWriter;
+  // Nodes reading it since lastWriter
+  Array<u32> readers;
+};
+
+static void taskGraphAddEdge(TaskGraph* graph, u32 from, u32 to) {
+  if (from == to) {
+    return;
+  }
+
+  TaskNode* node = &graph->nodes[from];
+  for (u32 successor : node->successors) {
+    if (successor == to) {
+      return;
+    }
+  }
+  arrayPush(&node->successors, to);
+  graph->nodes[to].dependencyCount += 1;
+}
+
+void taskGraphBuild(TaskGraph* graph) {
+  if (graph->built) {
+    return;
+  }
+
+  Temp scratch = ScratchBegin();
+  HashMap<TaskResource, TaskResourceState> resources;
+  hashMapInit(&resources, scratch.arena);
+
+  for (u32 i = 0; i < graph->nodes.count; ++i) {
+    TaskNode* node = &graph->nodes[i];
+
+    for (TaskResource resource : node->reads) {
+      TaskResourceState* state = hashMapGetOrAdd(&resources, resource);
+      if (state->hasWriter) {
+        taskGraphAddEdge(graph, state->lastWriter, i);
+      }
+      if (state->readers.arena == nullptr) {
+        arrayInit(&state->readers, scratch.arena);
+      }
+      arrayPush(&state->readers, i);
+    }
+
+    for (TaskResource resource : node->writes) {
+      TaskResourceState* state = hashMapGetOrAdd(&resources, resource);
+      if (state->hasWriter) {
+        taskGraphAddEdge(graph, state->lastWriter, i);
+      }
+      for (u32 reader : state->readers) {
+        taskGraphAddEdge(graph, reader, i);
+      }
+      state->lastWriter = i;
+      state->hasWriter = true;
+      arrayClear(&state->readers);
+    }
+  }
+
+  graph->mainThreadQueue = mpmcQueueAlloc<u32>(graph->arena, graph->nodes.count);
+  graph->built = true;
+  ScratchEnd(scratch);
+}
+
+// Execute
+
+static void taskNodeJob(void* params);
+
+static void taskGraphSchedule(TaskGraph* graph, u32 index) {
+  TaskNode* node = &graph->nodes[index];
+  if (node->flags & TaskFlag_MainThread) {
+    // Sized for every node, never full
+    mpmcQueuePush(graph->mainThreadQueue, index);
+  } else {
+    jobSubmit(taskNodeJob, node, &graph->counter);
+  }
+}
+
+static void taskNodeRun(TaskNode* node) {
+  TaskGraph* graph = node->graph;
+  node->startTime = OS_readCPUTimer();
+  node->func(node->params);
+  node->endTime = OS_readCPUTimer();
+
+  for (u32 successor : node->successors) {
+    if (AtomicAddU32(&graph->nodes[successor].pending, (u32)-1) == 1) {
+      taskGraphSchedule(graph, successor);
+    }
+  }
+  AtomicAddU32(&graph->remaining, (u32)-1);
+}
+
+static void taskNodeJob(void* params) {
+  taskNodeRun((TaskNode*)params);
+}
+
+void taskGraphExecute(TaskGraph* graph) {
+  taskGraphBuild(graph);
+  u32 count = (u32)graph->nodes.count;
+  graph->startTime = OS_readCPUTimer();
+
+  for (TaskNode& node : graph->nodes) {
+    node.pending = node.dependencyCount;
+  }
+  AtomicStoreU32(&graph->remaining, count);
+  for (u32 i = 0; i < count; ++i) {
+    if (graph->nodes[i].dependencyCount == 0) {
+      taskGraphSchedule(graph, i);
+    }
+  }
+
+  u32 spins = 0;
+  while (AtomicLoadU32(&graph->remaining) != 0) {
+    u32 index;
+    if (mpmcQueuePop(graph->mainThreadQueue, &index)) {
+      taskNodeRun(&graph->nodes[index]);
+      spins = 0;
+    } else if (jobTryRunOne()) {
+      spins = 0;
+    } else if (++spins < JOB_SPIN_COUNT) {
+      CpuPause();
+    } else {
+      OS_threadYield();
+    }
+  }
+
+  // Every node is done, but the jobs that ran the last ones may not have returned yet
+  jobWait(&graph->counter);
+  graph->endTime = OS_readCPUTimer();
+}
+
+// Critical path
+
+// Nodes only have edges to nodes added after them, so a single pass in node order sees every predecessor first.
+// Between chains of equal duration the one with more nodes wins, a frame of nodes too short to measure still gets
+// its longest chain instead of a single node.
+TaskGraphCriticalPath taskGraphCriticalPath(Arena* arena, TaskGraph* graph) {
+  TaskGraphCriticalPath result = {};
+  u32 count = (u32)graph->nodes.count;
+  if (count == 0) {
+    return result;
+  }
+  result.frameDuration = graph->endTime - graph->startTime;
+
+  Temp scratch = ScratchBegin(&arena, 1);
+  // Longest chain ending right before each node, how many nodes it has and the node it came through
+  u64* chain = PushArray(scratch.arena, u64, count);
+  u32* chainCount = PushArray(scratch.arena, u32, count);
+  u32* previous = PushArrayNoZero(scratch.arena, u32, count);
+  MemorySet(previous, 0xFF, sizeof(u32) * count);
+
+  u32 last = 0;
+  u32 lastCount = 0;
+  for (u32 i = 0; i < count; ++i) {
+    TaskNode* node = &graph->nodes[i];
+    u64 duration = node->endTime - node->startTime;
+    u64 total = chain[i] + duration;
+    u32 totalCount = chainCount[i] + 1;
+    result.workDuration += duration;
+    if (total > result.duration || (total == result.duration && totalCount > lastCount)) {
+      result.duration = total;
+      last = i;
+      lastCount = totalCount;
+    }
+
+    for (u32 successor : node->successors) {
+      if (total > chain[successor] || (total == chain[successor] && totalCount > chainCount[successor])) {
+        chain[successor] = total;
+        chainCount[successor] = totalCount;
+        previous[successor] = i;
+      }
+    }
+  }
+
+  result.count = lastCount;
+  result.nodes = PushArrayNoZero(arena, u32, result.count);
+  u32 index = result.count;
+  for (u32 i = last; i != u32Max; i = previous[i]) {
+    result.nodes[--index] = i;
+  }
+
+  ScratchEnd(scratch);
+  return result;
+}
+
+void taskGraphPrintCriticalPath(TaskGraph* graph) {
+  Temp scratch = ScratchBegin();
+  TaskGraphCriticalPath path = taskGraphCriticalPath(scratch.arena, graph);
+  // Measuring the CPU timer takes a while, once is enough
+  static u64 cpuFreq = 0;
+  if (cpuFreq == 0) {
+    cpuFreq = OS_estimateCPUTimerFreq();
+  }
+  f64 toMs = 1000.0 / (f64)cpuFreq;
+
+  printf("[TaskGraph] Frame %.3fms, work %.3fms, critical path %.3fms:\n", path.frameDuration * toMs, path.workDuration * toMs, path.duration * toMs);
+  for (u32 i = 0; i < path.count; ++i) {
+    TaskNode* node = &graph->nodes[path.nodes[i]];
+    printf("  %.*s %.3fms\n", (int)node->name.size, node->name.str, (node->endTime - node->startTime) * toMs);
+  }
+  ScratchEnd(scratch);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/job_system.h"
+#include "core/data_structures/array.h"
+#include "core/data_structures/hash_map.h"
+#include "core/data_structures/queue.h"
+
+// NOTE(piero): Task graph for the frame loop. Nodes are added once together with the resources they read and
+//              write, taskGraphBuild turns those into edges and taskGraphExecute runs the whole graph every frame.
+//              Edges follow the order nodes were added in: a node depends on the last writer of everything it
+//              reads or writes, and a writer also depends on every reader since that writer (read after write,
+//              write after write, write after read). Nodes that share no resource have no edge and overlap.
+//              Ready nodes go to the job system. MainThread nodes (windowing, the renderer) are queued for the
+//              thread calling taskGraphExecute instead, which runs other jobs while none of them are ready.
+//              Every execution timestamps each node with the CPU timer, taskGraphCriticalPath finds the longest
+//              chain of the last one.
+
+// Anything that identifies the data, usually its address. taskResourceNamed is for state without one.
+using TaskResource = u64;
+inline TaskResource taskResource(const void* ptr) { return (TaskResource)ptr; }
+inline TaskResource taskResourceNamed(String8 name) { return hashBytes(name.str, name.size); }
+
+using TaskFunction = void(void* params);
+
+using TaskFlags = u32;
+enum {
+  TaskFlag_MainThread = (1 << 0),
+};
+
+struct TaskGraph;
+
+struct TaskNode {
+  TaskGraph* graph;
+  String8 name;
+  TaskFunction* func;
+  void* params;
+  TaskFlags flags;
+
+  Array<TaskResource> reads;
+  Array<TaskResource> writes;
+
+  // Built, always point to nodes added later so node order is a topological order
+  Array<u32> successors;
+  u32 dependencyCount;
+
+  // Per execution
+  u32 pending;
+  u64 startTime;
+  u64 endTime;
+};
+
+struct TaskGraph {
+  Arena* arena;
+  Array<TaskNode> nodes;
+  b32 built;
+
+  // Per execution
+  MpmcQueue<u32>* mainThreadQueue;
+  JobCounter counter;
+  u32 remaining;
+  u64 startTime;
+  u64 endTime;
+};
+
+struct TaskGraphCriticalPath {
+  // Node indices, first to last
+  u32* nodes;
+  u32 count;
+  // CPU timer ticks (OS_readCPUTimer)
+  u64 duration;
+  u64 frameDuration;
+  u64 workDuration;
+};
+
+TaskGraph* taskGraphAlloc(Arena* arena);
+// Nodes can't be added once the graph is built
+u32 taskGraphAddNode(TaskGraph* graph, String8 name, TaskFunction* func, void* params, TaskFlags flags = 0);
+void taskGraphRead(TaskGraph* graph, u32 node, TaskResource resource);
+void taskGraphWrite(TaskGraph* graph, u32 node, TaskResource resource);
+
+void taskGraphBuild(TaskGraph* graph);
+// Runs every node once and returns when all of them are done. Builds the graph first if needed.
+void taskGraphExecute(TaskGraph* graph);
+
+// From the timings of the last execution
+TaskGraphCriticalPath taskGraphCriticalPath(Arena* arena, TaskGraph* graph);
+void taskGraphPrintCriticalPath(TaskGraph* graph);
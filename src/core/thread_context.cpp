@@ -1,11 +1,43 @@
 #include "thread_context.h"
+#include "core/core_strings.h"
 
 per_thread ThreadCtx* threadCtx = 0;
 
-ThreadCtx ThreadCtx_alloc() {
+static void ThreadCtx_place(ThreadCtx* tctx, u64 affinityMask) {
+  const OS_CpuTopology* topology = OS_cpuTopology();
+  u64 mask = affinityMask ? affinityMask : topology->processorMask;
+  OS_setThreadAffinity(mask);
+
+  tctx->affinityMask = affinityMask;
+  tctx->core = u32Max;
+  tctx->coreKind = OS_CoreKind_Performance;
+  for (u32 i = 0; i < topology->coreCount; ++i) {
+    if ((mask & ~topology->cores[i].processorMask) == 0) {
+      tctx->core = i;
+      tctx->coreKind = topology->cores[i].kind;
+      break;
+    }
+  }
+}
+
+ThreadCtx ThreadCtx_alloc(u64 affinityMask) {
   ThreadCtx tctx = { .scratchArenas = { nullptr } };
+  tctx.core = u32Max;
+  if (affinityMask) {
+    ThreadCtx_place(&tctx, affinityMask);
+  }
+
+  // Only a thread pinned to one core knows whose L2 it works out of, per core share of a shared L2 (E-core
+  // clusters). Unpinned threads and fiber contexts, which run on whichever worker resumes them, keep the default.
+  u64 commitSize = arenaDefaultCommitSize;
+  const OS_CpuTopology* topology = OS_cpuTopology();
+  if (tctx.core < topology->coreCount && topology->cores[tctx.core].l2.size != 0) {
+    const OS_CpuCache* l2 = &topology->cores[tctx.core].l2;
+    commitSize = Max(AlignPow2(l2->size / Max(l2->coreCount, 1u), OS_pageSize()), arenaDefaultCommitSize);
+  }
+
   for (u64 arena_idx = 0; arena_idx < ArrayCount(tctx.scratchArenas); arena_idx += 1) {
-    tctx.scratchArenas[arena_idx] = ArenaAllocDefault();
+    tctx.scratchArenas[arena_idx] = arenaAlloc({ .flags = arenaDefaultFlags, .reserveSize = arenaDefaultReserveSize, .commitSize = commitSize, .decommitFrames = scratchDecommitFrames });
   }
   return tctx;
 }
@@ -24,13 +56,31 @@ ThreadCtx* ThreadCtx_get() {
 }
 
 void ThreadCtx_setName(String8 string) {
+  threadCtx->threadNameSize = Min(string.size, sizeof(threadCtx->threadName));
+  MemoryCopy(threadCtx->threadName, string.str, threadCtx->threadNameSize);
+  OS_setThreadName(Str8(threadCtx->threadName, threadCtx->threadNameSize));
 }
-void ThreadCtx_getName() {
+String8 ThreadCtx_getName() {
+  return Str8(threadCtx->threadName, threadCtx->threadNameSize);
 }
 b32 ThreadCtx_isMainThread() {
   return threadCtx->isMainThread;
 }
 
+void ThreadCtx_setAffinity(u64 affinityMask) {
+  ThreadCtx_place(threadCtx, affinityMask);
+}
+
+u32 ThreadCtx_getCore() {
+  return threadCtx->core;
+}
+
+void ThreadCtx_endFrame() {
+  for (u64 arena_idx = 0; arena_idx < ArrayCount(threadCtx->scratchArenas); arena_idx += 1) {
+    arenaEndFrame(threadCtx->scratchArenas[arena_idx]);
+  }
+}
+
 Temp ScratchBegin(Arena** conflicts, u64 conflictsCount) {
   Temp scratch = { .arena = nullptr };
   auto* tctx = ThreadCtx_get();
@@ -44,7 +94,7 @@ Temp ScratchBegin(Arena** conflicts, u64 conflictsCount) {
     }
     if (is_conflicting == 0) {
       scratch.arena = tctx->scratchArenas[tctx_idx];
-      scratch.pos = scratch.arena->pos;
+      scratch.pos = arenaPos(scratch.arena);
       break;
     }
   }
@@ -4,23 +4,46 @@
 
 struct Arena;
 struct Temp;
+struct ProfileThread;
+
+// NOTE(piero): Scratch arenas hand back whatever was committed above their peak usage over this many frames
+static constexpr u32 scratchDecommitFrames = 120;
 
 struct ThreadCtx {
   Arena* scratchArenas[2];
   u8 threadName[64];
   u64 threadNameSize;
   bool isMainThread;
+
+  // 0 while the thread may run anywhere
+  u64 affinityMask;
+  // Physical core in OS_cpuTopology the thread is pinned to, u32Max when the mask spans several
+  u32 core;
+  OS_CoreKind coreKind;
+
+  // Anchor table of the scope profiler, made by the first profiled block
+  ProfileThread* profiler;
 };
 
-ThreadCtx ThreadCtx_alloc();
+// Pins the calling thread to affinityMask first when it isn't 0. When that pins it to a single core, scratch arenas
+// commit in steps of the core's L2 share, so a scratch working set that fits one step stays in its L2.
+ThreadCtx ThreadCtx_alloc(u64 affinityMask = 0);
 void ThreadCtx_release();
 
 void ThreadCtx_set(ThreadCtx* ctx);
 ThreadCtx* ThreadCtx_get();
 
+// Also names the OS thread. Names longer than threadName are cut.
 void ThreadCtx_setName(String8 string);
-void ThreadCtx_getName();
+String8 ThreadCtx_getName();
 b32 ThreadCtx_isMainThread();
 
+// Also pins the OS thread, 0 lets it run anywhere again
+void ThreadCtx_setAffinity(u64 affinityMask);
+u32 ThreadCtx_getCore();
+
+// Runs the per-frame decommit policy on this thread's scratch arenas
+void ThreadCtx_endFrame();
+
 Temp ScratchBegin(Arena** conflicts = nullptr, u64 conflictsCount = 0);
 #define ScratchEnd(temp) tempEnd(temp);
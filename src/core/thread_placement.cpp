@@ -0,0 +1,54 @@
+#include "thread_placement.h"
+
+static ThreadPlacement threadPlacementState;
+// 0 not computed yet, 1 being computed, 2 done
+static u32 threadPlacementReady;
+
+static void threadPlacementCompute(ThreadPlacement* placement) {
+  const OS_CpuTopology* topology = OS_cpuTopology();
+  if (topology->coreCount < 4) {
+    placement->workerCount = topology->processorCount;
+    return;
+  }
+
+  // Performance cores first, both kinds in core order
+  u32 order[OS_CPU_MAX_PROCESSORS];
+  u32 count = 0;
+  OS_CoreKind kinds[] = { OS_CoreKind_Performance, OS_CoreKind_Efficiency };
+  for (OS_CoreKind kind : kinds) {
+    for (u32 i = 0; i < topology->coreCount; ++i) {
+      if (topology->cores[i].kind == kind) {
+        order[count++] = i;
+      }
+    }
+  }
+
+  placement->reservedMask = topology->cores[order[count - 1]].processorMask;
+  placement->mainMask = topology->cores[order[0]].processorMask;
+  placement->renderMask = topology->cores[order[1]].processorMask;
+
+  placement->workerMasks[0] = placement->mainMask;
+  placement->workerCount = 1;
+  for (u32 i = 2; i + 1 < count; ++i) {
+    placement->workerMasks[placement->workerCount++] = topology->cores[order[i]].processorMask;
+  }
+}
+
+const ThreadPlacement* threadPlacement() {
+  if (AtomicLoadU32(&threadPlacementReady) != 2) {
+    if (AtomicCompareExchangeU32(&threadPlacementReady, 1, 0) == 0) {
+      threadPlacementCompute(&threadPlacementState);
+      AtomicStoreU32(&threadPlacementReady, 2);
+    } else {
+      while (AtomicLoadU32(&threadPlacementReady) != 2) {
+        OS_threadYield();
+      }
+    }
+  }
+  return &threadPlacementState;
+}
+
+u64 threadPlacementWorkerMask(u32 worker) {
+  const ThreadPlacement* placement = threadPlacement();
+  return worker < placement->workerCount ? placement->workerMasks[worker] : 0;
+}
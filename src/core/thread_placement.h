@@ -0,0 +1,27 @@
+#pragma once
+
+#include "core/core.h"
+#include "platform/os/core/os_core.h"
+
+// NOTE(piero): Which logical processors the engine's long lived threads run on, from OS_cpuTopology. Each thread
+//              gets a physical core of its own (all its SMT siblings) so two of them never share a core's caches
+//              and execution units, and the OS can't move them around between frames. Performance cores are
+//              handed out first: the main thread takes the first one, the render thread the next and job workers
+//              the rest. The last core, an efficiency core on hybrid parts, is left to the OS and other processes.
+//              Below 4 cores there isn't enough to go around and every thread stays unpinned.
+
+struct ThreadPlacement {
+  // 0 for threads left unpinned
+  u64 mainMask;
+  u64 renderMask;
+  // Counts the main thread, which is job worker 0
+  u32 workerCount;
+  u64 workerMasks[OS_CPU_MAX_PROCESSORS];
+  // Left to the OS
+  u64 reservedMask;
+};
+
+// Computed on first use
+const ThreadPlacement* threadPlacement();
+// 0 for workers past the placement's workerCount
+u64 threadPlacementWorkerMask(u32 worker);
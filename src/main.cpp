@@ -17,26 +17,44 @@ struct Camera {
 };
 
 struct Window {
-  Window* next;
-  Window* prev;
   OSWindowHandle handle;
 
   Camera* camera;
+
+  // Filled in by the window's input task for the rest of the frame
+  vec2 size;
+  b32 minimized;
 };
 
 struct State {
   Arena* arena;
-  Window* firstWindow;
-  Window* lastWindow;
+  SlotMap<Window> windows;
+  RenderMeshHandle scene;
+
+  // Built for the current window count, rebuilt when it changes
+  Arena* frameGraphArena;
+  TaskGraph* frameGraph;
+  u32 frameGraphWindowCount;
+
+  // Per frame, read by the frame graph tasks
+  OS_EventList* events;
+  f32 deltaTime;
 
   u64 t0;
   f32 osTimerFreq;
 
+  b32 printCriticalPath;
   b32 quit;
 };
 
 per_thread State* state;
 
+// Frame graph task params, tasks may run on workers where `state` isn't set
+struct WindowTask {
+  State* state;
+  Window* window;
+};
+
 void processEvents(Window* window, OS_EventList* events) {
   for (OS_Event* event = events->first, *next = nullptr; event != nullptr; event = next) {
     next = event->next;
@@ -60,6 +78,10 @@ void processEvents(Window* window, OS_EventList* events) {
         OS_setRelativeMouseMode(window->handle, !OS_getRelativeMouseMode(window->handle));
         OS_consumeEvent(events, event);
       }
+      if (event->key == OS_Key_F1) {
+        state->printCriticalPath = true;
+        OS_consumeEvent(events, event);
+      }
     }
 
     if (event->kind == OS_EventKind_Release) {
@@ -86,43 +108,128 @@ void processEvents(Window* window, OS_EventList* events) {
   }
 }
 
-void update() {
-  // convert ticks to microseconds
-  f32 deltaTime = (f32)((OS_readOSTimer() - state->t0) * 1000) / state->osTimerFreq;
-  state->t0 = OS_readOSTimer();
+// Frame graph tasks
 
-  Temp scratch = ScratchBegin();
-  OS_EventList events = OS_getEvents(scratch.arena);
+void windowInputTask(void* params) {
+  auto* task = (WindowTask*)params;
+  Window* window = task->window;
 
-  for (Window* window = state->firstWindow; window != nullptr; window = window->next) {
-    Region2D rect = OS_clientRectFromWindow(window->handle);
-    vec2 size = region2DSize(rect);
-    Render_startWindow(window->handle, size);
+  Region2D rect = OS_clientRectFromWindow(window->handle);
+  window->size = region2DSize(rect);
 
-    if (OS_windowIsMinimized(window->handle)) {
-      continue;
-    }
+  window->minimized = OS_windowIsMinimized(window->handle);
+  if (window->minimized) {
+    return;
+  }
+
+  processEvents(window, task->state->events);
+}
+
+void windowRenderTask(void* params) {
+  auto* task = (WindowTask*)params;
+  Window* window = task->window;
+  if (window->minimized) {
+    return;
+  }
+
+  // Only builds the frame packet, the render thread records it while the next frame runs
+  Render_startWindow(window->handle, window->size);
+  Render_setViewMatrix(window->camera->position, window->camera->pitch, window->camera->yaw);
+  Render_setProjectionMatrix(window->camera->fov, window->size.x / window->size.y, 10000.0f, 0.1f);
 
-    processEvents(window, &events);
+  f32 scale = 1.0f;
+  Render_drawMesh(task->state->scene, matrixMakeScale({ scale, scale, scale }));
 
-    Render_setViewMatrix(window->camera->position, window->camera->pitch, window->camera->yaw);
-    Render_setProjectionMatrix(window->camera->fov, size.x / size.y, 10000.0f, 0.1f);
+  Render_endWindow(window->handle);
+}
 
-    // Camera movement
-    mat4 cameraRotation = matrixMakeRotation(window->camera->pitch, window->camera->yaw);
-    vec3 movement = window->camera->velocity * 0.01f * deltaTime;
-    window->camera->position = window->camera->position + vecTransform(vec4{ movement.x, movement.y, movement.z, 0.f }, cameraRotation).xyz;
+void cameraMovementTask(void* params) {
+  auto* task = (WindowTask*)params;
+  Window* window = task->window;
+  if (window->minimized) {
+    return;
+  }
 
-    Render_update();
+  mat4 cameraRotation = matrixMakeRotation(window->camera->pitch, window->camera->yaw);
+  vec3 movement = window->camera->velocity * 0.01f * task->state->deltaTime;
+  window->camera->position = window->camera->position + vecTransform(vec4{ movement.x, movement.y, movement.z, 0.f }, cameraRotation).xyz;
+}
 
-    Render_endWindow(window->handle);
+// NOTE(piero): Windowing and the renderer only run on the main thread, so input and render are MainThread tasks
+//              and chain through the events and renderer resources. Camera movement is plain math and runs on a
+//              worker, overlapping the next window's input and render. It's added after the render task so it
+//              waits for the view matrix to be taken from the camera, same as before the graph.
+void buildFrameGraph() {
+  arenaClear(state->frameGraphArena);
+  TaskGraph* graph = taskGraphAlloc(state->frameGraphArena);
+  TaskResource renderer = taskResourceNamed(Str8L("Renderer"));
+  TaskResource events = taskResource(&state->events);
+
+  for (u32 windowIndex = 0; windowIndex < state->windows.count; ++windowIndex) {
+    Window* window = &state->windows.dense[windowIndex];
+    WindowTask* task = PushStruct(state->frameGraphArena, WindowTask);
+    task->state = state;
+    task->window = window;
+
+    u32 input = taskGraphAddNode(graph, PushStr8F(state->frameGraphArena, "Window %u Input", windowIndex), windowInputTask, task, TaskFlag_MainThread);
+    taskGraphWrite(graph, input, events);
+    taskGraphWrite(graph, input, renderer);
+    taskGraphWrite(graph, input, taskResource(window));
+    taskGraphWrite(graph, input, taskResource(window->camera));
+
+    u32 render = taskGraphAddNode(graph, PushStr8F(state->frameGraphArena, "Window %u Render", windowIndex), windowRenderTask, task, TaskFlag_MainThread);
+    taskGraphRead(graph, render, taskResource(window));
+    taskGraphRead(graph, render, taskResource(window->camera));
+    taskGraphWrite(graph, render, renderer);
+
+    u32 movement = taskGraphAddNode(graph, PushStr8F(state->frameGraphArena, "Window %u Camera Movement", windowIndex), cameraMovementTask, task);
+    taskGraphRead(graph, movement, taskResource(window));
+    taskGraphWrite(graph, movement, taskResource(window->camera));
+  }
+
+  taskGraphBuild(graph);
+  state->frameGraph = graph;
+  state->frameGraphWindowCount = state->windows.count;
+}
+
+void update() {
+  // convert ticks to microseconds
+  state->deltaTime = (f32)((OS_readOSTimer() - state->t0) * 1000) / state->osTimerFreq;
+  state->t0 = OS_readOSTimer();
+
+  // Coroutines waiting on file reads, jobs or fences
+  taskPoll();
+
+  Temp scratch = ScratchBegin();
+  OS_EventList events = OS_getEvents(scratch.arena);
+  state->events = &events;
+
+  if (state->frameGraph == nullptr || state->frameGraphWindowCount != state->windows.count) {
+    buildFrameGraph();
+  }
+  taskGraphExecute(state->frameGraph);
+
+  if (state->printCriticalPath) {
+    taskGraphPrintCriticalPath(state->frameGraph);
+    RenderFrameStats renderStats = Render_frameStats();
+    printf("[Render] Queue depth %u, latency %.3fms (avg %.3fms, max %.3fms), game wait %.3fms, queue wait %.3fms, record %.3fms\n",
+      renderStats.queueDepth,
+      renderStats.lastLatency,
+      renderStats.averageLatency,
+      renderStats.maxLatency,
+      renderStats.averageGameWait,
+      renderStats.averageQueueWait,
+      renderStats.averageRecord);
+    state->printCriticalPath = false;
   }
 
   for (OS_Event* event = events.first, *next = nullptr; event != nullptr; event = next) {
     next = event->next;
     if (event->kind == OS_EventKind_WindowClose) {
       OSWindowHandle window = event->window;
-  
+
+      // The render thread may still be presenting to it
+      Render_stopThread();
       OS_destroyWindow(window);
 
       OS_consumeEvent(&events, event);
@@ -131,13 +238,19 @@ void update() {
     }
   }
 
+  state->events = nullptr;
+  OS_releaseEvents(&events);
   ScratchEnd(scratch);
+
+  ThreadCtx_endFrame();
 }
 
 void entryPoint() {
   auto arena = ArenaAllocDefault();
   state = PushStruct(arena, State);
   state->arena = arena;
+  state->frameGraphArena = arenaAlloc({ .name = Str8L("Frame Graph") });
+  slotMapInit(&state->windows, arena, 4);
 
   OSWindowHandle osWindow = OS_createWindow(0, vec2{ 1920, 1080 }, Str8L("Engine"));
 
@@ -146,7 +259,8 @@ void entryPoint() {
   OS_windowFirstPaint(osWindow);
   OS_windowSetRepaint(osWindow, update);
 
-  Window* window = PushStruct(arena, Window);
+  Window* window = nullptr;
+  slotMapAdd(&state->windows, &window);
   window->handle = osWindow;
   window->camera = PushStruct(arena, Camera);
   window->camera->fov = 70.0f;
@@ -154,14 +268,17 @@ void entryPoint() {
 
   state->osTimerFreq = (f32)OS_getOSTimerFreq();
 
-  DLLPushBack(state->firstWindow, state->lastWindow, window);
+  state->scene = Render_loadScene(Str8L("../res/models/bistro/bistro.glb"));
+  // state->scene = Render_loadScene(Str8L("../res/models/sponza-optimized/Sponza.gltf"));
 
-  Render_loadScene(Str8L("../res/models/bistro/bistro.glb"));
-  // Render_loadScene(Str8L("../res/models/sponza-optimized/Sponza.gltf"));
+  Render_startThread();
 
   while(!state->quit) {
     update();
   }
 
+  Render_stopThread();
+
+  arenaRelease(state->frameGraphArena);
   arenaRelease(arena);
 }
@@ -4,16 +4,60 @@
 #include "core/core_strings.h"
 #include "core/math/core_math.h"
 #include "core/memory/arena.h"
+#include "core/memory/tlsf.h"
+#include "core/data_structures/hash_map.h"
+#include "core/string_intern.h"
+#include "core/algorithms/scan.h"
+#include "core/job_system.h"
 #include "core/perf/scope_profiler.h"
 #include "core/thread_context.h"
 
+// NOTE(piero): stb_image and cgltf do lots of short lived mallocs while parsing, route them through a TLSF
+//              heap so freed decode buffers get recycled between textures and scene loads.
+static Heap* gltfHeap = nullptr;
 
+static Heap* gltfGetHeap() {
+  if (gltfHeap == nullptr) {
+    Arena* heapArena = arenaAlloc({ .flags = arenaDefaultFlags, .reserveSize = arenaDefaultReserveSize, .commitSize = arenaDefaultCommitSize, .name = Str8L("GLTF Heap") });
+    gltfHeap = heapCreate(heapArena, Megabytes(32), HeapFlag_ThreadSafe);
+  }
+  return gltfHeap;
+}
+
+#define STBI_MALLOC(size) heapAlloc(gltfGetHeap(), (size))
+#define STBI_REALLOC(ptr, size) heapRealloc(gltfGetHeap(), (ptr), (size))
+#define STBI_FREE(ptr) heapFree(gltfGetHeap(), (ptr))
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
 #define CGLTF_IMPLEMENTATION
 #include <cgltf.h>
 
+static void* gltfAlloc(void* user, cgltf_size size) { return heapAlloc(gltfGetHeap(), size); }
+static void gltfFree(void* user, void* ptr) { heapFree(gltfGetHeap(), ptr); }
+
+// NOTE(piero): The .gltf/.glb and its .bin buffers are mapped instead of read into heap copies. GLB buffers point
+//              straight into the mapping and accessors are unpacked from it, so the file bytes are never copied.
+//              For .bin files cgltf asks for the buffer's byteLength and hands that size back on release, so only
+//              that much is mapped.
+static cgltf_result gltfFileRead(const cgltf_memory_options* memoryOptions, const cgltf_file_options* fileOptions, const char* path, cgltf_size* size, void** data) {
+  String8 mapped = OS_fileMap(Str8C((char*)path), OS_FileMapMode_ReadOnly, OS_FileMapHint_WillNeed, *size);
+  if (mapped.size == 0) {
+    return cgltf_result_file_not_found;
+  }
+  if (mapped.size < *size) {
+    OS_fileUnmap(mapped);
+    return cgltf_result_data_too_short;
+  }
+  *size = mapped.size;
+  *data = mapped.str;
+  return cgltf_result_success;
+}
+
+static void gltfFileRelease(const cgltf_memory_options* memoryOptions, const cgltf_file_options* fileOptions, void* data, cgltf_size size) {
+  OS_fileUnmap(Str8((u8*)data, size));
+}
+
 struct Vertex {
   vec3 position;
   f32 tu;
@@ -38,6 +82,11 @@ struct Texture {
   i32 width;
   i32 height;
   i32 dataSize;
+
+  // Set when another texture already decoded the same image, data is then null and the pixels live in
+  // textures[duplicateOf]
+  b32 isDuplicate;
+  u32 duplicateOf;
 };
 
 struct Geometry {
@@ -86,12 +135,70 @@ struct Model {
   b32 valid;
 };
 
+struct GltfImageDecode {
+  cgltf_data* data;
+  String8 basePath;
+  Texture* textures;
+  // Textures that own their image, the rest are duplicates
+  u32* textureIndices;
+  u32 textureCount;
+};
+
+static void gltfDecodeImages(void* params, u64 begin, u64 end) {
+  auto* decode = (GltfImageDecode*)params;
+  for (u64 i = begin; i < end; ++i) {
+    u32 textureIndex = decode->textureIndices[i];
+    cgltf_image* image = decode->data->textures[textureIndex].image;
+
+    i32 width = 0, height = 0, nChannels = 0;
+    u8* pixels = nullptr;
+    if (image->buffer_view) {
+      cgltf_buffer_view* view = image->buffer_view;
+      cgltf_buffer* buffer = view->buffer;
+      u8* bytes = (u8*)buffer->data + view->offset;
+      i32 encodedSize = (i32)view->size;
+
+      pixels = stbi_load_from_memory(bytes, encodedSize, &width, &height, &nChannels, 4);
+      if (!pixels) {
+        printf("Failed to load image from buffer_view for texture %u\n", textureIndex);
+      }
+    } else if (image->uri) {
+      Temp scratch = ScratchBegin();
+      String8 imagePath = PushStr8F(scratch.arena, "%S/%S", decode->basePath, Str8C(image->uri));
+      String8 encoded = OS_fileMap(imagePath, OS_FileMapMode_ReadOnly, OS_FileMapHint_Sequential | OS_FileMapHint_WillNeed);
+      if (encoded.size != 0) {
+        pixels = stbi_load_from_memory(encoded.str, (i32)encoded.size, &width, &height, &nChannels, 4);
+        OS_fileUnmap(encoded);
+      }
+      if (!pixels) {
+        printf("Failed to load image from uri for texture %u -> %s\n", textureIndex, imagePath.str);
+      }
+      ScratchEnd(scratch);
+    }
+
+    if (!pixels) {
+      continue;
+    }
+
+    decode->textures[textureIndex] = {
+      .data = pixels,
+      .width = width,
+      .height = height,
+      .dataSize = width * height * 4
+    };
+  }
+}
+
 inline Model* parseGLTF(Arena* arena, String8 path) {
   PerfScope;
 
   Model* result = PushStruct(arena, Model);
 
   cgltf_options options = {};
+  options.memory.alloc_func = gltfAlloc;
+  options.memory.free_func = gltfFree;
+  options.file.read = gltfFileRead;
+  options.file.release = gltfFileRelease;
   cgltf_data* data = nullptr;
   cgltf_result parsedResult = cgltf_parse_file(&options, (char*)path.str, &data);
 
@@ -121,6 +228,20 @@ inline Model* parseGLTF(Arena* arena, String8 path) {
   result->textures = PushArray(arena, Texture, data->textures_count);
   result->textureCount = data->textures_count;
 
+  // NOTE(piero): Several textures often point at the same image (one per sampler), decode each source once
+  Temp imageScratch = ScratchBegin(&arena, 1);
+  HashMap<StrId, u32> textureByUri;
+  HashMap<const void*, u32> textureByView;
+  hashMapInit(&textureByUri, imageScratch.arena, data->images_count);
+  hashMapInit(&textureByView, imageScratch.arena, data->images_count);
+
+  GltfImageDecode decode = {
+    .data = data,
+    .basePath = Substr8(path, 0, FindSubstr8(path, Str8L("/"), 0, MatchFlag_FindLast)),
+    .textures = result->textures,
+    .textureIndices = PushArrayNoZero(imageScratch.arena, u32, data->textures_count),
+  };
+
   for (u32 i = 0; i < data->textures_count; ++i) {
     cgltf_texture* texture = &data->textures[i];
     Assert(texture->image);
@@ -128,48 +249,38 @@ inline Model* parseGLTF(Arena* arena, String8 path) {
     u32 textureIndex = cgltf_texture_index(data, texture);
 
     cgltf_image* image = texture->image;
-    if (image->buffer_view) {
-      cgltf_buffer_view* view = image->buffer_view;
-      cgltf_buffer* buffer = view->buffer;
-      u8* bytes = (u8*)buffer->data + view->offset;
-      i32 encodedSize = (i32)view->size;
-
-      i32 width = 0, height = 0, nChannels = 0;
-      u8* pixels = stbi_load_from_memory(bytes, encodedSize, &width, &height, &nChannels, 4);
-
-      if (!pixels) {
-        printf("Failed to load image from buffer_view for texture %u\n", textureIndex);
-        continue;
-      }
-
+    b32 added = false;
+    u32* firstTexture = image->buffer_view ? hashMapGetOrAdd(&textureByView, (const void*)image->buffer_view, &added)
+                      : image->uri         ? hashMapGetOrAdd(&textureByUri, Str8Intern(Str8C(image->uri)), &added)
+                                           : nullptr;
+    if (firstTexture && !added) {
       result->textures[textureIndex] = {
-        .data = pixels,
-        .width = width,
-        .height = height,
-        .dataSize = width * height * 4
+        .isDuplicate = true,
+        .duplicateOf = *firstTexture
       };
-    } else if (image->uri) {
-      u64 beforeFilenameIdx = FindSubstr8(path, Str8L("/"), 0, MatchFlag_FindLast);
-      String8 basePath = Substr8(path, 0, beforeFilenameIdx);
-      String8 imagePath = PushStr8F(arena, "%S/%S", basePath, Str8C(image->uri));
-
-      i32 width = 0, height = 0, nChannels = 0;
-      u8* pixels = stbi_load((char*)imagePath.str, &width, &height, &nChannels, 4);
+      continue;
+    }
+    if (firstTexture) {
+      *firstTexture = textureIndex;
+    }
+    decode.textureIndices[decode.textureCount++] = textureIndex;
+  }
 
-      if (!pixels) {
-        printf("Failed to load image from uri for texture %u -> %s\n", textureIndex, imagePath.str);
-        continue;
-      }
+  // Decoding is independent per image and dominates import time
+  parallelFor(decode.textureCount, 1, gltfDecodeImages, &decode);
 
-      result->textures[textureIndex] = {
-        .data = pixels,
-        .width = width,
-        .height = height,
-        .dataSize = width * height * 4
-      };
+  for (u32 i = 0; i < data->textures_count; ++i) {
+    Texture* texture = &result->textures[i];
+    if (texture->isDuplicate) {
+      Texture* source = &result->textures[texture->duplicateOf];
+      texture->width = source->width;
+      texture->height = source->height;
+      texture->dataSize = source->dataSize;
     }
   }
 
+  ScratchEnd(imageScratch);
+
   u32 maxPrimitivesPerMesh = 1;
   for (u32 i = 0; i < data->meshes_count; ++i) {
     cgltf_mesh& cmesh = data->meshes[i];
@@ -362,13 +473,14 @@ inline Model* parseGLTF(Arena* arena, String8 path) {
   }
 
   // compute firstInstance and total instance count
-  u32 totalInstanceCount = 0;
+  Temp scanScratch = ScratchBegin(&arena, 1);
+  u32* primitiveFirstInstances = PushArrayNoZero(scanScratch.arena, u32, result->primitivesCount);
+  u32 totalInstanceCount = scanExclusiveU32(primitiveInstanceCounts, primitiveFirstInstances, result->primitivesCount);
   for (u32 p = 0; p < result->primitivesCount; ++p) {
-    u32 count = primitiveInstanceCounts[p];
-    result->primitives[p].firstInstance = totalInstanceCount;
-    result->primitives[p].instanceCount = count;
-    totalInstanceCount += count;
+    result->primitives[p].firstInstance = primitiveFirstInstances[p];
+    result->primitives[p].instanceCount = primitiveInstanceCounts[p];
   }
+  ScratchEnd(scanScratch);
 
   result->instanceData = PushArray(arena, GeometryInstanceData, totalInstanceCount);
   result->instanceCount = totalInstanceCount;
@@ -410,3 +522,11 @@ inline Model* parseGLTF(Arena* arena, String8 path) {
   result->valid = true;
   return result;
 }
+
+// Texture pixels are owned by the GLTF heap, release them once they've been uploaded
+inline void freeTextureData(Texture* texture) {
+  if (texture->data) {
+    stbi_image_free(texture->data);
+    texture->data = nullptr;
+  }
+}
@@ -31,3 +31,77 @@ static u64 OS_estimateCPUTimerFreq() {
 
   return cpuFreq;
 }
+
+// CPU topology
+
+static OS_CpuTopology osCpuTopology;
+// 0 not detected yet, 1 being detected, 2 done
+static u32 osCpuTopologyState;
+
+// Per platform. Fills processorCore, the cores' masks, package, NUMA node, kind and caches (size, line size and
+// processor mask), and hybrid. Everything else is derived below.
+static void OS_detectCpuTopology(OS_CpuTopology* topology);
+
+static u32 OS_cpuCacheCoreCount(OS_CpuTopology* topology, u64 processorMask) {
+  u32 result = 0;
+  for (u32 i = 0; i < topology->coreCount; ++i) {
+    result += (topology->cores[i].processorMask & processorMask) != 0;
+  }
+  return result;
+}
+
+static void OS_finishCpuTopology(OS_CpuTopology* topology) {
+  if (topology->coreCount == 0) {
+    // Nothing detected, one core per logical processor
+    MemorySet(topology->processorCore, 0xFF, sizeof(topology->processorCore));
+    u32 count = Min(OS_logicalProcessorCount(), (u32)OS_CPU_MAX_PROCESSORS);
+    for (u32 i = 0; i < count; ++i) {
+      topology->processorCore[i] = i;
+      topology->cores[i].processorMask = 1ull << i;
+    }
+    topology->coreCount = count;
+  }
+
+  u64 packageMask = 0;
+  u64 numaNodeMask = 0;
+  for (u32 i = 0; i < topology->coreCount; ++i) {
+    OS_CpuCore* core = &topology->cores[i];
+    core->processorCount = CountSetBits64(core->processorMask);
+    topology->processorMask |= core->processorMask;
+    packageMask |= 1ull << (core->package & 63);
+    numaNodeMask |= 1ull << (core->numaNode & 63);
+    if (core->kind == OS_CoreKind_Efficiency) {
+      topology->efficiencyCoreCount += 1;
+    } else {
+      topology->performanceCoreCount += 1;
+    }
+
+    OS_CpuCache* caches[] = { &core->l1Data, &core->l1Instruction, &core->l2, &core->l3 };
+    for (OS_CpuCache* cache : caches) {
+      if (cache->size != 0) {
+        cache->processorMask = cache->processorMask ? cache->processorMask : core->processorMask;
+        cache->coreCount = OS_cpuCacheCoreCount(topology, cache->processorMask);
+      }
+    }
+  }
+  topology->processorCount = CountSetBits64(topology->processorMask);
+  topology->packageCount = CountSetBits64(packageMask);
+  topology->numaNodeCount = CountSetBits64(numaNodeMask);
+  topology->hybrid = topology->efficiencyCoreCount != 0;
+}
+
+const OS_CpuTopology* OS_cpuTopology() {
+  if (AtomicLoadU32(&osCpuTopologyState) != 2) {
+    if (AtomicCompareExchangeU32(&osCpuTopologyState, 1, 0) == 0) {
+      MemorySet(osCpuTopology.processorCore, 0xFF, sizeof(osCpuTopology.processorCore));
+      OS_detectCpuTopology(&osCpuTopology);
+      OS_finishCpuTopology(&osCpuTopology);
+      AtomicStoreU32(&osCpuTopologyState, 2);
+    } else {
+      while (AtomicLoadU32(&osCpuTopologyState) != 2) {
+        OS_threadYield();
+      }
+    }
+  }
+  return &osCpuTopology;
+}
@@ -6,6 +6,13 @@ struct OSWindowHandle {
   u64 u64[1];
 };
 
+struct OS_Handle {
+  u64 u64[1];
+};
+
+using OS_ThreadFunction = void(void* params);
+using OS_FiberFunction = void(void* params);
+
 enum OS_CursorType {
   OS_CursorType_Null,
   OS_CursorType_Hidden,
@@ -31,8 +38,254 @@ void OS_release(void* ptr, u64 size);
 void OS_commit(void* ptr, u64 size);
 void OS_decommit(void* ptr, u64 size);
 
+// Large pages
+// OS_reserveLarge reserves *and commits* the whole range with large pages (MAP_HUGETLB / MEM_LARGE_PAGES).
+// Returns nullptr when the OS can't provide them (no hugetlb pool, missing SeLockMemoryPrivilege, ...).
+u64 OS_largePageSize();
+void* OS_reserveLarge(u64 size);
+// Transparent huge page hint for an already reserved range. Returns false if the OS has no such mechanism.
+b32 OS_adviseHugePages(void* ptr, u64 size);
+
+// Mirrored ring mappings
+// Maps the same size bytes of memory twice, back to back, so base[i] and base[i + size] alias.
+// size must be a multiple of OS_allocationGranularity(). Returns nullptr on failure.
+u64 OS_allocationGranularity();
+void* OS_ringAlloc(u64 size, OS_Handle* handle);
+void OS_ringRelease(void* base, u64 size, OS_Handle handle);
+
+// Faults in a committed range so later first-touch writes don't take soft page faults.
+// Doesn't change the contents, so it is safe to call on memory another thread is writing to.
+void OS_prefault(void* ptr, u64 size);
+
 void OS_abort();
 
+// Threads
+// Every launched thread runs with its own ThreadCtx (scratch arenas, name) from ThreadCtx_alloc, released when
+// func returns. Affinity and priority are applied before that.
+enum OS_ThreadPriority {
+  OS_ThreadPriority_Normal,
+  OS_ThreadPriority_High,
+  OS_ThreadPriority_Low,
+};
+
+struct OS_ThreadParams {
+  // Shown in debuggers and profilers. Linux truncates it to 15 characters.
+  String8 name{};
+  // Bit i allows logical processor i. 0 lets the thread run anywhere.
+  u64 affinityMask{};
+  OS_ThreadPriority priority{};
+  // 0 uses the OS default
+  u64 stackSize{};
+};
+
+OS_Handle OS_threadLaunch(OS_ThreadFunction* func, void* params, OS_ThreadParams threadParams = {});
+void OS_threadJoin(OS_Handle thread);
+// Lets the thread run to completion on its own. The handle can't be joined afterwards.
+void OS_threadDetach(OS_Handle thread);
+
+// These act on the calling thread
+void OS_setThreadName(String8 name);
+b32 OS_setThreadAffinity(u64 affinityMask);
+// Raising it above normal needs CAP_SYS_NICE on Linux, it fails without
+b32 OS_setThreadPriority(OS_ThreadPriority priority);
+u32 OS_threadId();
+// Logical processor the thread runs on right now, it may move right after unless it's pinned
+u32 OS_currentProcessor();
+void OS_threadYield();
+void OS_sleepMilliseconds(u32 milliseconds);
+
+u32 OS_logicalProcessorCount();
+
+// CPU topology
+// Detected on first use from /sys/devices/system/cpu and cpuid on Linux, GetLogicalProcessorInformationEx on
+// Windows. Affinity masks are u64, so only the first 64 logical processors (processor group 0 on Windows) are
+// described. Cores are ordered by their first logical processor.
+#define OS_CPU_MAX_PROCESSORS 64
+
+enum OS_CoreKind {
+  OS_CoreKind_Performance,
+  // Smaller cores of hybrid parts (Intel E-cores)
+  OS_CoreKind_Efficiency,
+};
+
+struct OS_CpuCache {
+  // One instance, 0 when the level doesn't exist
+  u64 size;
+  u32 lineSize;
+  // Physical cores sharing that instance
+  u32 coreCount;
+  u64 processorMask;
+};
+
+struct OS_CpuCore {
+  // SMT siblings
+  u64 processorMask;
+  u32 processorCount;
+  u32 package;
+  u32 numaNode;
+  OS_CoreKind kind;
+
+  OS_CpuCache l1Data;
+  OS_CpuCache l1Instruction;
+  OS_CpuCache l2;
+  OS_CpuCache l3;
+};
+
+struct OS_CpuTopology {
+  u32 processorCount;
+  u32 coreCount;
+  u32 packageCount;
+  u32 numaNodeCount;
+  // Without hybrid cores every core counts as a performance core
+  b32 hybrid;
+  u32 performanceCoreCount;
+  u32 efficiencyCoreCount;
+  u64 processorMask;
+
+  // Indexed by logical processor, u32Max for the ones that aren't online
+  u32 processorCore[OS_CPU_MAX_PROCESSORS];
+  OS_CpuCore cores[OS_CPU_MAX_PROCESSORS];
+};
+
+const OS_CpuTopology* OS_cpuTopology();
+
+// Semaphores
+OS_Handle OS_semaphoreAlloc(u32 initialCount, u32 maxCount);
+void OS_semaphoreRelease(OS_Handle semaphore);
+void OS_semaphoreWait(OS_Handle semaphore);
+void OS_semaphoreSignal(OS_Handle semaphore);
+
+// Mutexes. Not recursive.
+OS_Handle OS_mutexAlloc();
+void OS_mutexRelease(OS_Handle mutex);
+void OS_mutexLock(OS_Handle mutex);
+b32 OS_mutexTryLock(OS_Handle mutex);
+void OS_mutexUnlock(OS_Handle mutex);
+
+// Reader/writer locks
+OS_Handle OS_rwLockAlloc();
+void OS_rwLockRelease(OS_Handle lock);
+void OS_rwLockReadLock(OS_Handle lock);
+void OS_rwLockReadUnlock(OS_Handle lock);
+void OS_rwLockWriteLock(OS_Handle lock);
+void OS_rwLockWriteUnlock(OS_Handle lock);
+
+// Condition variables, used with an OS_mutexAlloc mutex. Waits can wake spuriously, recheck the condition.
+OS_Handle OS_condVarAlloc();
+void OS_condVarRelease(OS_Handle condVar);
+void OS_condVarWait(OS_Handle condVar, OS_Handle mutex);
+// Returns false if the timeout expired
+b32 OS_condVarWaitTimeout(OS_Handle condVar, OS_Handle mutex, u32 milliseconds);
+void OS_condVarSignal(OS_Handle condVar);
+void OS_condVarBroadcast(OS_Handle condVar);
+
+// Fibers
+// User mode contexts with their own stack, switched explicitly. A thread turns itself into a fiber with
+// OS_fiberThreadEnter before switching to any other fiber. Fiber functions must never return, switch away instead.
+// stack is caller owned memory (Linux switches with hand-written x86-64 code), Windows ignores it and lets
+// CreateFiberEx allocate stackSize itself.
+OS_Handle OS_fiberThreadEnter();
+void OS_fiberThreadExit(OS_Handle fiber);
+OS_Handle OS_fiberCreate(void* stack, u64 stackSize, OS_FiberFunction* func, void* params);
+void OS_fiberRelease(OS_Handle fiber);
+// Saves the running context into from and resumes to. from must be the fiber currently running on this thread.
+void OS_fiberSwitch(OS_Handle from, OS_Handle to);
+
+// Futex style wait on a 32-bit address (futex on Linux, WaitOnAddress on Windows). OS_futexWait sleeps only if
+// *address still equals expected, and can return spuriously. Waits and wakes only pair up within a process.
+void OS_futexWait(u32* address, u32 expected);
+void OS_futexWakeOne(u32* address);
+void OS_futexWakeAll(u32* address);
+
+// Files
+using OS_FileFlags = u32;
+enum {
+  OS_FileFlag_Read = (1 << 0),
+  // Skips the page cache (O_DIRECT / FILE_FLAG_NO_BUFFERING). Offsets, sizes and buffers of every read on the file
+  // must be multiples of OS_FILE_UNBUFFERED_ALIGNMENT. Some file systems refuse it, fall back to a buffered open.
+  OS_FileFlag_Unbuffered = (1 << 1),
+};
+
+#define OS_FILE_UNBUFFERED_ALIGNMENT 4096
+
+// Check the result with OS_fileIsValid
+OS_Handle OS_fileOpen(String8 path, OS_FileFlags flags);
+b32 OS_fileIsValid(OS_Handle file);
+void OS_fileClose(OS_Handle file);
+u64 OS_fileSize(OS_Handle file);
+// Blocking. Returns the bytes read, short at the end of the file.
+u64 OS_fileRead(OS_Handle file, u64 offset, void* dst, u64 size);
+
+// Memory mapped files
+// The file comes back as a String8 over the mapped bytes, so Substr8 and friends work on it directly.
+// Empty on failure, and for empty files.
+enum OS_FileMapMode {
+  // Writing to the mapping faults
+  OS_FileMapMode_ReadOnly,
+  // Writes go to private copies of the touched pages, the file never changes
+  OS_FileMapMode_CopyOnWrite,
+};
+
+using OS_FileMapHints = u32;
+enum {
+  OS_FileMapHint_Sequential = (1 << 0),
+  OS_FileMapHint_Random     = (1 << 1),
+  // Starts reading the range in the background
+  OS_FileMapHint_WillNeed   = (1 << 2),
+  // Backs the range with huge pages where the file system supports it. Linux only.
+  OS_FileMapHint_HugePages  = (1 << 3),
+};
+
+// maxSize maps only the start of the file, 0 maps all of it
+String8 OS_fileMap(String8 path, OS_FileMapMode mode, OS_FileMapHints hints = 0, u64 maxSize = 0);
+// Takes the string OS_fileMap returned
+void OS_fileUnmap(String8 mapped);
+// range is any part of a mapping, it is widened to whole pages. Hints are advisory, unsupported ones are ignored.
+void OS_fileMapAdvise(String8 range, OS_FileMapHints hints);
+// Reads the range in ahead of use without blocking (MADV_WILLNEED / PrefetchVirtualMemory)
+void OS_fileMapPrefetch(String8 range);
+
+// Async file I/O
+// NOTE(piero): OS_ioQueueRead only records a read. OS_ioSubmit hands everything recorded to the kernel in a single
+//              call (io_uring on Linux, overlapped reads on an I/O completion port on Windows), higher priorities
+//              first, and keeps at most depth reads in flight. The rest wait for the next submit.
+//              OS_ioComplete collects finished reads. A queue is single threaded, lock around it to share it.
+//              Linux also passes the priority to the I/O scheduler. Without io_uring, reads happen during the submit.
+//              A file may only ever be read through one queue, Windows binds it to that queue's completion port.
+enum OS_IoPriority {
+  OS_IoPriority_High,
+  OS_IoPriority_Normal,
+  OS_IoPriority_Low,
+  OS_IoPriority_COUNT
+};
+
+// Caller owned, and must stay where it is until OS_ioComplete hands it back
+struct OS_IoRead {
+  OS_Handle file;
+  u64 offset;
+  // At most OS_IO_MAX_READ_SIZE
+  u64 size;
+  void* dst;
+  OS_IoPriority priority;
+  void* userData;
+
+  // Bytes read, negative on failure
+  i64 result;
+  OS_IoRead* next;
+};
+
+#define OS_IO_MAX_READ_SIZE Gigabytes(1)
+
+OS_Handle OS_ioQueueAlloc(u32 depth);
+// Reads still in flight are waited for
+void OS_ioQueueRelease(OS_Handle queue);
+void OS_ioQueueRead(OS_Handle queue, OS_IoRead* read);
+// Returns how many reads went to the kernel
+u32 OS_ioSubmit(OS_Handle queue);
+// Returns how many reads were written to completed. With wait it blocks until at least one finishes, unless
+// nothing is in flight.
+u32 OS_ioComplete(OS_Handle queue, OS_IoRead** completed, u32 maxCount, b32 wait);
+
 static u64 OS_getOSTimerFreq();
 static u64 OS_readOSTimer();
 static u64 OS_readCPUTimer();
@@ -3,21 +3,135 @@
 #include "os_core.h"
 #include "platform/os/gfx/os_gfx.h"
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <time.h>
 #include <unistd.h>
 #include <x86intrin.h>
+#include <cpuid.h>
+#include <linux/futex.h>
+#include <linux/io_uring.h>
+#include <errno.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 
+enum OS_LinuxEntityKind {
+  OS_LinuxEntityKind_Null,
+  OS_LinuxEntityKind_Thread,
+  OS_LinuxEntityKind_Semaphore,
+  OS_LinuxEntityKind_Mutex,
+  OS_LinuxEntityKind_RWLock,
+  OS_LinuxEntityKind_CondVar,
+  OS_LinuxEntityKind_Fiber,
+  OS_LinuxEntityKind_IoQueue,
+};
+
+// NOTE(piero): Backing storage for OS handles that don't fit in a u64
+struct OS_LinuxEntity {
+  OS_LinuxEntity* next;
+  OS_LinuxEntityKind kind;
+  union {
+    struct {
+      pthread_t handle;
+      OS_ThreadFunction* func;
+      void* params;
+      u64 affinityMask;
+      OS_ThreadPriority priority;
+      u8 name[64];
+      u64 nameSize;
+      // Held by the thread itself and by whoever joins or detaches it, the last one out frees the entity
+      u32 refCount;
+    } thread;
+    sem_t semaphore;
+    pthread_mutex_t mutex;
+    pthread_rwlock_t rwLock;
+    pthread_cond_t condVar;
+    struct {
+      // Saved rsp while the fiber is switched out, everything else lives on its stack
+      void* stackPointer;
+      OS_FiberFunction* func;
+      void* params;
+    } fiber;
+    struct {
+      // -1 when io_uring isn't available
+      int ringFd;
+      u32 depth;
+      // Counts the unsubmitted ones too
+      u32 inFlight;
+      // Written to the submission ring but not taken by the kernel yet, the last ones before the tail
+      u32 unsubmitted;
+
+      // Rings shared with the kernel. We own the submission tail and the completion head.
+      u32* sqTail;
+      u32* sqArray;
+      u32 sqMask;
+      io_uring_sqe* sqes;
+      u32* cqHead;
+      u32* cqTail;
+      u32 cqMask;
+      io_uring_cqe* cqes;
+
+      void* sqRing;
+      u64 sqRingSize;
+      void* cqRing;
+      u64 cqRingSize;
+      u64 sqesSize;
+
+      // FIFO per priority
+      OS_IoRead* pendingFirst[OS_IoPriority_COUNT];
+      OS_IoRead* pendingLast[OS_IoPriority_COUNT];
+      // Reads done synchronously without io_uring, and reads the kernel refused
+      OS_IoRead* completed;
+    } ioQueue;
+  };
+};
+
+static OS_LinuxEntity osLinuxEntities[1024];
+static OS_LinuxEntity* osLinuxEntityFree;
+static u64 osLinuxEntityCount;
+static pthread_mutex_t osLinuxEntityMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static OS_LinuxEntity* OS_linuxEntityAlloc(OS_LinuxEntityKind kind) {
+  pthread_mutex_lock(&osLinuxEntityMutex);
+  OS_LinuxEntity* entity = osLinuxEntityFree;
+  if (entity != nullptr) {
+    StackPop(osLinuxEntityFree);
+  } else if (osLinuxEntityCount < ArrayCount(osLinuxEntities)) {
+    entity = &osLinuxEntities[osLinuxEntityCount++];
+  }
+  pthread_mutex_unlock(&osLinuxEntityMutex);
+
+  if (entity == nullptr) {
+    OS_abort();
+  }
+  MemoryZeroStruct(entity);
+  entity->kind = kind;
+  return entity;
+}
+
+static void OS_linuxEntityRelease(OS_LinuxEntity* entity) {
+  entity->kind = OS_LinuxEntityKind_Null;
+  pthread_mutex_lock(&osLinuxEntityMutex);
+  StackPush(osLinuxEntityFree, entity);
+  pthread_mutex_unlock(&osLinuxEntityMutex);
+}
+
 u64 OS_pageSize() {
   u64 result = getpagesize();
   return result;
 }
 
 void* OS_reserve(u64 size) {
-  u64 gbSize = size;
-  gbSize += Gigabytes(1) - 1;
-  gbSize -= gbSize % Gigabytes(1);
-  mem = mmap(nullptr, gbSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void* mem = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    mem = nullptr;
+  }
+  return mem;
 }
 
 void OS_release(void* ptr, u64 size) {
@@ -32,14 +146,998 @@ void OS_commit(void* ptr, u64 size) {
 }
 
 void OS_decommit(void* ptr, u64 size) {
+  // NOTE(piero): PROT_NONE alone keeps the pages resident, MADV_DONTNEED gives them back
+  madvise(ptr, size, MADV_DONTNEED);
   u32 err = mprotect(ptr, size, PROT_NONE);
   assert(err == 0);
 }
 
+u64 OS_largePageSize() {
+  return Megabytes(2);
+}
+
+void* OS_reserveLarge(u64 size) {
+  u64 alignedSize = AlignPow2(size, OS_largePageSize());
+  void* mem = mmap(nullptr, alignedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (mem == MAP_FAILED) {
+    mem = nullptr;
+  }
+  return mem;
+}
+
+b32 OS_adviseHugePages(void* ptr, u64 size) {
+  i32 err = madvise(ptr, size, MADV_HUGEPAGE);
+  return err == 0;
+}
+
+u64 OS_allocationGranularity() {
+  return OS_pageSize();
+}
+
+void* OS_ringAlloc(u64 size, OS_Handle* handle) {
+  i32 fd = memfd_create("ring", MFD_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  if (ftruncate(fd, (off_t)size) != 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  // Reserve both halves first so nothing else can land in between, then map the same pages over them
+  u8* base = (u8*)mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+
+  void* first = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+  void* second = mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+  if (first != base || second != base + size) {
+    munmap(base, size * 2);
+    close(fd);
+    return nullptr;
+  }
+
+  handle->u64[0] = (u64)fd;
+  return base;
+}
+
+void OS_ringRelease(void* base, u64 size, OS_Handle handle) {
+  munmap(base, size * 2);
+  close((i32)handle.u64[0]);
+}
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+no_asan void OS_prefault(void* ptr, u64 size) {
+  // NOTE(piero): MADV_POPULATE_WRITE needs Linux 5.14+, fall back to touching every page
+  if (madvise(ptr, size, MADV_POPULATE_WRITE) != 0) {
+    u64 pageSize = OS_pageSize();
+    for (u64 offset = 0; offset < size; offset += pageSize) {
+      AtomicAddU32((u32*)((u8*)ptr + offset), 0);
+    }
+  }
+}
+
 void OS_abort() {
   _exit(0);
 }
 
+static void OS_linuxThreadRelease(OS_LinuxEntity* entity) {
+  if (AtomicAddU32(&entity->thread.refCount, (u32)-1) == 1) {
+    OS_linuxEntityRelease(entity);
+  }
+}
+
+static void* OS_linuxThreadEntryPoint(void* ptr) {
+  auto* entity = (OS_LinuxEntity*)ptr;
+
+  if (entity->thread.priority != OS_ThreadPriority_Normal) {
+    OS_setThreadPriority(entity->thread.priority);
+  }
+  // Pins the thread first, so the context knows its core
+  ThreadCtx threadCtx = ThreadCtx_alloc(entity->thread.affinityMask);
+  ThreadCtx_set(&threadCtx);
+  if (entity->thread.nameSize) {
+    ThreadCtx_setName(Str8(entity->thread.name, entity->thread.nameSize));
+  }
+
+  entity->thread.func(entity->thread.params);
+
+  ThreadCtx_release();
+  OS_linuxThreadRelease(entity);
+  return nullptr;
+}
+
+OS_Handle OS_threadLaunch(OS_ThreadFunction* func, void* params, OS_ThreadParams threadParams) {
+  OS_LinuxEntity* entity = OS_linuxEntityAlloc(OS_LinuxEntityKind_Thread);
+  entity->thread.func = func;
+  entity->thread.params = params;
+  entity->thread.affinityMask = threadParams.affinityMask;
+  entity->thread.priority = threadParams.priority;
+  entity->thread.nameSize = Min(threadParams.name.size, sizeof(entity->thread.name));
+  MemoryCopy(entity->thread.name, threadParams.name.str, entity->thread.nameSize);
+  entity->thread.refCount = 2;
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (threadParams.stackSize) {
+    pthread_attr_setstacksize(&attr, AlignPow2(threadParams.stackSize, OS_pageSize()));
+  }
+  if (pthread_create(&entity->thread.handle, &attr, OS_linuxThreadEntryPoint, entity) != 0) {
+    OS_linuxEntityRelease(entity);
+    entity = nullptr;
+  }
+  pthread_attr_destroy(&attr);
+
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_threadJoin(OS_Handle thread) {
+  auto* entity = (OS_LinuxEntity*)thread.u64[0];
+  if (entity != nullptr) {
+    pthread_join(entity->thread.handle, nullptr);
+    OS_linuxThreadRelease(entity);
+  }
+}
+
+void OS_threadDetach(OS_Handle thread) {
+  auto* entity = (OS_LinuxEntity*)thread.u64[0];
+  if (entity != nullptr) {
+    pthread_detach(entity->thread.handle);
+    OS_linuxThreadRelease(entity);
+  }
+}
+
+void OS_setThreadName(String8 name) {
+  // NOTE(piero): The kernel keeps 16 bytes including the terminator and rejects anything longer
+  char buffer[16];
+  u64 size = Min(name.size, sizeof(buffer) - 1);
+  MemoryCopy(buffer, name.str, size);
+  buffer[size] = 0;
+  pthread_setname_np(pthread_self(), buffer);
+}
+
+b32 OS_setThreadAffinity(u64 affinityMask) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (u32 cpu = 0; cpu < 64; ++cpu) {
+    if (affinityMask & (1ull << cpu)) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// NOTE(piero): Linux threads are scheduled on their own nice value, so the process priority call on a thread id
+//              changes only that thread
+b32 OS_setThreadPriority(OS_ThreadPriority priority) {
+  int nice = 0;
+  if (priority == OS_ThreadPriority_High) {
+    nice = -5;
+  } else if (priority == OS_ThreadPriority_Low) {
+    nice = 5;
+  }
+  return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) == 0;
+}
+
+u32 OS_threadId() {
+  return (u32)syscall(SYS_gettid);
+}
+
+u32 OS_currentProcessor() {
+  int cpu = sched_getcpu();
+  return cpu >= 0 ? (u32)cpu : 0;
+}
+
+void OS_threadYield() {
+  sched_yield();
+}
+
+void OS_sleepMilliseconds(u32 milliseconds) {
+  timespec duration = { .tv_sec = milliseconds / 1000, .tv_nsec = (long)(milliseconds % 1000) * 1000000 };
+  while (nanosleep(&duration, &duration) != 0) {
+    // retry on EINTR with what's left
+  }
+}
+
+u32 OS_logicalProcessorCount() {
+  i64 count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (u32)count : 1;
+}
+
+// CPU topology
+
+// Empty string when the file doesn't exist
+static String8 OS_linuxReadSysFile(char* buffer, u64 bufferSize, const char* format, u32 a, u32 b = 0) {
+  char path[128];
+  snprintf(path, sizeof(path), format, a, b);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return {};
+  }
+  ssize_t size = read(fd, buffer, bufferSize - 1);
+  close(fd);
+  size = Max(size, (ssize_t)0);
+  buffer[size] = 0;
+  return Str8((u8*)buffer, (u64)size);
+}
+
+static u64 OS_linuxParseU64(String8 string) {
+  u64 result = 0;
+  for (u64 i = 0; i < string.size && string.str[i] >= '0' && string.str[i] <= '9'; ++i) {
+    result = result * 10 + (string.str[i] - '0');
+  }
+  return result;
+}
+
+// "0-3,8,10-11" to a mask, processors past OS_CPU_MAX_PROCESSORS are dropped
+static u64 OS_linuxParseCpuList(String8 list) {
+  u64 result = 0;
+  u64 i = 0;
+  while (i < list.size) {
+    u64 first = OS_linuxParseU64(Substr8(list, i, list.size));
+    while (i < list.size && list.str[i] >= '0' && list.str[i] <= '9') {
+      i += 1;
+    }
+    u64 last = first;
+    if (i < list.size && list.str[i] == '-') {
+      i += 1;
+      last = OS_linuxParseU64(Substr8(list, i, list.size));
+      while (i < list.size && list.str[i] >= '0' && list.str[i] <= '9') {
+        i += 1;
+      }
+    }
+    for (u64 cpu = first; cpu <= last && cpu < OS_CPU_MAX_PROCESSORS; ++cpu) {
+      result |= 1ull << cpu;
+    }
+    if (i < list.size && list.str[i] != ',') {
+      break;
+    }
+    i += 1;
+  }
+  return result;
+}
+
+// "48K", "2048K", "32M"
+static u64 OS_linuxParseSize(String8 string) {
+  u64 result = OS_linuxParseU64(string);
+  u64 i = 0;
+  while (i < string.size && string.str[i] >= '0' && string.str[i] <= '9') {
+    i += 1;
+  }
+  if (i < string.size && string.str[i] == 'K') {
+    result = Kilobytes(result);
+  } else if (i < string.size && string.str[i] == 'M') {
+    result = Megabytes(result);
+  }
+  return result;
+}
+
+static void OS_linuxDetectCaches(OS_CpuCore* core, u32 cpu) {
+  char buffer[256];
+  for (u32 index = 0; index < 8; ++index) {
+    String8 level = OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/cpu/cpu%u/cache/index%u/level", cpu, index);
+    if (level.size == 0) {
+      break;
+    }
+    u64 levelNumber = OS_linuxParseU64(level);
+    String8 type = OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/cpu/cpu%u/cache/index%u/type", cpu, index);
+
+    OS_CpuCache* cache = nullptr;
+    if (levelNumber == 1 && Str8Match(Substr8(type, 0, 4), Str8L("Data"), 0)) {
+      cache = &core->l1Data;
+    } else if (levelNumber == 1 && Str8Match(Substr8(type, 0, 11), Str8L("Instruction"), 0)) {
+      cache = &core->l1Instruction;
+    } else if (levelNumber == 2) {
+      cache = &core->l2;
+    } else if (levelNumber == 3) {
+      cache = &core->l3;
+    }
+    if (cache == nullptr) {
+      continue;
+    }
+
+    cache->size = OS_linuxParseSize(OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/cpu/cpu%u/cache/index%u/size", cpu, index));
+    cache->lineSize = (u32)OS_linuxParseU64(OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/cpu/cpu%u/cache/index%u/coherency_line_size", cpu, index));
+    cache->processorMask = OS_linuxParseCpuList(OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list", cpu, index));
+  }
+}
+
+// NOTE(piero): cpuid leaf 7 says whether the part is hybrid, and leaf 0x1A the type of the core it runs on. The
+//              kernel lists the E-cores under the cpu_atom PMU, without it every core is visited once to ask.
+static void* OS_linuxCoreKindProbe(void* params) {
+  auto* topology = (OS_CpuTopology*)params;
+  for (u32 i = 0; i < topology->coreCount; ++i) {
+    OS_CpuCore* core = &topology->cores[i];
+    if (!OS_setThreadAffinity(core->processorMask)) {
+      continue;
+    }
+    u32 eax, ebx, ecx, edx;
+    __cpuid_count(0x1A, 0, eax, ebx, ecx, edx);
+    // Core type in the top byte, 0x20 is Atom
+    if ((eax >> 24) == 0x20) {
+      core->kind = OS_CoreKind_Efficiency;
+    }
+  }
+  return nullptr;
+}
+
+static void OS_linuxDetectCoreKinds(OS_CpuTopology* topology) {
+  u32 eax, ebx, ecx, edx;
+  if (__get_cpuid_max(0, nullptr) < 0x1A) {
+    return;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  if ((edx & (1u << 15)) == 0) {
+    return;
+  }
+
+  char buffer[512];
+  String8 atomList = OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/cpu_atom/cpus", 0);
+  if (atomList.size != 0) {
+    u64 atomMask = OS_linuxParseCpuList(atomList);
+    for (u32 i = 0; i < topology->coreCount; ++i) {
+      if (topology->cores[i].processorMask & atomMask) {
+        topology->cores[i].kind = OS_CoreKind_Efficiency;
+      }
+    }
+    return;
+  }
+
+  // cpuid reports on the processor it runs on, so something has to visit every core. A throwaway thread does
+  // it, the caller keeps its affinity and never migrates. Plain pthread, a launched thread would ask for the
+  // topology being detected.
+  pthread_t thread;
+  if (pthread_create(&thread, nullptr, OS_linuxCoreKindProbe, topology) == 0) {
+    pthread_join(thread, nullptr);
+  }
+}
+
+static void OS_detectCpuTopology(OS_CpuTopology* topology) {
+  char buffer[512];
+  u64 online = OS_linuxParseCpuList(OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/cpu/online", 0));
+
+  for (u32 cpu = 0; cpu < OS_CPU_MAX_PROCESSORS; ++cpu) {
+    if ((online & (1ull << cpu)) == 0) {
+      continue;
+    }
+    u64 siblings = OS_linuxParseCpuList(OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", cpu));
+    siblings = siblings ? siblings & online : 1ull << cpu;
+
+    u32 coreIndex = 0;
+    while (coreIndex < topology->coreCount && topology->cores[coreIndex].processorMask != siblings) {
+      coreIndex += 1;
+    }
+    topology->processorCore[cpu] = coreIndex;
+    if (coreIndex < topology->coreCount) {
+      continue;
+    }
+
+    OS_CpuCore* core = &topology->cores[topology->coreCount++];
+    core->processorMask = siblings;
+    core->package = (u32)OS_linuxParseU64(OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu));
+    OS_linuxDetectCaches(core, cpu);
+  }
+
+  for (u32 node = 0; node < 64; ++node) {
+    String8 list = OS_linuxReadSysFile(buffer, sizeof(buffer), "/sys/devices/system/node/node%u/cpulist", node);
+    u64 mask = OS_linuxParseCpuList(list);
+    for (u32 i = 0; i < topology->coreCount; ++i) {
+      if (topology->cores[i].processorMask & mask) {
+        topology->cores[i].numaNode = node;
+      }
+    }
+  }
+
+  OS_linuxDetectCoreKinds(topology);
+}
+
+// NOTE(piero): POSIX semaphores have no max count, maxCount is ignored
+OS_Handle OS_semaphoreAlloc(u32 initialCount, u32 maxCount) {
+  OS_LinuxEntity* entity = OS_linuxEntityAlloc(OS_LinuxEntityKind_Semaphore);
+  sem_init(&entity->semaphore, 0, initialCount);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_semaphoreRelease(OS_Handle semaphore) {
+  auto* entity = (OS_LinuxEntity*)semaphore.u64[0];
+  sem_destroy(&entity->semaphore);
+  OS_linuxEntityRelease(entity);
+}
+
+void OS_semaphoreWait(OS_Handle semaphore) {
+  auto* entity = (OS_LinuxEntity*)semaphore.u64[0];
+  while (sem_wait(&entity->semaphore) != 0) {
+    // retry on EINTR
+  }
+}
+
+void OS_semaphoreSignal(OS_Handle semaphore) {
+  auto* entity = (OS_LinuxEntity*)semaphore.u64[0];
+  sem_post(&entity->semaphore);
+}
+
+OS_Handle OS_mutexAlloc() {
+  OS_LinuxEntity* entity = OS_linuxEntityAlloc(OS_LinuxEntityKind_Mutex);
+  pthread_mutex_init(&entity->mutex, nullptr);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_mutexRelease(OS_Handle mutex) {
+  auto* entity = (OS_LinuxEntity*)mutex.u64[0];
+  pthread_mutex_destroy(&entity->mutex);
+  OS_linuxEntityRelease(entity);
+}
+
+void OS_mutexLock(OS_Handle mutex) {
+  auto* entity = (OS_LinuxEntity*)mutex.u64[0];
+  pthread_mutex_lock(&entity->mutex);
+}
+
+b32 OS_mutexTryLock(OS_Handle mutex) {
+  auto* entity = (OS_LinuxEntity*)mutex.u64[0];
+  return pthread_mutex_trylock(&entity->mutex) == 0;
+}
+
+void OS_mutexUnlock(OS_Handle mutex) {
+  auto* entity = (OS_LinuxEntity*)mutex.u64[0];
+  pthread_mutex_unlock(&entity->mutex);
+}
+
+OS_Handle OS_rwLockAlloc() {
+  OS_LinuxEntity* entity = OS_linuxEntityAlloc(OS_LinuxEntityKind_RWLock);
+  pthread_rwlock_init(&entity->rwLock, nullptr);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_rwLockRelease(OS_Handle lock) {
+  auto* entity = (OS_LinuxEntity*)lock.u64[0];
+  pthread_rwlock_destroy(&entity->rwLock);
+  OS_linuxEntityRelease(entity);
+}
+
+void OS_rwLockReadLock(OS_Handle lock) {
+  auto* entity = (OS_LinuxEntity*)lock.u64[0];
+  pthread_rwlock_rdlock(&entity->rwLock);
+}
+
+void OS_rwLockReadUnlock(OS_Handle lock) {
+  auto* entity = (OS_LinuxEntity*)lock.u64[0];
+  pthread_rwlock_unlock(&entity->rwLock);
+}
+
+void OS_rwLockWriteLock(OS_Handle lock) {
+  auto* entity = (OS_LinuxEntity*)lock.u64[0];
+  pthread_rwlock_wrlock(&entity->rwLock);
+}
+
+void OS_rwLockWriteUnlock(OS_Handle lock) {
+  auto* entity = (OS_LinuxEntity*)lock.u64[0];
+  pthread_rwlock_unlock(&entity->rwLock);
+}
+
+// NOTE(piero): Condition variables time out against CLOCK_MONOTONIC so wall clock changes don't stretch waits
+OS_Handle OS_condVarAlloc() {
+  OS_LinuxEntity* entity = OS_linuxEntityAlloc(OS_LinuxEntityKind_CondVar);
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&entity->condVar, &attr);
+  pthread_condattr_destroy(&attr);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_condVarRelease(OS_Handle condVar) {
+  auto* entity = (OS_LinuxEntity*)condVar.u64[0];
+  pthread_cond_destroy(&entity->condVar);
+  OS_linuxEntityRelease(entity);
+}
+
+void OS_condVarWait(OS_Handle condVar, OS_Handle mutex) {
+  auto* entity = (OS_LinuxEntity*)condVar.u64[0];
+  auto* mutexEntity = (OS_LinuxEntity*)mutex.u64[0];
+  pthread_cond_wait(&entity->condVar, &mutexEntity->mutex);
+}
+
+b32 OS_condVarWaitTimeout(OS_Handle condVar, OS_Handle mutex, u32 milliseconds) {
+  auto* entity = (OS_LinuxEntity*)condVar.u64[0];
+  auto* mutexEntity = (OS_LinuxEntity*)mutex.u64[0];
+
+  timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  u64 nanoseconds = (u64)deadline.tv_nsec + (u64)milliseconds * 1000000;
+  deadline.tv_sec += (time_t)(nanoseconds / 1000000000);
+  deadline.tv_nsec = (long)(nanoseconds % 1000000000);
+
+  return pthread_cond_timedwait(&entity->condVar, &mutexEntity->mutex, &deadline) == 0;
+}
+
+void OS_condVarSignal(OS_Handle condVar) {
+  auto* entity = (OS_LinuxEntity*)condVar.u64[0];
+  pthread_cond_signal(&entity->condVar);
+}
+
+void OS_condVarBroadcast(OS_Handle condVar) {
+  auto* entity = (OS_LinuxEntity*)condVar.u64[0];
+  pthread_cond_broadcast(&entity->condVar);
+}
+
+// NOTE(piero): System V x86-64 context switch. Only the callee-saved state has to survive a call: rbx, rbp, r12-r15,
+//              the MXCSR control bits and the x87 control word. They are pushed on the current stack, rsp is saved
+//              to *from and the same frame is popped off the target stack, so the final ret resumes wherever the
+//              target last called OS_linuxFiberSwitch.
+//              A new fiber's stack is seeded with a frame that "returns" into OS_linuxFiberTrampoline with the
+//              entry function in r13 and its argument in r12.
+extern "C" void OS_linuxFiberSwitch(void** from, void* to);
+extern "C" void OS_linuxFiberTrampoline();
+
+asm(R"(
+  .text
+  .globl OS_linuxFiberSwitch
+  .type OS_linuxFiberSwitch, @function
+OS_linuxFiberSwitch:
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+  .size OS_linuxFiberSwitch, .-OS_linuxFiberSwitch
+
+  .globl OS_linuxFiberTrampoline
+  .type OS_linuxFiberTrampoline, @function
+OS_linuxFiberTrampoline:
+  movq %r12, %rdi
+  andq $-16, %rsp
+  callq *%r13
+  ud2
+  .size OS_linuxFiberTrampoline, .-OS_linuxFiberTrampoline
+)");
+
+static void OS_linuxFiberEntryPoint(OS_LinuxEntity* entity) {
+  entity->fiber.func(entity->fiber.params);
+  // Returning would run off the top of the stack
+  OS_abort();
+}
+
+OS_Handle OS_fiberThreadEnter() {
+  OS_LinuxEntity* entity = OS_linuxEntityAlloc(OS_LinuxEntityKind_Fiber);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_fiberThreadExit(OS_Handle fiber) {
+  OS_linuxEntityRelease((OS_LinuxEntity*)fiber.u64[0]);
+}
+
+OS_Handle OS_fiberCreate(void* stack, u64 stackSize, OS_FiberFunction* func, void* params) {
+  OS_LinuxEntity* entity = OS_linuxEntityAlloc(OS_LinuxEntityKind_Fiber);
+  entity->fiber.func = func;
+  entity->fiber.params = params;
+
+  // Initial frame, popped by OS_linuxFiberSwitch from the bottom up
+  u64* top = (u64*)AlignDownPow2((u64)stack + stackSize, 16);
+  u64* frame = top - 9;
+  frame[0] = 0x1F80 | ((u64)0x037F << 32);    // MXCSR and x87 control word defaults
+  frame[1] = 0;                               // r15
+  frame[2] = 0;                               // r14
+  frame[3] = (u64)OS_linuxFiberEntryPoint;    // r13
+  frame[4] = (u64)entity;                     // r12
+  frame[5] = 0;                               // rbx
+  frame[6] = 0;                               // rbp
+  frame[7] = (u64)OS_linuxFiberTrampoline;    // return address
+  frame[8] = 0;                               // fake return address of the trampoline, ends stack walks
+  entity->fiber.stackPointer = frame;
+
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_fiberRelease(OS_Handle fiber) {
+  OS_linuxEntityRelease((OS_LinuxEntity*)fiber.u64[0]);
+}
+
+void OS_fiberSwitch(OS_Handle from, OS_Handle to) {
+  auto* fromEntity = (OS_LinuxEntity*)from.u64[0];
+  auto* toEntity = (OS_LinuxEntity*)to.u64[0];
+  OS_linuxFiberSwitch(&fromEntity->fiber.stackPointer, toEntity->fiber.stackPointer);
+}
+
+void OS_futexWait(u32* address, u32 expected) {
+  syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+void OS_futexWakeOne(u32* address) {
+  syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+void OS_futexWakeAll(u32* address) {
+  syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, i32Max, nullptr, nullptr, 0);
+}
+
+// Files
+
+// NOTE(piero): File handles hold the descriptor plus one, so a zeroed handle is never a valid descriptor 0
+static int OS_linuxFileDescriptor(OS_Handle file) {
+  return (int)file.u64[0] - 1;
+}
+
+OS_Handle OS_fileOpen(String8 path, OS_FileFlags flags) {
+  Temp scratch = ScratchBegin();
+  String8 cpath = PushStr8Copy(scratch.arena, path);
+  int openFlags = O_RDONLY | O_CLOEXEC;
+  if (flags & OS_FileFlag_Unbuffered) {
+    openFlags |= O_DIRECT;
+  }
+  int fd = open((char*)cpath.str, openFlags);
+  ScratchEnd(scratch);
+
+  OS_Handle result = {};
+  if (fd >= 0) {
+    result.u64[0] = (u64)fd + 1;
+  }
+  return result;
+}
+
+b32 OS_fileIsValid(OS_Handle file) {
+  return file.u64[0] != 0;
+}
+
+void OS_fileClose(OS_Handle file) {
+  close(OS_linuxFileDescriptor(file));
+}
+
+u64 OS_fileSize(OS_Handle file) {
+  struct stat info;
+  if (fstat(OS_linuxFileDescriptor(file), &info) != 0) {
+    return 0;
+  }
+  return (u64)info.st_size;
+}
+
+u64 OS_fileRead(OS_Handle file, u64 offset, void* dst, u64 size) {
+  u64 total = 0;
+  while (total < size) {
+    ssize_t bytes = pread(OS_linuxFileDescriptor(file), (u8*)dst + total, size - total, (off_t)(offset + total));
+    if (bytes <= 0) {
+      break;
+    }
+    total += (u64)bytes;
+  }
+  return total;
+}
+
+// Memory mapped files
+
+String8 OS_fileMap(String8 path, OS_FileMapMode mode, OS_FileMapHints hints, u64 maxSize) {
+  String8 result = {};
+  OS_Handle file = OS_fileOpen(path, OS_FileFlag_Read);
+  if (!OS_fileIsValid(file)) {
+    return result;
+  }
+
+  u64 size = OS_fileSize(file);
+  if (maxSize != 0) {
+    size = Min(size, maxSize);
+  }
+  if (size != 0) {
+    int protection = mode == OS_FileMapMode_CopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    int flags = mode == OS_FileMapMode_CopyOnWrite ? MAP_PRIVATE : MAP_SHARED;
+    void* ptr = mmap(nullptr, size, protection, flags, OS_linuxFileDescriptor(file), 0);
+    if (ptr != MAP_FAILED) {
+      result = Str8((u8*)ptr, size);
+    }
+  }
+  // The mapping keeps its own reference to the file
+  OS_fileClose(file);
+
+  if (result.size != 0 && hints != 0) {
+    OS_fileMapAdvise(result, hints);
+  }
+  return result;
+}
+
+void OS_fileUnmap(String8 mapped) {
+  if (mapped.size != 0) {
+    munmap(mapped.str, mapped.size);
+  }
+}
+
+void OS_fileMapAdvise(String8 range, OS_FileMapHints hints) {
+  u64 pageSize = OS_pageSize();
+  u8* first = (u8*)AlignDownPow2((u64)range.str, pageSize);
+  u64 size = (u64)(range.str + range.size - first);
+  if (hints & OS_FileMapHint_Sequential) {
+    madvise(first, size, MADV_SEQUENTIAL);
+  }
+  if (hints & OS_FileMapHint_Random) {
+    madvise(first, size, MADV_RANDOM);
+  }
+  if (hints & OS_FileMapHint_HugePages) {
+    madvise(first, size, MADV_HUGEPAGE);
+  }
+  if (hints & OS_FileMapHint_WillNeed) {
+    madvise(first, size, MADV_WILLNEED);
+  }
+}
+
+void OS_fileMapPrefetch(String8 range) {
+  OS_fileMapAdvise(range, OS_FileMapHint_WillNeed);
+}
+
+// Async file I/O
+// NOTE(piero): Raw io_uring without liburing: setup, three shared mappings (submission ring, completion ring, sqe
+//              array) and io_uring_enter to submit and to wait. IORING_OP_READ needs kernel 5.6, older kernels
+//              fail every read with -EINVAL and get the pread path instead. 5.6 is also the first to report
+//              IORING_FEAT_RW_CUR_POS, which stands in for a probe.
+
+#define OS_LINUX_IOPRIO_CLASS_BE 2
+#define OS_LINUX_IOPRIO_CLASS_SHIFT 13
+
+static u16 osLinuxIoPriorities[OS_IoPriority_COUNT] = {
+  (OS_LINUX_IOPRIO_CLASS_BE << OS_LINUX_IOPRIO_CLASS_SHIFT) | 0,
+  (OS_LINUX_IOPRIO_CLASS_BE << OS_LINUX_IOPRIO_CLASS_SHIFT) | 4,
+  (OS_LINUX_IOPRIO_CLASS_BE << OS_LINUX_IOPRIO_CLASS_SHIFT) | 7,
+};
+
+static b32 OS_linuxIoRingInit(OS_LinuxEntity* entity, u32 depth) {
+  io_uring_params params = {};
+  int fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+  if (fd < 0) {
+    return false;
+  }
+  if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+    close(fd);
+    return false;
+  }
+
+  auto& queue = entity->ioQueue;
+  queue.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+  queue.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  b32 singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMmap) {
+    queue.sqRingSize = Max(queue.sqRingSize, queue.cqRingSize);
+    queue.cqRingSize = queue.sqRingSize;
+  }
+
+  queue.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+  // Only stored once all three are mapped, a failed init leaves the entity without rings
+  void* sqRing = mmap(nullptr, queue.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sqRing == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  void* cqRing = sqRing;
+  if (!singleMmap) {
+    cqRing = mmap(nullptr, queue.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED) {
+      munmap(sqRing, queue.sqRingSize);
+      close(fd);
+      return false;
+    }
+  }
+  void* sqes = mmap(nullptr, queue.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    if (cqRing != sqRing) {
+      munmap(cqRing, queue.cqRingSize);
+    }
+    munmap(sqRing, queue.sqRingSize);
+    close(fd);
+    return false;
+  }
+  queue.sqRing = sqRing;
+  queue.cqRing = cqRing;
+  queue.sqes = (io_uring_sqe*)sqes;
+
+  u8* sq = (u8*)queue.sqRing;
+  queue.sqTail = (u32*)(sq + params.sq_off.tail);
+  queue.sqArray = (u32*)(sq + params.sq_off.array);
+  queue.sqMask = *(u32*)(sq + params.sq_off.ring_mask);
+  u8* cq = (u8*)queue.cqRing;
+  queue.cqHead = (u32*)(cq + params.cq_off.head);
+  queue.cqTail = (u32*)(cq + params.cq_off.tail);
+  queue.cqMask = *(u32*)(cq + params.cq_off.ring_mask);
+  queue.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+  queue.ringFd = fd;
+  // The completion ring is twice the submission ring, depth in flight can never overflow it
+  queue.depth = Min(depth, params.sq_entries);
+  return true;
+}
+
+OS_Handle OS_ioQueueAlloc(u32 depth) {
+  OS_LinuxEntity* entity = OS_linuxEntityAlloc(OS_LinuxEntityKind_IoQueue);
+  entity->ioQueue.ringFd = -1;
+  entity->ioQueue.depth = depth;
+  OS_linuxIoRingInit(entity, depth);
+  return { (u64)entity };
+}
+
+void OS_ioQueueRelease(OS_Handle queue) {
+  auto* entity = (OS_LinuxEntity*)queue.u64[0];
+  OS_IoRead* completed[64];
+  while (entity->ioQueue.inFlight != 0) {
+    OS_ioComplete(queue, completed, ArrayCount(completed), true);
+  }
+
+  auto& ring = entity->ioQueue;
+  if (ring.ringFd >= 0) {
+    munmap(ring.sqes, ring.sqesSize);
+    if (ring.cqRing != ring.sqRing) {
+      munmap(ring.cqRing, ring.cqRingSize);
+    }
+    munmap(ring.sqRing, ring.sqRingSize);
+    close(ring.ringFd);
+  }
+  OS_linuxEntityRelease(entity);
+}
+
+void OS_ioQueueRead(OS_Handle queue, OS_IoRead* read) {
+  auto* entity = (OS_LinuxEntity*)queue.u64[0];
+  Assert(read->size <= OS_IO_MAX_READ_SIZE);
+  read->next = nullptr;
+  QueuePush(entity->ioQueue.pendingFirst[read->priority], entity->ioQueue.pendingLast[read->priority], read);
+}
+
+static OS_IoRead* OS_linuxIoPopPending(OS_LinuxEntity* entity) {
+  auto& queue = entity->ioQueue;
+  for (u32 priority = 0; priority < OS_IoPriority_COUNT; ++priority) {
+    OS_IoRead* read = queue.pendingFirst[priority];
+    if (read) {
+      QueuePop(queue.pendingFirst[priority], queue.pendingLast[priority]);
+      return read;
+    }
+  }
+  return nullptr;
+}
+
+// NOTE(piero): io_uring_enter may take fewer sqes than asked, or none when it's interrupted or out of resources.
+//              What it didn't take stays in the ring and goes with the next submit or wait. Any other error means
+//              the kernel won't ever take them, so the tail moves back over them and they complete with the error.
+static void OS_linuxIoEnter(OS_LinuxEntity* entity, u32 minComplete, u32 flags) {
+  auto& queue = entity->ioQueue;
+  for (;;) {
+    int result = (int)syscall(__NR_io_uring_enter, queue.ringFd, queue.unsubmitted, minComplete, flags, nullptr, 0);
+    if (result > 0) {
+      queue.unsubmitted -= Min((u32)result, queue.unsubmitted);
+      if (queue.unsubmitted != 0) {
+        continue;
+      }
+      return;
+    }
+    if (result == 0) {
+      return;
+    }
+
+    int error = errno;
+    if (error == EINTR) {
+      continue;
+    }
+    if (error == EAGAIN || error == EBUSY) {
+      return;
+    }
+
+    u32 tail = *queue.sqTail;
+    for (u32 i = queue.unsubmitted; i > 0; --i) {
+      auto* read = (OS_IoRead*)queue.sqes[(tail - i) & queue.sqMask].user_data;
+      read->result = -(i64)error;
+      StackPush(queue.completed, read);
+    }
+    AtomicStoreU32(queue.sqTail, tail - queue.unsubmitted);
+    queue.inFlight -= queue.unsubmitted;
+    queue.unsubmitted = 0;
+    return;
+  }
+}
+
+u32 OS_ioSubmit(OS_Handle handle) {
+  auto* entity = (OS_LinuxEntity*)handle.u64[0];
+  auto& queue = entity->ioQueue;
+
+  u32 count = 0;
+  if (queue.ringFd < 0) {
+    for (OS_IoRead* read = OS_linuxIoPopPending(entity); read != nullptr; read = OS_linuxIoPopPending(entity)) {
+      ssize_t bytes = pread(OS_linuxFileDescriptor(read->file), read->dst, read->size, (off_t)read->offset);
+      read->result = bytes >= 0 ? (i64)bytes : -(i64)errno;
+      StackPush(queue.completed, read);
+      count += 1;
+    }
+    return count;
+  }
+
+  u32 tail = *queue.sqTail;
+  while (queue.inFlight < queue.depth) {
+    OS_IoRead* read = OS_linuxIoPopPending(entity);
+    if (read == nullptr) {
+      break;
+    }
+
+    u32 index = tail & queue.sqMask;
+    io_uring_sqe* sqe = &queue.sqes[index];
+    MemoryZeroStruct(sqe);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = OS_linuxFileDescriptor(read->file);
+    sqe->off = read->offset;
+    sqe->addr = (u64)read->dst;
+    sqe->len = (u32)read->size;
+    sqe->ioprio = osLinuxIoPriorities[read->priority];
+    sqe->user_data = (u64)read;
+    queue.sqArray[index] = index;
+
+    tail += 1;
+    queue.inFlight += 1;
+    count += 1;
+  }
+
+  if (count != 0) {
+    // The kernel reads the tail with acquire, the sqes must be visible before it moves
+    AtomicStoreU32(queue.sqTail, tail);
+    queue.unsubmitted += count;
+  }
+  if (queue.unsubmitted != 0) {
+    OS_linuxIoEnter(entity, 0, 0);
+  }
+  return count;
+}
+
+u32 OS_ioComplete(OS_Handle handle, OS_IoRead** completed, u32 maxCount, b32 wait) {
+  auto* entity = (OS_LinuxEntity*)handle.u64[0];
+  auto& queue = entity->ioQueue;
+
+  u32 count = 0;
+  for (;;) {
+    while (queue.completed && count < maxCount) {
+      completed[count++] = queue.completed;
+      StackPop(queue.completed);
+    }
+    if (queue.ringFd < 0) {
+      return count;
+    }
+
+    u32 head = *queue.cqHead;
+    u32 tail = AtomicLoadU32(queue.cqTail);
+    while (head != tail && count < maxCount) {
+      io_uring_cqe* cqe = &queue.cqes[head & queue.cqMask];
+      auto* read = (OS_IoRead*)cqe->user_data;
+      read->result = cqe->res;
+      completed[count++] = read;
+      head += 1;
+      queue.inFlight -= 1;
+    }
+    AtomicStoreU32(queue.cqHead, head);
+
+    if (count != 0 || !wait || queue.inFlight == 0) {
+      return count;
+    }
+    OS_linuxIoEnter(entity, 1, IORING_ENTER_GETEVENTS);
+  }
+}
+
 static u64 OS_getOSTimerFreq() {
   return 1000000;
 }
@@ -58,9 +1156,11 @@ void OS_init() {
 
 int main(int argc, char** argv) {
   ThreadCtx tCtx = ThreadCtx_alloc();
+  tCtx.isMainThread = true;
   ThreadCtx_set(&tCtx);
+  ThreadCtx_setName(Str8L("Main Thread"));
 
-  mainEntryPoint(__argc, __argv);
+  mainEntryPoint(argc, argv);
 
   ThreadCtx_set(&tCtx);
   ThreadCtx_release();
@@ -9,6 +9,102 @@
 #define NOMINMAX
 #include <windows.h>
 
+// NOTE(piero): WaitOnAddress and friends live in Synchronization.lib
+#pragma comment(lib, "Synchronization.lib")
+
+enum OS_Win32EntityKind {
+  OS_Win32EntityKind_Null,
+  OS_Win32EntityKind_Thread,
+  OS_Win32EntityKind_Mutex,
+  OS_Win32EntityKind_RWLock,
+  OS_Win32EntityKind_CondVar,
+  OS_Win32EntityKind_Fiber,
+  OS_Win32EntityKind_IoQueue,
+  OS_Win32EntityKind_File,
+};
+
+// One per read in flight, the completion port hands the OVERLAPPED back
+struct OS_Win32IoSlot {
+  OVERLAPPED overlapped;
+  OS_IoRead* read;
+  OS_Win32IoSlot* next;
+};
+
+// NOTE(piero): Backing storage for OS handles that need a stable address: threads keep their entry point and
+//              params until they start, SRW locks and condition variables must not move once used.
+struct OS_Win32Entity {
+  OS_Win32Entity* next;
+  OS_Win32EntityKind kind;
+  union {
+    struct {
+      HANDLE handle;
+      OS_ThreadFunction* func;
+      void* params;
+      u64 affinityMask;
+      OS_ThreadPriority priority;
+      u8 name[64];
+      u64 nameSize;
+      // Held by the thread itself and by whoever joins or detaches it, the last one out frees the entity
+      u32 refCount;
+    } thread;
+    SRWLOCK srwLock;
+    CONDITION_VARIABLE condVar;
+    struct {
+      LPVOID handle;
+      OS_FiberFunction* func;
+      void* params;
+    } fiber;
+    struct {
+      HANDLE port;
+      u32 depth;
+      u32 inFlight;
+      OS_Win32IoSlot* slots;
+      OS_Win32IoSlot* freeSlots;
+
+      // FIFO per priority
+      OS_IoRead* pendingFirst[OS_IoPriority_COUNT];
+      OS_IoRead* pendingLast[OS_IoPriority_COUNT];
+      // Reads that failed to start
+      OS_IoRead* completed;
+    } ioQueue;
+    struct {
+      HANDLE handle;
+      // Completion port of the I/O queue the file was first submitted to. A handle can only ever be bound to one.
+      HANDLE port;
+    } file;
+  };
+};
+
+static OS_Win32Entity osWin32Entities[1024];
+static OS_Win32Entity* osWin32EntityFree;
+static u64 osWin32EntityCount;
+static SRWLOCK osWin32EntityLock = SRWLOCK_INIT;
+
+static OS_Win32Entity* OS_win32EntityAlloc(OS_Win32EntityKind kind) {
+  AcquireSRWLockExclusive(&osWin32EntityLock);
+  OS_Win32Entity* entity = osWin32EntityFree;
+  if (entity != nullptr) {
+    StackPop(osWin32EntityFree);
+  } else if (osWin32EntityCount < ArrayCount(osWin32Entities)) {
+    entity = &osWin32Entities[osWin32EntityCount++];
+  }
+  ReleaseSRWLockExclusive(&osWin32EntityLock);
+
+  if (entity == nullptr) {
+    OS_abort();
+  }
+  MemoryZeroStruct(entity);
+  entity->kind = kind;
+  return entity;
+}
+
+static void OS_win32EntityRelease(OS_Win32Entity* entity) {
+  entity->kind = OS_Win32EntityKind_Null;
+  AcquireSRWLockExclusive(&osWin32EntityLock);
+  StackPush(osWin32EntityFree, entity);
+  ReleaseSRWLockExclusive(&osWin32EntityLock);
+}
+
 u64 OS_pageSize() {
   SYSTEM_INFO info;
   GetSystemInfo(&info);
@@ -16,15 +112,13 @@ u64 OS_pageSize() {
 }
 
 void* OS_reserve(u64 size) {
-  u64 gbSize = size;
-  gbSize += Gigabytes(1) - 1;
-  gbSize -= gbSize % Gigabytes(1);
-  void* ptr = VirtualAlloc(nullptr, gbSize, MEM_RESERVE, PAGE_NOACCESS);
+  void* ptr = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
   return ptr;
 }
 
 void OS_release(void* ptr, u64 size) {
-  VirtualFree(ptr, size, MEM_RELEASE);
+  // NOTE(piero): MEM_RELEASE requires a size of 0 and frees the whole reservation
+  VirtualFree(ptr, 0, MEM_RELEASE);
 }
 
 void OS_commit(void* ptr, u64 size) {
@@ -38,10 +132,740 @@ void OS_decommit(void* ptr, u64 size) {
   VirtualFree(ptr, size, MEM_DECOMMIT);
 }
 
+u64 OS_largePageSize() {
+  return GetLargePageMinimum();
+}
+
+// NOTE(piero): Large pages need SeLockMemoryPrivilege to be granted to the user and enabled on the process token.
+static b32 win32EnableLargePages() {
+  static b32 tried = false;
+  static b32 enabled = false;
+  if (!tried) {
+    tried = true;
+    HANDLE token = nullptr;
+    if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+      TOKEN_PRIVILEGES privileges = {};
+      if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)) {
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr);
+        enabled = (GetLastError() == ERROR_SUCCESS);
+      }
+      CloseHandle(token);
+    }
+  }
+  return enabled;
+}
+
+void* OS_reserveLarge(u64 size) {
+  void* ptr = nullptr;
+  u64 largePageSize = OS_largePageSize();
+  if (largePageSize != 0 && win32EnableLargePages()) {
+    u64 alignedSize = AlignPow2(size, largePageSize);
+    ptr = VirtualAlloc(nullptr, alignedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+  }
+  return ptr;
+}
+
+b32 OS_adviseHugePages(void* ptr, u64 size) {
+  return false;
+}
+
+u64 OS_allocationGranularity() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+}
+
+void* OS_ringAlloc(u64 size, OS_Handle* handle) {
+  HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), nullptr);
+  if (mapping == nullptr) {
+    return nullptr;
+  }
+
+  // NOTE(piero): Find a free range big enough for both views, then map into it. Another thread can grab
+  //              the range between VirtualFree and MapViewOfFileEx, so retry a few times.
+  u8* result = nullptr;
+  for (u32 attempt = 0; attempt < 16 && result == nullptr; ++attempt) {
+    u8* base = (u8*)VirtualAlloc(nullptr, size * 2, MEM_RESERVE, PAGE_NOACCESS);
+    if (base == nullptr) {
+      break;
+    }
+    VirtualFree(base, 0, MEM_RELEASE);
+
+    void* first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, base);
+    void* second = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, base + size);
+    if (first == base && second == base + size) {
+      result = base;
+    } else {
+      if (first != nullptr) {
+        UnmapViewOfFile(first);
+      }
+      if (second != nullptr) {
+        UnmapViewOfFile(second);
+      }
+    }
+  }
+
+  if (result == nullptr) {
+    CloseHandle(mapping);
+    return nullptr;
+  }
+
+  handle->u64[0] = (u64)mapping;
+  return result;
+}
+
+void OS_ringRelease(void* base, u64 size, OS_Handle handle) {
+  UnmapViewOfFile(base);
+  UnmapViewOfFile((u8*)base + size);
+  CloseHandle((HANDLE)handle.u64[0]);
+}
+
+no_asan void OS_prefault(void* ptr, u64 size) {
+  u64 pageSize = OS_pageSize();
+  for (u64 offset = 0; offset < size; offset += pageSize) {
+    AtomicAddU32((u32*)((u8*)ptr + offset), 0);
+  }
+}
+
 void OS_abort() {
   ExitProcess(1);
 }
 
+static void OS_win32ThreadRelease(OS_Win32Entity* entity) {
+  if (AtomicAddU32(&entity->thread.refCount, (u32)-1) == 1) {
+    CloseHandle(entity->thread.handle);
+    OS_win32EntityRelease(entity);
+  }
+}
+
+static DWORD WINAPI OS_win32ThreadEntryPoint(LPVOID ptr) {
+  auto* entity = (OS_Win32Entity*)ptr;
+
+  if (entity->thread.priority != OS_ThreadPriority_Normal) {
+    OS_setThreadPriority(entity->thread.priority);
+  }
+  // Pins the thread first, so the context knows its core
+  ThreadCtx threadCtx = ThreadCtx_alloc(entity->thread.affinityMask);
+  ThreadCtx_set(&threadCtx);
+  if (entity->thread.nameSize) {
+    ThreadCtx_setName(Str8(entity->thread.name, entity->thread.nameSize));
+  }
+
+  entity->thread.func(entity->thread.params);
+
+  ThreadCtx_release();
+  OS_win32ThreadRelease(entity);
+  return 0;
+}
+
+OS_Handle OS_threadLaunch(OS_ThreadFunction* func, void* params, OS_ThreadParams threadParams) {
+  OS_Win32Entity* entity = OS_win32EntityAlloc(OS_Win32EntityKind_Thread);
+  entity->thread.func = func;
+  entity->thread.params = params;
+  entity->thread.affinityMask = threadParams.affinityMask;
+  entity->thread.priority = threadParams.priority;
+  entity->thread.nameSize = Min(threadParams.name.size, sizeof(entity->thread.name));
+  MemoryCopy(entity->thread.name, threadParams.name.str, entity->thread.nameSize);
+  entity->thread.refCount = 2;
+
+  // NOTE(piero): Start suspended so handle is stored before the thread can drop its reference
+  entity->thread.handle = CreateThread(nullptr, threadParams.stackSize, OS_win32ThreadEntryPoint, entity, CREATE_SUSPENDED | STACK_SIZE_PARAM_IS_A_RESERVATION, nullptr);
+  if (entity->thread.handle == nullptr) {
+    OS_win32EntityRelease(entity);
+    entity = nullptr;
+  } else {
+    ResumeThread(entity->thread.handle);
+  }
+
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_threadJoin(OS_Handle handle) {
+  auto* entity = (OS_Win32Entity*)handle.u64[0];
+  if (entity != nullptr) {
+    WaitForSingleObject(entity->thread.handle, INFINITE);
+    OS_win32ThreadRelease(entity);
+  }
+}
+
+void OS_threadDetach(OS_Handle handle) {
+  auto* entity = (OS_Win32Entity*)handle.u64[0];
+  if (entity != nullptr) {
+    OS_win32ThreadRelease(entity);
+  }
+}
+
+void OS_setThreadName(String8 name) {
+  WCHAR buffer[64];
+  i32 length = MultiByteToWideChar(CP_UTF8, 0, (char*)name.str, (i32)Min(name.size, (u64)ArrayCount(buffer) - 1), buffer, ArrayCount(buffer) - 1);
+  buffer[length] = 0;
+  SetThreadDescription(GetCurrentThread(), buffer);
+}
+
+b32 OS_setThreadAffinity(u64 affinityMask) {
+  return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)affinityMask) != 0;
+}
+
+b32 OS_setThreadPriority(OS_ThreadPriority priority) {
+  int value = THREAD_PRIORITY_NORMAL;
+  if (priority == OS_ThreadPriority_High) {
+    value = THREAD_PRIORITY_ABOVE_NORMAL;
+  } else if (priority == OS_ThreadPriority_Low) {
+    value = THREAD_PRIORITY_BELOW_NORMAL;
+  }
+  return SetThreadPriority(GetCurrentThread(), value) != 0;
+}
+
+u32 OS_threadId() {
+  return GetCurrentThreadId();
+}
+
+u32 OS_currentProcessor() {
+  return GetCurrentProcessorNumber();
+}
+
+void OS_threadYield() {
+  SwitchToThread();
+}
+
+void OS_sleepMilliseconds(u32 milliseconds) {
+  Sleep(milliseconds);
+}
+
+u32 OS_logicalProcessorCount() {
+  return GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+}
+
+// CPU topology
+// NOTE(piero): Cores come first in the buffer on every Windows version we run on, but nothing promises it, so
+//              cores are collected in one pass and packages, NUMA nodes and caches matched against them in a second.
+//              EfficiencyClass is 0 everywhere on non-hybrid parts, higher is faster.
+
+static void OS_detectCpuTopology(OS_CpuTopology* topology) {
+  DWORD size = 0;
+  GetLogicalProcessorInformationEx(RelationAll, nullptr, &size);
+  auto* buffer = (u8*)VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (buffer == nullptr) {
+    return;
+  }
+  if (!GetLogicalProcessorInformationEx(RelationAll, (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)buffer, &size)) {
+    VirtualFree(buffer, 0, MEM_RELEASE);
+    return;
+  }
+
+  BYTE maxEfficiencyClass = 0;
+  BYTE coreEfficiencyClass[OS_CPU_MAX_PROCESSORS] = {};
+  for (DWORD offset = 0; offset < size;) {
+    auto* info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer + offset);
+    offset += info->Size;
+    if (info->Relationship != RelationProcessorCore || info->Processor.GroupMask[0].Group != 0) {
+      continue;
+    }
+    u64 mask = (u64)info->Processor.GroupMask[0].Mask;
+    if (mask == 0 || topology->coreCount == OS_CPU_MAX_PROCESSORS) {
+      continue;
+    }
+
+    u32 coreIndex = topology->coreCount++;
+    topology->cores[coreIndex].processorMask = mask;
+    coreEfficiencyClass[coreIndex] = info->Processor.EfficiencyClass;
+    maxEfficiencyClass = Max(maxEfficiencyClass, info->Processor.EfficiencyClass);
+    for (u64 bits = mask; bits != 0; bits &= bits - 1) {
+      topology->processorCore[CountTrailingZeros64(bits)] = coreIndex;
+    }
+  }
+
+  for (u32 i = 0; i < topology->coreCount; ++i) {
+    if (coreEfficiencyClass[i] < maxEfficiencyClass) {
+      topology->cores[i].kind = OS_CoreKind_Efficiency;
+    }
+  }
+
+  u32 packageIndex = 0;
+  for (DWORD offset = 0; offset < size;) {
+    auto* info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer + offset);
+    offset += info->Size;
+
+    u64 mask = 0;
+    if (info->Relationship == RelationProcessorPackage && info->Processor.GroupMask[0].Group == 0) {
+      mask = (u64)info->Processor.GroupMask[0].Mask;
+    } else if (info->Relationship == RelationNumaNode && info->NumaNode.GroupMask.Group == 0) {
+      mask = (u64)info->NumaNode.GroupMask.Mask;
+    } else if (info->Relationship == RelationCache && info->Cache.GroupMask.Group == 0) {
+      mask = (u64)info->Cache.GroupMask.Mask;
+    }
+    if (mask == 0) {
+      continue;
+    }
+
+    for (u32 i = 0; i < topology->coreCount; ++i) {
+      OS_CpuCore* core = &topology->cores[i];
+      if ((core->processorMask & mask) == 0) {
+        continue;
+      }
+
+      if (info->Relationship == RelationProcessorPackage) {
+        core->package = packageIndex;
+      } else if (info->Relationship == RelationNumaNode) {
+        core->numaNode = info->NumaNode.NodeNumber;
+      } else {
+        CACHE_RELATIONSHIP* relation = &info->Cache;
+        OS_CpuCache* cache = nullptr;
+        if (relation->Level == 1 && relation->Type == CacheData) {
+          cache = &core->l1Data;
+        } else if (relation->Level == 1 && relation->Type == CacheInstruction) {
+          cache = &core->l1Instruction;
+        } else if (relation->Level == 2) {
+          cache = &core->l2;
+        } else if (relation->Level == 3) {
+          cache = &core->l3;
+        }
+        if (cache) {
+          cache->size = relation->CacheSize;
+          cache->lineSize = relation->LineSize;
+          cache->processorMask = mask;
+        }
+      }
+    }
+    if (info->Relationship == RelationProcessorPackage) {
+      packageIndex += 1;
+    }
+  }
+
+  VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+OS_Handle OS_semaphoreAlloc(u32 initialCount, u32 maxCount) {
+  HANDLE handle = CreateSemaphoreA(nullptr, initialCount, maxCount, nullptr);
+  OS_Handle result = { { (u64)handle } };
+  return result;
+}
+
+void OS_semaphoreRelease(OS_Handle semaphore) {
+  CloseHandle((HANDLE)semaphore.u64[0]);
+}
+
+void OS_semaphoreWait(OS_Handle semaphore) {
+  WaitForSingleObject((HANDLE)semaphore.u64[0], INFINITE);
+}
+
+void OS_semaphoreSignal(OS_Handle semaphore) {
+  ReleaseSemaphore((HANDLE)semaphore.u64[0], 1, nullptr);
+}
+
+OS_Handle OS_mutexAlloc() {
+  OS_Win32Entity* entity = OS_win32EntityAlloc(OS_Win32EntityKind_Mutex);
+  InitializeSRWLock(&entity->srwLock);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_mutexRelease(OS_Handle mutex) {
+  OS_win32EntityRelease((OS_Win32Entity*)mutex.u64[0]);
+}
+
+void OS_mutexLock(OS_Handle mutex) {
+  auto* entity = (OS_Win32Entity*)mutex.u64[0];
+  AcquireSRWLockExclusive(&entity->srwLock);
+}
+
+b32 OS_mutexTryLock(OS_Handle mutex) {
+  auto* entity = (OS_Win32Entity*)mutex.u64[0];
+  return TryAcquireSRWLockExclusive(&entity->srwLock) != 0;
+}
+
+void OS_mutexUnlock(OS_Handle mutex) {
+  auto* entity = (OS_Win32Entity*)mutex.u64[0];
+  ReleaseSRWLockExclusive(&entity->srwLock);
+}
+
+OS_Handle OS_rwLockAlloc() {
+  OS_Win32Entity* entity = OS_win32EntityAlloc(OS_Win32EntityKind_RWLock);
+  InitializeSRWLock(&entity->srwLock);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_rwLockRelease(OS_Handle lock) {
+  OS_win32EntityRelease((OS_Win32Entity*)lock.u64[0]);
+}
+
+void OS_rwLockReadLock(OS_Handle lock) {
+  auto* entity = (OS_Win32Entity*)lock.u64[0];
+  AcquireSRWLockShared(&entity->srwLock);
+}
+
+void OS_rwLockReadUnlock(OS_Handle lock) {
+  auto* entity = (OS_Win32Entity*)lock.u64[0];
+  ReleaseSRWLockShared(&entity->srwLock);
+}
+
+void OS_rwLockWriteLock(OS_Handle lock) {
+  auto* entity = (OS_Win32Entity*)lock.u64[0];
+  AcquireSRWLockExclusive(&entity->srwLock);
+}
+
+void OS_rwLockWriteUnlock(OS_Handle lock) {
+  auto* entity = (OS_Win32Entity*)lock.u64[0];
+  ReleaseSRWLockExclusive(&entity->srwLock);
+}
+
+OS_Handle OS_condVarAlloc() {
+  OS_Win32Entity* entity = OS_win32EntityAlloc(OS_Win32EntityKind_CondVar);
+  InitializeConditionVariable(&entity->condVar);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_condVarRelease(OS_Handle condVar) {
+  OS_win32EntityRelease((OS_Win32Entity*)condVar.u64[0]);
+}
+
+void OS_condVarWait(OS_Handle condVar, OS_Handle mutex) {
+  OS_condVarWaitTimeout(condVar, mutex, INFINITE);
+}
+
+b32 OS_condVarWaitTimeout(OS_Handle condVar, OS_Handle mutex, u32 milliseconds) {
+  auto* entity = (OS_Win32Entity*)condVar.u64[0];
+  auto* mutexEntity = (OS_Win32Entity*)mutex.u64[0];
+  return SleepConditionVariableSRW(&entity->condVar, &mutexEntity->srwLock, milliseconds, 0) != 0;
+}
+
+void OS_condVarSignal(OS_Handle condVar) {
+  auto* entity = (OS_Win32Entity*)condVar.u64[0];
+  WakeConditionVariable(&entity->condVar);
+}
+
+void OS_condVarBroadcast(OS_Handle condVar) {
+  auto* entity = (OS_Win32Entity*)condVar.u64[0];
+  WakeAllConditionVariable(&entity->condVar);
+}
+
+static VOID WINAPI OS_win32FiberEntryPoint(LPVOID ptr) {
+  auto* entity = (OS_Win32Entity*)ptr;
+  entity->fiber.func(entity->fiber.params);
+  // Returning from a fiber exits the thread
+  OS_abort();
+}
+
+OS_Handle OS_fiberThreadEnter() {
+  OS_Win32Entity* entity = OS_win32EntityAlloc(OS_Win32EntityKind_Fiber);
+  entity->fiber.handle = ConvertThreadToFiber(nullptr);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_fiberThreadExit(OS_Handle fiber) {
+  ConvertFiberToThread();
+  OS_win32EntityRelease((OS_Win32Entity*)fiber.u64[0]);
+}
+
+OS_Handle OS_fiberCreate(void* stack, u64 stackSize, OS_FiberFunction* func, void* params) {
+  OS_Win32Entity* entity = OS_win32EntityAlloc(OS_Win32EntityKind_Fiber);
+  entity->fiber.func = func;
+  entity->fiber.params = params;
+  entity->fiber.handle = CreateFiberEx(stackSize, stackSize, FIBER_FLAG_FLOAT_SWITCH, OS_win32FiberEntryPoint, entity);
+  OS_Handle result = { { (u64)entity } };
+  return result;
+}
+
+void OS_fiberRelease(OS_Handle fiber) {
+  auto* entity = (OS_Win32Entity*)fiber.u64[0];
+  DeleteFiber(entity->fiber.handle);
+  OS_win32EntityRelease(entity);
+}
+
+void OS_fiberSwitch(OS_Handle from, OS_Handle to) {
+  auto* entity = (OS_Win32Entity*)to.u64[0];
+  SwitchToFiber(entity->fiber.handle);
+}
+
+void OS_futexWait(u32* address, u32 expected) {
+  WaitOnAddress(address, &expected, sizeof(expected), INFINITE);
+}
+
+void OS_futexWakeOne(u32* address) {
+  WakeByAddressSingle(address);
+}
+
+void OS_futexWakeAll(u32* address) {
+  WakeByAddressAll(address);
+}
+
+// Files
+// NOTE(piero): Files are always opened overlapped so the async queue can use them. Blocking reads wait on an event
+//              with the low bit set, which keeps their completion off any completion port the file is bound to.
+//              File handles are entities so they can remember that port.
+
+static HANDLE OS_win32FileHandle(OS_Handle file) {
+  return ((OS_Win32Entity*)file.u64[0])->file.handle;
+}
+
+OS_Handle OS_fileOpen(String8 path, OS_FileFlags flags) {
+  Temp scratch = ScratchBegin();
+  String16 path16 = Str16From8(scratch.arena, path);
+  DWORD attributes = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED;
+  if (flags & OS_FileFlag_Unbuffered) {
+    attributes |= FILE_FLAG_NO_BUFFERING;
+  }
+  HANDLE file = CreateFileW((WCHAR*)path16.str, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, attributes, nullptr);
+  ScratchEnd(scratch);
+
+  OS_Handle result = {};
+  if (file != INVALID_HANDLE_VALUE) {
+    OS_Win32Entity* entity = OS_win32EntityAlloc(OS_Win32EntityKind_File);
+    entity->file.handle = file;
+    result.u64[0] = (u64)entity;
+  }
+  return result;
+}
+
+b32 OS_fileIsValid(OS_Handle file) {
+  return file.u64[0] != 0;
+}
+
+void OS_fileClose(OS_Handle file) {
+  auto* entity = (OS_Win32Entity*)file.u64[0];
+  CloseHandle(entity->file.handle);
+  OS_win32EntityRelease(entity);
+}
+
+u64 OS_fileSize(OS_Handle file) {
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(OS_win32FileHandle(file), &size)) {
+    return 0;
+  }
+  return (u64)size.QuadPart;
+}
+
+u64 OS_fileRead(OS_Handle file, u64 offset, void* dst, u64 size) {
+  HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  u64 total = 0;
+  while (total < size) {
+    OVERLAPPED overlapped = {};
+    u64 position = offset + total;
+    overlapped.Offset = (DWORD)position;
+    overlapped.OffsetHigh = (DWORD)(position >> 32);
+    overlapped.hEvent = (HANDLE)((ULONG_PTR)event | 1);
+
+    DWORD chunk = (DWORD)Min(size - total, (u64)OS_IO_MAX_READ_SIZE);
+    DWORD bytes = 0;
+    if (!ReadFile(OS_win32FileHandle(file), (u8*)dst + total, chunk, nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+      break;
+    }
+    if (!GetOverlappedResult(OS_win32FileHandle(file), &overlapped, &bytes, TRUE) || bytes == 0) {
+      break;
+    }
+    total += bytes;
+  }
+  CloseHandle(event);
+  return total;
+}
+
+// Memory mapped files
+
+String8 OS_fileMap(String8 path, OS_FileMapMode mode, OS_FileMapHints hints, u64 maxSize) {
+  String8 result = {};
+  Temp scratch = ScratchBegin();
+  String16 path16 = Str16From8(scratch.arena, path);
+  DWORD attributes = FILE_ATTRIBUTE_NORMAL;
+  if (hints & OS_FileMapHint_Sequential) {
+    attributes |= FILE_FLAG_SEQUENTIAL_SCAN;
+  }
+  if (hints & OS_FileMapHint_Random) {
+    attributes |= FILE_FLAG_RANDOM_ACCESS;
+  }
+  HANDLE file = CreateFileW((WCHAR*)path16.str, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, attributes, nullptr);
+  ScratchEnd(scratch);
+  if (file == INVALID_HANDLE_VALUE) {
+    return result;
+  }
+
+  LARGE_INTEGER fileSize;
+  u64 size = 0;
+  if (GetFileSizeEx(file, &fileSize)) {
+    size = maxSize != 0 ? Min((u64)fileSize.QuadPart, maxSize) : (u64)fileSize.QuadPart;
+  }
+  if (size != 0) {
+    DWORD protection = mode == OS_FileMapMode_CopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY;
+    DWORD access = mode == OS_FileMapMode_CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ;
+    HANDLE mapping = CreateFileMappingW(file, nullptr, protection, 0, 0, nullptr);
+    if (mapping) {
+      void* ptr = MapViewOfFile(mapping, access, 0, 0, (SIZE_T)size);
+      if (ptr) {
+        result = Str8((u8*)ptr, size);
+      }
+      // The view keeps the mapping and the file alive
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+
+  if (result.size != 0 && (hints & OS_FileMapHint_WillNeed)) {
+    OS_fileMapPrefetch(result);
+  }
+  return result;
+}
+
+void OS_fileUnmap(String8 mapped) {
+  if (mapped.size != 0) {
+    UnmapViewOfFile(mapped.str);
+  }
+}
+
+// Windows takes the access pattern when the file is opened (see OS_fileMap) and has no huge pages for file views,
+// so only WillNeed does anything here
+void OS_fileMapAdvise(String8 range, OS_FileMapHints hints) {
+  if (hints & OS_FileMapHint_WillNeed) {
+    OS_fileMapPrefetch(range);
+  }
+}
+
+void OS_fileMapPrefetch(String8 range) {
+  u64 pageSize = OS_pageSize();
+  u8* first = (u8*)AlignDownPow2((u64)range.str, pageSize);
+  WIN32_MEMORY_RANGE_ENTRY entry = { .VirtualAddress = first, .NumberOfBytes = (SIZE_T)(range.str + range.size - first) };
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+}
+
+// Async file I/O
+
+OS_Handle OS_ioQueueAlloc(u32 depth) {
+  OS_Win32Entity* entity = OS_win32EntityAlloc(OS_Win32EntityKind_IoQueue);
+  auto& queue = entity->ioQueue;
+  queue.port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+  queue.depth = depth;
+  queue.slots = (OS_Win32IoSlot*)VirtualAlloc(nullptr, sizeof(OS_Win32IoSlot) * depth, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  for (u32 i = 0; i < depth; ++i) {
+    StackPush(queue.freeSlots, &queue.slots[i]);
+  }
+  return { (u64)entity };
+}
+
+void OS_ioQueueRelease(OS_Handle handle) {
+  auto* entity = (OS_Win32Entity*)handle.u64[0];
+  OS_IoRead* completed[64];
+  while (entity->ioQueue.inFlight != 0) {
+    OS_ioComplete(handle, completed, ArrayCount(completed), true);
+  }
+
+  CloseHandle(entity->ioQueue.port);
+  VirtualFree(entity->ioQueue.slots, 0, MEM_RELEASE);
+  OS_win32EntityRelease(entity);
+}
+
+void OS_ioQueueRead(OS_Handle handle, OS_IoRead* read) {
+  auto* entity = (OS_Win32Entity*)handle.u64[0];
+  Assert(read->size <= OS_IO_MAX_READ_SIZE);
+  read->next = nullptr;
+  QueuePush(entity->ioQueue.pendingFirst[read->priority], entity->ioQueue.pendingLast[read->priority], read);
+}
+
+static OS_IoRead* OS_win32IoPopPending(OS_Win32Entity* entity) {
+  auto& queue = entity->ioQueue;
+  for (u32 priority = 0; priority < OS_IoPriority_COUNT; ++priority) {
+    OS_IoRead* read = queue.pendingFirst[priority];
+    if (read) {
+      QueuePop(queue.pendingFirst[priority], queue.pendingLast[priority]);
+      return read;
+    }
+  }
+  return nullptr;
+}
+
+// Windows has no per-read priority, only the order reads are started in follows it
+u32 OS_ioSubmit(OS_Handle handle) {
+  auto* entity = (OS_Win32Entity*)handle.u64[0];
+  auto& queue = entity->ioQueue;
+
+  u32 count = 0;
+  while (queue.freeSlots) {
+    OS_IoRead* read = OS_win32IoPopPending(entity);
+    if (read == nullptr) {
+      break;
+    }
+
+    // A handle stays bound to the first port it's associated with, and its completions go there for good. Bound
+    // once, on its first submit, and a file submitted to another queue fails instead of completing on the wrong one.
+    auto* fileEntity = (OS_Win32Entity*)read->file.u64[0];
+    HANDLE file = fileEntity->file.handle;
+    if (fileEntity->file.port == nullptr) {
+      if (CreateIoCompletionPort(file, queue.port, 0, 0) == nullptr) {
+        read->result = -(i64)GetLastError();
+        StackPush(queue.completed, read);
+        continue;
+      }
+      fileEntity->file.port = queue.port;
+    } else if (fileEntity->file.port != queue.port) {
+      Assert(!"File already bound to another I/O queue");
+      read->result = -(i64)ERROR_INVALID_PARAMETER;
+      StackPush(queue.completed, read);
+      continue;
+    }
+
+    OS_Win32IoSlot* slot = queue.freeSlots;
+    StackPop(queue.freeSlots);
+    MemoryZeroStruct(&slot->overlapped);
+    slot->overlapped.Offset = (DWORD)read->offset;
+    slot->overlapped.OffsetHigh = (DWORD)(read->offset >> 32);
+    slot->read = read;
+
+    if (!ReadFile(file, read->dst, (DWORD)read->size, nullptr, &slot->overlapped) && GetLastError() != ERROR_IO_PENDING) {
+      // Reading past the end fails right away instead of completing with 0 bytes
+      read->result = GetLastError() == ERROR_HANDLE_EOF ? 0 : -(i64)GetLastError();
+      StackPush(queue.completed, read);
+      StackPush(queue.freeSlots, slot);
+      continue;
+    }
+    queue.inFlight += 1;
+    count += 1;
+  }
+  return count;
+}
+
+#define OS_WIN32_STATUS_END_OF_FILE 0xC0000011
+
+u32 OS_ioComplete(OS_Handle handle, OS_IoRead** completed, u32 maxCount, b32 wait) {
+  auto* entity = (OS_Win32Entity*)handle.u64[0];
+  auto& queue = entity->ioQueue;
+
+  u32 count = 0;
+  while (queue.completed && count < maxCount) {
+    completed[count++] = queue.completed;
+    StackPop(queue.completed);
+  }
+  if (count == maxCount || queue.inFlight == 0) {
+    return count;
+  }
+
+  OVERLAPPED_ENTRY entries[64];
+  ULONG removed = 0;
+  ULONG entryCount = (ULONG)Min(maxCount - count, (u32)ArrayCount(entries));
+  DWORD timeout = wait && count == 0 ? INFINITE : 0;
+  if (!GetQueuedCompletionStatusEx(queue.port, entries, entryCount, &removed, timeout, FALSE)) {
+    return count;
+  }
+
+  for (ULONG i = 0; i < removed; ++i) {
+    auto* slot = (OS_Win32IoSlot*)entries[i].lpOverlapped;
+    OS_IoRead* read = slot->read;
+    // Internal holds the NTSTATUS of the read
+    u64 status = (u64)slot->overlapped.Internal;
+    if (status == 0 || status == OS_WIN32_STATUS_END_OF_FILE) {
+      read->result = (i64)entries[i].dwNumberOfBytesTransferred;
+    } else {
+      read->result = -(i64)status;
+    }
+    completed[count++] = read;
+    StackPush(queue.freeSlots, slot);
+    queue.inFlight -= 1;
+  }
+  return count;
+}
+
 static u64 OS_getOSTimerFreq() {
   LARGE_INTEGER freq;
   QueryPerformanceFrequency(&freq);
@@ -60,7 +884,9 @@ void OS_init() {
 
 int wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nShowCmd) {
   ThreadCtx tCtx = ThreadCtx_alloc();
+  tCtx.isMainThread = true;
   ThreadCtx_set(&tCtx);
+  ThreadCtx_setName(Str8L("Main Thread"));
 
 #if DEBUG
   FILE* fp = nullptr;
@@ -43,3 +43,5 @@ void OS_windowPushCustomTitlebarClientArea(OSWindowHandle handle, Region2D rect)
 OS_Modifiers OS_getModifiers();
 OS_EventList OS_getEvents(Arena* arena);
 void OS_consumeEvent(OS_EventList* events, OS_Event* event);
+// Hands the remaining events of a list from OS_getEvents back to the event pool
+void OS_releaseEvents(OS_EventList* events);
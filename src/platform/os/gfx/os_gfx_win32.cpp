@@ -9,6 +9,7 @@
 #include "core/core.h"
 #include "core/math/core_math.h"
 #include "core/memory/arena.h"
+#include "core/memory/pool.h"
 #include "core/core_strings.h"
 #include "core/thread_context.h"
 #include "os_gfx.h"
@@ -26,6 +27,17 @@
 per_thread Win32GfxState* win32GfxState = nullptr;
 per_thread Arena* win32EventsArena = nullptr;
 per_thread OS_EventList* win32EventsList = nullptr;
+// Only set while OS_getEvents pumps messages, events outside of it go to the scratch fallback
+per_thread Pool* win32EventsPool = nullptr;
+
+static OS_Event* win32PushEvent() {
+  if (win32EventsPool) {
+    OS_Event* event = PoolPushStruct(win32EventsPool, OS_Event);
+    event->pooled = true;
+    return event;
+  }
+  return PushStruct(win32EventsArena, OS_Event);
+}
 
 OSWindowHandle OS_handleFromWindow(Win32Window* window) {
   OSWindowHandle handle{};
@@ -57,7 +69,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
 
   switch (message) {
   case WM_CLOSE: {
-    event = PushStruct(win32EventsArena, OS_Event);
+    event = win32PushEvent();
     event->kind = OS_EventKind_WindowClose;
     event->window = windowHandle;
   } break;
@@ -68,7 +80,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
   } break;
 
   case WM_KILLFOCUS: {
-    event = PushStruct(win32EventsArena, OS_Event);
+    event = win32PushEvent();
     event->kind = OS_EventKind_WindowLoseFocus;
     event->window = windowHandle;
     win32GfxState->lastMousePosition = { 0.0, 0.0 };
@@ -85,7 +97,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
   case WM_MBUTTONDOWN:
   case WM_RBUTTONDOWN: {
     OS_EventKind kind = isRelease ? OS_EventKind_Release : OS_EventKind_Press;
-    event = PushStruct(win32EventsArena, OS_Event);
+    event = win32PushEvent();
     switch (message) {
     case WM_LBUTTONUP:
     case WM_LBUTTONDOWN:
@@ -112,7 +124,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
   } break;
   case WM_INPUT: {
     if (win32GfxState->mouseRelativeMode) {
-      event = PushStruct(win32EventsArena, OS_Event);
+      event = win32PushEvent();
       event->kind = OS_EventKind_MouseMove;
 
       UINT size = 0;
@@ -133,7 +145,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
     }
   } break;
   case WM_MOUSEMOVE: {
-    event = PushStruct(win32EventsArena, OS_Event);
+    event = win32PushEvent();
     event->kind = OS_EventKind_MouseMove;
 
     f32 x = (f32)GET_X_LPARAM(lParam);
@@ -169,7 +181,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
       p.y = (i32)(i16)HIWORD(lParam);
       ScreenToClient(window->hwnd, &p);
       i16 wheelDelta = HIWORD(wParam);
-      event = PushArray(win32EventsArena, OS_Event, 1);
+      event = win32PushEvent();
       event->kind = OS_EventKind_Scroll;
       event->window = windowHandle;
       if (scrollAxis == Axis2D_Y && wParam & MK_SHIFT) {
@@ -280,7 +292,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
       key = keyTable[wParam];
     }
 
-    event = PushArray(win32EventsArena, OS_Event, 1);
+    event = win32PushEvent();
     event->kind = kind;
     event->window = windowHandle;
     event->key = key;
@@ -289,7 +301,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
   case WM_SYSCOMMAND: {
     switch (wParam) {
     case SC_CLOSE: {
-      event = PushArray(win32EventsArena, OS_Event, 1);
+      event = win32PushEvent();
       event->kind = OS_EventKind_WindowClose;
       event->window = windowHandle;
     } break;
@@ -308,7 +320,7 @@ static LRESULT WINAPI OS_defaultWindowProc(HWND hwnd, UINT message, WPARAM wPara
       charInput = '\n';
     }
     if ((charInput >= 32 && charInput != 127) || charInput == '\t' || charInput == '\n') {
-      event = PushArray(win32EventsArena, OS_Event, 1);
+      event = win32PushEvent();
       event->kind = OS_EventKind_Text;
       event->window = windowHandle;
       event->character = charInput;
@@ -480,6 +492,7 @@ void OS_gfxInit() {
   win32GfxState = PushStruct(arena, Win32GfxState);
   win32GfxState->arena = arena;
   win32GfxState->windowArena = arenaAlloc(Gigabytes(1));
+  win32GfxState->eventPool = PoolCreateTyped(arena, OS_Event);
   win32GfxState->hInstance = GetModuleHandle(nullptr);
 
   // Register window class
@@ -739,12 +752,14 @@ OS_EventList OS_getEvents(Arena* arena) {
   OS_EventList list{};
   win32EventsArena = arena;
   win32EventsList = &list;
+  win32EventsPool = win32GfxState->eventPool;
   for (MSG message; PeekMessage(&message, nullptr, 0, 0, PM_REMOVE);) {
     TranslateMessage(&message);
     DispatchMessage(&message);
   }
   win32EventsArena = nullptr;
   win32EventsList = nullptr;
+  win32EventsPool = nullptr;
   return list;
 }
 
@@ -752,4 +767,23 @@ void OS_consumeEvent(OS_EventList* events, OS_Event* event) {
   DLLRemove(events->first, events->last, event);
   events->count -= 1;
   event->kind = OS_EventKind_Null;
+  // Cleared before the free, consuming it twice trips the assert too
+  Assert(event->pooled);
+  event->pooled = false;
+  poolFree(win32GfxState->eventPool, event);
+}
+
+void OS_releaseEvents(OS_EventList* events) {
+  Temp scratch = ScratchBegin();
+  void** nodes = PushArrayNoZero(scratch.arena, void*, events->count);
+  u64 count = 0;
+  for (OS_Event* event = events->first; event != nullptr; event = event->next) {
+    Assert(event->pooled);
+    event->pooled = false;
+    nodes[count++] = event;
+  }
+  poolFreeBatch(win32GfxState->eventPool, nodes, count);
+  ScratchEnd(scratch);
+
+  MemoryZeroStruct(events);
 }
@@ -3,6 +3,7 @@
 #include <windows.h>
 
 #include "core/memory/arena.h"
+#include "core/memory/pool.h"
 #include "os_gfx.h"
 
 struct Win32TitleBarClientArea {
@@ -42,6 +43,9 @@ struct Win32GfxState {
   Win32Window* firstWindow;
   Win32Window* lastWindow;
   Win32Window* freeWindow;
+
+  // Event nodes handed out by OS_getEvents, returned by OS_consumeEvent / OS_releaseEvents
+  Pool* eventPool;
 };
 
 OSWindowHandle OS_handleFromWindow(Win32Window* window);
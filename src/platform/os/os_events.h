@@ -41,6 +41,8 @@ struct OS_Event {
   vec2i32 rawPosition;
   vec2 scroll;
   String8 path;
+  // Came from the platform's event pool, only those may go back to it
+  b32 pooled;
 };
 
 struct OS_EventList {
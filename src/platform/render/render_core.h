@@ -1,19 +1,84 @@
 #pragma once
 
+#include "core/config.h"
 #include "core/math/core_math.h"
+#include "core/memory/arena.h"
+#include "core/data_structures/array.h"
+#include "core/data_structures/slot_map.h"
 #include "platform/os/core/os_core.h"
 
+struct RenderMesh;
+using RenderMeshHandle = Handle<RenderMesh>;
+
+// Frame packets
+// NOTE(piero): The game thread describes each window's frame as a packet (camera matrices and what to draw) between
+//              Render_startWindow and Render_endWindow. Once handed over a packet is never written again, the render
+//              thread records and submits it while the game thread already builds the next one. Packets go through
+//              a bounded queue, the game thread can be at most queueDepth packets ahead and waits in
+//              Render_startWindow for a free one after that, so queueDepth is also the added latency in frames.
+//              Before Render_startThread, and after Render_stopThread, Render_endWindow records the packet inline.
+
+struct RenderDraw {
+  RenderMeshHandle mesh;
+  mat4 transform;
+};
+
+struct RenderFramePacket {
+  // Owns everything the packet points to, cleared when the game thread takes the packet again
+  Arena* arena;
+  u64 frameIndex;
+
+  OSWindowHandle window;
+  vec2 windowSize;
+  mat4 viewMatrix;
+  mat4 projectionMatrix;
+  Array<RenderDraw> draws;
+
+  // OS timer ticks
+  u64 buildStartTime;
+  u64 submitTime;
+};
+
+// Milliseconds, over every frame since Render_init
+struct RenderFrameStats {
+  u64 frameCount;
+  u32 queueDepth;
+  // Render_startWindow to the frame's GPU submission
+  f64 lastLatency;
+  f64 averageLatency;
+  f64 maxLatency;
+  // Game thread waiting for a free packet, the render thread is the bottleneck when this grows
+  f64 averageGameWait;
+  // Packet waiting in the queue before the render thread took it
+  f64 averageQueueWait;
+  // Render thread recording and submitting
+  f64 averageRecord;
+};
+
 void Render_init();
 void Render_equipWindow(OSWindowHandle windowHandle);
-void Render_update();
 
+// queueDepth is at least 1, where the game thread builds frame N + 1 while frame N is recorded
+void Render_startThread(u32 queueDepth = RENDER_FRAME_QUEUE_DEPTH);
+// Records every queued packet, then waits for the GPU to go idle
+void Render_stopThread();
+RenderFrameStats Render_frameStats();
+
+// Begins the window's packet, waits while queueDepth packets are already queued
 void Render_startWindow(OSWindowHandle windowHandle, vec2 size);
+void Render_drawMesh(RenderMeshHandle mesh, mat4 transform);
+// Hands the packet to the render thread
 void Render_endWindow(OSWindowHandle windowHandle);
 
-void Render_loadScene(String8 path);
+// Not while the render thread runs
+RenderMeshHandle Render_loadScene(String8 path);
+
+// Arena for the frame being recorded, only for the thread recording it. Reset automatically once the GPU is done with that frame.
+Arena* Render_frameArena();
 
 // TODO(piero): I don't know how I feel with this API.
 //              Maybe we should just store these as part of a window. How to handle rendering UI (orthographic) + 3D (normally perspective)? Store 2 sets?
 //              Or the UI projection is a hardcoded orthographic projection from 0 -> windowWidth, 0 -> windowHeight
+// Set on the packet being built
 void Render_setViewMatrix(vec3 cameraPosition, f32 pitch, f32 yaw);
 void Render_setProjectionMatrix(f32 fov, f32 aspectRatio, f32 near, f32 far);
@@ -5,6 +5,8 @@
 #include "core/math/core_math.h"
 #include "core/memory/arena.h"
 #include "core/thread_context.h"
+#include "core/thread_placement.h"
+#include "core/algorithms/radix_sort.h"
 #include "platform/os/gfx/os_gfx_win32.h"
 #include "platform/render/render_core.h"
 #include "platform/render/vulkan/render_vulkan_transitions.h"
@@ -19,12 +21,20 @@ static FrameData& currentFrame() {
   return renderVkState->frames[renderVkState->frameNumber % MAX_FRAMES];
 }
 
+Arena* Render_frameArena() {
+  return currentFrame().arena;
+}
+
 void Render_setViewMatrix(vec3 cameraPosition, f32 pitch, f32 yaw) {
-  renderVkState->viewMatrix = matrixMakeViewFromPitchYaw(cameraPosition, pitch, yaw);
+  renderVkState->frameQueue.building->viewMatrix = matrixMakeViewFromPitchYaw(cameraPosition, pitch, yaw);
 }
 
 void Render_setProjectionMatrix(f32 fov, f32 aspectRatio, f32 nearZ, f32 farZ) {
-  renderVkState->projectionMatrix = matrixMakePerspective(RadFromDeg(fov), aspectRatio, nearZ, farZ);
+  renderVkState->frameQueue.building->projectionMatrix = matrixMakePerspective(RadFromDeg(fov), aspectRatio, nearZ, farZ);
+}
+
+static Handle<GPUMesh> gpuMeshHandle(RenderMeshHandle handle) {
+  return { .index = handle.index, .generation = handle.generation };
 }
 
 VkSemaphore createSemaphore(VkDevice device, VkSemaphoreCreateFlags flags) {
@@ -542,8 +552,9 @@ static u32 selectMemoryType(const VkPhysicalDeviceMemoryProperties& memoryProper
 }
 
 // TODO(piero): We should batch these image uploads and use a transfer queue
-RenderVkImage* createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u8* data, u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage) {
-  RenderVkImage* image = createImage(device, memoryProperties, width, height, mipLevels, format, usage);
+RenderVkImageHandle createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u8* data, u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage) {
+  RenderVkImageHandle handle = createImage(device, memoryProperties, width, height, mipLevels, format, usage);
+  RenderVkImage* image = getImage(handle);
 
   VkCommandPool commandPool = currentFrame().commandPool;
   VkCommandBuffer commandBuffer = currentFrame().commandBuffer;
@@ -590,11 +601,12 @@ RenderVkImage* createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& me
   VK_CHECK(vkQueueSubmit(renderVkState->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
   VK_CHECK(vkDeviceWaitIdle(device));
 
-  return image;
+  return handle;
 }
 
-RenderVkImage* createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage) {
-  RenderVkImage* result = PushStruct(renderVkState->arena, RenderVkImage);
+RenderVkImageHandle createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage) {
+  RenderVkImage* result = nullptr;
+  RenderVkImageHandle handle = slotMapAdd(&renderVkState->images, &result);
 
   VkImageCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
   createInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -631,13 +643,23 @@ RenderVkImage* createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& me
   result->memory = memory;
   result->format = format;
 
-  return result;
+  return handle;
 }
 
-void destroyImage(VkDevice device, RenderVkImage* image) {
+void destroyImage(VkDevice device, RenderVkImageHandle handle) {
+  RenderVkImage* image = getImage(handle);
+  if (image == nullptr) {
+    return;
+  }
+
   vkDestroyImageView(device, image->imageView, nullptr);
   vkDestroyImage(device, image->image, nullptr);
   vkFreeMemory(device, image->memory, nullptr);
+  slotMapRemove(&renderVkState->images, handle);
+}
+
+RenderVkImage* getImage(RenderVkImageHandle handle) {
+  return slotMapGet(&renderVkState->images, handle);
 }
 
 RenderVkBuffer createBuffer(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u32 size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags) {
@@ -966,12 +988,24 @@ VkPipeline buildPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkPip
   return result;
 }
 
-void Render_loadScene(String8 path) {
+RenderMeshHandle Render_loadScene(String8 path) {
   PerfScope;
+  // Uploads go through frame 0's command buffer
+  Assert(!renderVkState->frameQueue.running);
 
   Model* model = parseGLTF(renderVkState->sceneArena, path);
   Assert(model->valid);
 
+  ArenaStats sceneStats = arenaStats(renderVkState->sceneArena);
+  printf("[Render] Scene arena: %llu blocks, %.2fMB used, %.2fMB commited (%.2fMB large pages, %.2fMB THP advised), %llu/%llu pages prefaulted in background\n",
+    sceneStats.blockCount,
+    (f64)sceneStats.used / Megabytes(1),
+    (f64)sceneStats.commited / Megabytes(1),
+    (f64)sceneStats.largePageCommited / Megabytes(1),
+    (f64)sceneStats.hugePageAdvised / Megabytes(1),
+    sceneStats.prefaultPagesAvoided,
+    sceneStats.prefaultPagesAvoided + sceneStats.prefaultPagesTaken);
+
   Temp scratch = ScratchBegin();
 
   VkCommandPool commandPool = renderVkState->frames[0].commandPool;
@@ -985,9 +1019,8 @@ void Render_loadScene(String8 path) {
 
   Geometry* geometry = model->geometry;
 
-  GPUMesh* gpuMesh = PushStruct(renderVkState->arena, GPUMesh);
-  DLLPushBack(renderVkState->firstMesh, renderVkState->lastMesh, gpuMesh);
-  renderVkState->meshCount++;
+  GPUMesh* gpuMesh = nullptr;
+  Handle<GPUMesh> meshHandle = slotMapAdd(&renderVkState->meshes, &gpuMesh);
 
   gpuMesh->vertexBuffer = createBuffer(renderVkState->device, memoryProperties, geometry->vertexCount * sizeof(Vertex), vertexUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
   gpuMesh->indexBuffer = createBuffer(renderVkState->device, memoryProperties, geometry->indexCount * sizeof(u32), indexUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -1006,11 +1039,23 @@ void Render_loadScene(String8 path) {
 
   renderVkState->defaultSampler = createSampler(renderVkState->device, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
 
+  renderVkState->textures = PushArray(renderVkState->sceneArena, RenderVkImageHandle, model->textureCount);
+  renderVkState->textureCount = 0;
+
   for (u32 i = 0; i < model->textureCount; ++i) {
     Texture* texture = &model->textures[i];
 
     // Create image and write to bindless descriptor set
-    RenderVkImage* image = createImage(renderVkState->device, memoryProperties, texture->data, texture->width, texture->height, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    RenderVkImageHandle handle = {};
+    if (texture->isDuplicate) {
+      // Same source image as an earlier texture, share its GPU image
+      handle = renderVkState->textures[texture->duplicateOf];
+    } else {
+      handle = createImage(renderVkState->device, memoryProperties, texture->data, texture->width, texture->height, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+      freeTextureData(texture);
+    }
+    renderVkState->textures[renderVkState->textureCount++] = handle;
+    RenderVkImage* image = getImage(handle);
 
     VkDescriptorImageInfo imageInfo{
       .sampler = renderVkState->defaultSampler,
@@ -1038,8 +1083,18 @@ void Render_loadScene(String8 path) {
 
   MeshDrawCommand* drawCommands = PushArray(scratch.arena, MeshDrawCommand, drawCallCount);
 
+  // Issue draws grouped by material. drawId keeps pointing at the primitive's draw data, so only the order changes.
+  u32* materialKeys = PushArrayNoZero(scratch.arena, u32, drawCallCount);
+  u32* drawOrder = PushArrayNoZero(scratch.arena, u32, drawCallCount);
   for (u32 i = 0; i < drawCallCount; ++i) {
-    drawCommands[i] = {
+    materialKeys[i] = model->drawData[i].materialIndex;
+    drawOrder[i] = i;
+  }
+  radixSortU32(materialKeys, drawOrder, drawCallCount);
+
+  for (u32 d = 0; d < drawCallCount; ++d) {
+    u32 i = drawOrder[d];
+    drawCommands[d] = {
       .drawId = i,
       .indirect = {
         .indexCount = model->primitives[i].indexCount,
@@ -1130,27 +1185,180 @@ void Render_loadScene(String8 path) {
   vkUpdateDescriptorSets(renderVkState->device, ArrayCount(writes), writes, 0, nullptr);
 
   ScratchEnd(scratch);
+  return { .index = meshHandle.index, .generation = meshHandle.generation };
+}
+
+// Frame packets
+
+static RenderFramePacket* frameQueuePop(SpscQueue<RenderFramePacket*>* queue, u32* epoch) {
+  RenderFramePacket* packet = nullptr;
+  while (!spscQueuePop(queue, &packet)) {
+    u32 seen = AtomicLoadU32(epoch);
+    if (spscQueuePop(queue, &packet)) {
+      break;
+    }
+    OS_futexWait(epoch, seen);
+  }
+  return packet;
+}
+
+// Never full, each queue has room for every packet and the stop marker
+static void frameQueuePush(SpscQueue<RenderFramePacket*>* queue, u32* epoch, RenderFramePacket* packet) {
+  b32 pushed = spscQueuePush(queue, packet);
+  Assert(pushed);
+  AtomicAddU32(epoch, 1);
+  OS_futexWakeOne(epoch);
+}
+
+static void recordFrameTimed(RenderFramePacket* packet) {
+  RenderVkFrameQueue* queue = &renderVkState->frameQueue;
+  u64 recordStart = OS_readOSTimer();
+  recordFrame(packet);
+  u64 recordEnd = OS_readOSTimer();
+
+  u64 latency = recordEnd - packet->buildStartTime;
+  AtomicStoreU64(&queue->latencyLast, latency);
+  AtomicStoreU64(&queue->latencyTotal, queue->latencyTotal + latency);
+  AtomicStoreU64(&queue->latencyMax, Max(queue->latencyMax, latency));
+  AtomicStoreU64(&queue->queueWaitTotal, queue->queueWaitTotal + (recordStart - packet->submitTime));
+  AtomicStoreU64(&queue->recordTotal, queue->recordTotal + (recordEnd - recordStart));
+  AtomicStoreU64(&queue->frameCount, queue->frameCount + 1);
+}
+
+static void renderThreadMain(void* params) {
+  // The state pointer is per thread
+  renderVkState = (RenderVkState*)params;
+  RenderVkFrameQueue* queue = &renderVkState->frameQueue;
+
+  for (;;) {
+    RenderFramePacket* packet = frameQueuePop(queue->submitted, &queue->submittedEpoch);
+    if (packet == nullptr) {
+      break;
+    }
+    recordFrameTimed(packet);
+    frameQueuePush(queue->free, &queue->freeEpoch, packet);
+    ThreadCtx_endFrame();
+  }
+}
+
+void Render_startThread(u32 queueDepth) {
+  RenderVkFrameQueue* queue = &renderVkState->frameQueue;
+  if (queue->running) {
+    return;
+  }
+  queueDepth = Max(queueDepth, 1u);
+
+  arenaClear(queue->arena);
+  u32 packetCount = queueDepth + 1;
+  queue->depth = queueDepth;
+  queue->free = spscQueueAlloc<RenderFramePacket*>(queue->arena, packetCount + 1);
+  queue->submitted = spscQueueAlloc<RenderFramePacket*>(queue->arena, packetCount + 1);
+  for (u32 i = 0; i < packetCount; ++i) {
+    RenderFramePacket* packet = PushStruct(queue->arena, RenderFramePacket);
+    packet->arena = arenaAlloc({ .reserveSize = Megabytes(64), .commitSize = Kilobytes(64), .name = Str8L("Frame Packet") });
+    spscQueuePush(queue->free, packet);
+  }
+
+  queue->running = true;
+  queue->thread = OS_threadLaunch(renderThreadMain, renderVkState, {
+    .name = Str8L("Render Thread"),
+    .affinityMask = threadPlacement()->renderMask,
+    .priority = OS_ThreadPriority_High,
+  });
+}
+
+void Render_stopThread() {
+  RenderVkFrameQueue* queue = &renderVkState->frameQueue;
+  if (!queue->running) {
+    return;
+  }
+
+  frameQueuePush(queue->submitted, &queue->submittedEpoch, nullptr);
+  OS_threadJoin(queue->thread);
+  queue->running = false;
+
+  RenderFramePacket* packet = nullptr;
+  while (spscQueuePop(queue->free, &packet)) {
+    arenaRelease(packet->arena);
+  }
+  VK_CHECK(vkDeviceWaitIdle(renderVkState->device));
+}
+
+RenderFrameStats Render_frameStats() {
+  RenderVkFrameQueue* queue = &renderVkState->frameQueue;
+  RenderFrameStats stats = {};
+  stats.frameCount = AtomicLoadU64(&queue->frameCount);
+  stats.queueDepth = queue->running ? queue->depth : 0;
+  if (stats.frameCount == 0) {
+    return stats;
+  }
+
+  f64 toMs = 1000.0 / (f64)OS_getOSTimerFreq();
+  f64 frameCount = (f64)stats.frameCount;
+  stats.lastLatency = AtomicLoadU64(&queue->latencyLast) * toMs;
+  stats.averageLatency = AtomicLoadU64(&queue->latencyTotal) * toMs / frameCount;
+  stats.maxLatency = AtomicLoadU64(&queue->latencyMax) * toMs;
+  stats.averageGameWait = queue->gameWaitTotal * toMs / frameCount;
+  stats.averageQueueWait = AtomicLoadU64(&queue->queueWaitTotal) * toMs / frameCount;
+  stats.averageRecord = AtomicLoadU64(&queue->recordTotal) * toMs / frameCount;
+  return stats;
 }
 
 void Render_startWindow(OSWindowHandle windowHandle, vec2 size) {
-  if (renderVkState->swapchain->needsResize) {
-    recreateSwapchainIfNeeded(windowHandle, size);
-    renderVkState->swapchain->needsResize = false;
+  RenderVkFrameQueue* queue = &renderVkState->frameQueue;
+  Assert(queue->building == nullptr);
+
+  u64 buildStart = OS_readOSTimer();
+  RenderFramePacket* packet = &queue->inlinePacket;
+  if (queue->running) {
+    packet = frameQueuePop(queue->free, &queue->freeEpoch);
+    u64 waitEnd = OS_readOSTimer();
+    queue->gameWaitTotal += waitEnd - buildStart;
+    buildStart = waitEnd;
   }
+
+  // The render thread is done with everything in it
+  arenaClear(packet->arena);
+  packet->frameIndex = queue->frameIndex++;
+  packet->window = windowHandle;
+  packet->windowSize = size;
+  packet->viewMatrix = matrixMakeScale({ 1.0f, 1.0f, 1.0f });
+  packet->projectionMatrix = matrixMakeScale({ 1.0f, 1.0f, 1.0f });
+  arrayInit(&packet->draws, packet->arena);
+  packet->buildStartTime = buildStart;
+  queue->building = packet;
 }
 
-void Render_endWindow(OSWindowHandle windowHandle) {
+void Render_drawMesh(RenderMeshHandle mesh, mat4 transform) {
+  arrayPush(&renderVkState->frameQueue.building->draws, RenderDraw{ .mesh = mesh, .transform = transform });
+}
 
+void Render_endWindow(OSWindowHandle windowHandle) {
+  RenderVkFrameQueue* queue = &renderVkState->frameQueue;
+  RenderFramePacket* packet = queue->building;
+  Assert(packet && packet->window.u64[0] == windowHandle.u64[0]);
+  queue->building = nullptr;
+
+  packet->submitTime = OS_readOSTimer();
+  if (queue->running) {
+    frameQueuePush(queue->submitted, &queue->submittedEpoch, packet);
+  } else {
+    recordFrameTimed(packet);
+  }
 }
 
 // Init subsystem
 void Render_init() {
   PerfScope;
 
-  Arena* arena = arenaAlloc(Gigabytes(4));
+  Arena* arena = ArenaAllocDefault();
   renderVkState = PushStruct(arena, RenderVkState);
   renderVkState->arena = arena;
-  renderVkState->sceneArena = arenaAlloc(Gigabytes(4));
+  slotMapInit(&renderVkState->images, arena, 64);
+  slotMapInit(&renderVkState->meshes, arena, 16);
+  renderVkState->sceneArena = arenaAlloc({ .flags = ArenaFlag_LargePages | ArenaFlag_BackgroundPrefault, .reserveSize = arenaDefaultReserveSize, .commitSize = arenaDefaultCommitSize });
+  renderVkState->frameQueue.arena = arenaAlloc({ .name = Str8L("Render Frame Queue") });
+  renderVkState->frameQueue.inlinePacket.arena = arenaAlloc({ .reserveSize = Megabytes(64), .commitSize = Kilobytes(64), .name = Str8L("Frame Packet") });
 
   VK_CHECK(volkInitialize());
 
@@ -1235,6 +1443,7 @@ void initCommands() {
 
 void initSync() {
   for (int i = 0; i < MAX_FRAMES; i++) {
+    renderVkState->frames[i].arena = ArenaAllocDefault();
     renderVkState->frames[i].renderFence = createFence(renderVkState->device, VK_FENCE_CREATE_SIGNALED_BIT);
     renderVkState->frames[i].renderSemaphore = createSemaphore(renderVkState->device);
     renderVkState->frames[i].swapchainSemaphore = createSemaphore(renderVkState->device);
@@ -1302,13 +1511,23 @@ void initDescriptors() {
 
 void initPipelines() {
   VkShaderModule meshVertexShader = nullptr;
-  if (!loadShaderModule("../res/shaders/triangle.vert.spv", renderVkState->device, &meshVertexShader)) {
-    printf("Error when building the mesh vertex shader");
-  }
   VkShaderModule meshFragmentShader = nullptr;
-  if (!loadShaderModule("../res/shaders/triangle.frag.spv", renderVkState->device, &meshFragmentShader)) {
-    printf("Error when building the mesh fragment shader");
+  Temp scratch = ScratchBegin();
+  {
+    Task<b32> vertexLoad = loadShaderModule(scratch.arena, Str8L("../res/shaders/triangle.vert.spv"), renderVkState->device, &meshVertexShader);
+    Task<b32> fragmentLoad = loadShaderModule(scratch.arena, Str8L("../res/shaders/triangle.frag.spv"), renderVkState->device, &meshFragmentShader);
+    // Both reads are in flight before waiting on either
+    taskStart(&vertexLoad);
+    taskStart(&fragmentLoad);
+    if (!taskWait(&vertexLoad)) {
+      printf("Error when building the mesh vertex shader");
+    }
+    if (!taskWait(&fragmentLoad)) {
+      printf("Error when building the mesh fragment shader");
+    }
   }
+  // The task frames live in scratch, they're destroyed above
+  ScratchEnd(scratch);
 
   VkPushConstantRange range {
     .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -1336,7 +1555,7 @@ void initPipelines() {
     shaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, meshVertexShader),
     shaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, meshFragmentShader)
   };
-  renderVkState->meshPipeline = buildPipeline(renderVkState->device, renderVkState->meshPipelineLayout, shaderStages, ArrayCount(shaderStages), VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE, renderVkState->drawImage->format, renderVkState->depthImage->format, false);
+  renderVkState->meshPipeline = buildPipeline(renderVkState->device, renderVkState->meshPipelineLayout, shaderStages, ArrayCount(shaderStages), VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE, getImage(renderVkState->drawImage)->format, getImage(renderVkState->depthImage)->format, false);
 
   vkDestroyShaderModule(renderVkState->device, meshVertexShader, nullptr);
   vkDestroyShaderModule(renderVkState->device, meshFragmentShader, nullptr);
@@ -1381,15 +1600,21 @@ void Render_equipWindow(OSWindowHandle windowHandle) {
   renderVkState->drawExtent = { .width = width, .height = height };
 
   initPipelines();
-
-  renderVkState->meshPushConstants = PushStruct(renderVkState->arena, MeshPushConstants);
 }
 
-void Render_update() {
+void recordFrame(const RenderFramePacket* packet) {
   PerfScope;
 
+  if (renderVkState->swapchain->needsResize) {
+    recreateSwapchainIfNeeded(packet->window, packet->windowSize);
+    renderVkState->swapchain->needsResize = false;
+  }
+
   VK_CHECK(vkWaitForFences(renderVkState->device, 1, &currentFrame().renderFence, true, 1000000000));
 
+  // The GPU is done with this frame slot, so its allocations can go
+  arenaClear(currentFrame().arena);
+
   u32 swapchainImageIndex{};
   VkResult e = vkAcquireNextImageKHR(renderVkState->device, renderVkState->swapchain->swapchain, 1000000000, currentFrame().swapchainSemaphore, nullptr, &swapchainImageIndex);
   if (e == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -1412,11 +1637,11 @@ void Render_update() {
   // Record commands
   VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
-  VkImageMemoryBarrier2 drawImageBarrier = imageBarrier(renderVkState->drawImage->image,
+  VkImageMemoryBarrier2 drawImageBarrier = imageBarrier(getImage(renderVkState->drawImage)->image,
       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-  VkImageMemoryBarrier2 depthImageBarrier = imageBarrier(renderVkState->depthImage->image,
+  VkImageMemoryBarrier2 depthImageBarrier = imageBarrier(getImage(renderVkState->depthImage)->image,
       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
 
@@ -1427,8 +1652,8 @@ void Render_update() {
   pipelineBarrier(cmd, 0, 0, nullptr, 2, renderBarriers);
 
   VkClearValue clearValue{ .color = { 0.2f, 0.2f, 0.2f, 1.0f } };
-  VkRenderingAttachmentInfo colorAttachment = attachmentInfo(renderVkState->drawImage->imageView, &clearValue, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-  VkRenderingAttachmentInfo depthAttachment = depthAttachmentInfo(renderVkState->depthImage->imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+  VkRenderingAttachmentInfo colorAttachment = attachmentInfo(getImage(renderVkState->drawImage)->imageView, &clearValue, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+  VkRenderingAttachmentInfo depthAttachment = depthAttachmentInfo(getImage(renderVkState->depthImage)->imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 
   VkRenderingInfo renderInfo = renderingInfo(renderVkState->drawExtent, &colorAttachment, &depthAttachment);
   vkCmdBeginRendering(cmd, &renderInfo);
@@ -1453,25 +1678,31 @@ void Render_update() {
 
   vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-  f32 scale = 1.0f;
-  renderVkState->meshPushConstants->viewProj = renderVkState->projectionMatrix * renderVkState->viewMatrix * matrixMakeScale({ scale, scale, scale });
+  MeshPushConstants* meshPushConstants = PushStruct(Render_frameArena(), MeshPushConstants);
+  mat4 viewProj = packet->projectionMatrix * packet->viewMatrix;
 
   // Render meshes
-  for (GPUMesh* mesh = renderVkState->firstMesh; mesh != nullptr; mesh = mesh->next) {
-    renderVkState->meshPushConstants->vertexAddress = mesh->vertexAddress;
+  for (u64 drawIndex = 0; drawIndex < packet->draws.count; ++drawIndex) {
+    const RenderDraw* draw = &packet->draws.data[drawIndex];
+    GPUMesh* mesh = slotMapGet(&renderVkState->meshes, gpuMeshHandle(draw->mesh));
+    if (mesh == nullptr) {
+      continue;
+    }
+    meshPushConstants->viewProj = viewProj * draw->transform;
+    meshPushConstants->vertexAddress = mesh->vertexAddress;
 
     vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, renderVkState->meshPipelineLayout, 0, 1, &renderVkState->drawDataDescriptorSet, 0, nullptr);
     vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, renderVkState->meshPipelineLayout, 1, 1, &renderVkState->bindlessSet, 0, nullptr);
 
     vkCmdBindIndexBuffer(cmd, mesh->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-    vkCmdPushConstants(cmd, renderVkState->meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MeshPushConstants), renderVkState->meshPushConstants);
+    vkCmdPushConstants(cmd, renderVkState->meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MeshPushConstants), meshPushConstants);
     vkCmdDrawIndexedIndirect(cmd, mesh->drawCommandBuffer.buffer, OffsetOf(MeshDrawCommand, indirect), mesh->drawCommandCount, sizeof(MeshDrawCommand));
   }
 
   vkCmdEndRendering(cmd);
 
-  VkImageMemoryBarrier2 copyDrawImageBarrier = imageBarrier(renderVkState->drawImage->image,
+  VkImageMemoryBarrier2 copyDrawImageBarrier = imageBarrier(getImage(renderVkState->drawImage)->image,
       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
 
@@ -1485,7 +1716,7 @@ void Render_update() {
   };
   pipelineBarrier(cmd, 0, 0, nullptr, 2, barriers);
 
-  copyImageToImage(cmd, renderVkState->drawImage->image, renderVkState->swapchain->images[swapchainImageIndex], renderVkState->drawExtent, renderVkState->drawExtent);
+  copyImageToImage(cmd, getImage(renderVkState->drawImage)->image, renderVkState->swapchain->images[swapchainImageIndex], renderVkState->drawExtent, renderVkState->drawExtent);
 
   VkImageMemoryBarrier2 postSwapchainBarrier = imageBarrier(renderVkState->swapchain->images[swapchainImageIndex],
       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -3,7 +3,11 @@
 #include <cstdio>
 #include "core/core_strings.h"
 #include "core/memory/arena.h"
+#include "core/data_structures/slot_map.h"
+#include "core/data_structures/queue.h"
+#include "core/coroutine.h"
 #include "platform/os/core/os_core.h"
+#include "platform/render/render_core.h"
 
 #include "parsers/gltf/parser_gltf_inc.h"
 
@@ -36,6 +40,8 @@ struct RenderVkImage {
   VkFormat format;
 };
 
+using RenderVkImageHandle = Handle<RenderVkImage>;
+
 struct RenderVkBuffer {
   VkBuffer buffer;
   VkDeviceMemory memory;
@@ -44,6 +50,10 @@ struct RenderVkBuffer {
 };
 
 struct FrameData {
+  // Frame-lifetime allocations. Cleared once this frame's renderFence signals, so anything the GPU may
+  // still read from the previous use of this slot stays valid until then.
+  Arena* arena;
+
   VkCommandPool commandPool;
   VkCommandBuffer commandBuffer;
 
@@ -70,9 +80,6 @@ struct alignas(16) MeshDrawData {
 };
 
 struct GPUMesh {
-  GPUMesh* next;
-  GPUMesh* prev;
-
   RenderVkBuffer vertexBuffer;
   RenderVkBuffer indexBuffer;
   VkDeviceAddress vertexAddress;
@@ -93,6 +100,37 @@ struct GPUMesh {
   u32 materialCount;
 };
 
+// NOTE(piero): Packets circle between two SPSC queues, free ones from the render thread back to the game thread and
+//              built ones the other way. There are queueDepth + 1 of them, one is always the game thread's to build.
+//              Each side sleeps on the other's epoch when its queue is empty.
+struct RenderVkFrameQueue {
+  Arena* arena;
+  OS_Handle thread;
+  b32 running;
+  u32 depth;
+
+  SpscQueue<RenderFramePacket*>* free;
+  // A null packet stops the render thread
+  SpscQueue<RenderFramePacket*>* submitted;
+  u32 freeEpoch;
+  u32 submittedEpoch;
+
+  // Game thread
+  RenderFramePacket* building;
+  // Used while the render thread isn't running
+  RenderFramePacket inlinePacket;
+  u64 frameIndex;
+  u64 gameWaitTotal;
+
+  // Written by whichever thread records, OS timer ticks
+  u64 frameCount;
+  u64 latencyLast;
+  u64 latencyTotal;
+  u64 latencyMax;
+  u64 queueWaitTotal;
+  u64 recordTotal;
+};
+
 struct RenderVkState {
   Arena* arena;
   Arena* sceneArena;
@@ -107,12 +145,12 @@ struct RenderVkState {
   OSWindowHandle window;
   RenderVkSwapchain* swapchain;
 
-  RenderVkImage* drawImage;
-  RenderVkImage* depthImage;
+  // All images are owned by `images`, everything else refers to them by handle
+  SlotMap<RenderVkImage> images;
+  RenderVkImageHandle drawImage;
+  RenderVkImageHandle depthImage;
   VkExtent2D drawExtent;
 
-  MeshPushConstants* meshPushConstants;
-
   VkSampler defaultSampler;
 
   // Descriptors
@@ -131,16 +169,15 @@ struct RenderVkState {
   VkPipelineLayout meshPipelineLayout;
 
   // Renderable meshes
-  GPUMesh* firstMesh;
-  GPUMesh* lastMesh;
-  u32 meshCount;
+  SlotMap<GPUMesh> meshes;
+  // Scene textures, in bindless descriptor order
+  RenderVkImageHandle* textures;
+  u32 textureCount;
 
   RenderVkBuffer scratchBuffer;
 
-  mat4 viewMatrix;
-  mat4 projectionMatrix;
+  RenderVkFrameQueue frameQueue;
 
-  Arena* frameArena;
   FrameData frames[MAX_FRAMES];
   u32 frameNumber;
 };
@@ -197,9 +234,11 @@ VkQueryPool createQueryPool(VkDevice device, uint32_t queryCount, VkQueryType qu
 static u32 selectMemoryType(const VkPhysicalDeviceMemoryProperties& memoryProperties, u32 memoryTypeBits, VkMemoryPropertyFlags flags);
 
 VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, u32 mipLevel, u32 levelCount);
-RenderVkImage* createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage);
-RenderVkImage* createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u8* data, u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage);
-void destroyImage(VkDevice device, RenderVkImage* image);
+RenderVkImageHandle createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage);
+RenderVkImageHandle createImage(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u8* data, u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage);
+void destroyImage(VkDevice device, RenderVkImageHandle handle);
+// Returns nullptr for destroyed images
+RenderVkImage* getImage(RenderVkImageHandle handle);
 
 RenderVkBuffer createBuffer(VkDevice device, VkPhysicalDeviceMemoryProperties& memoryProperties, u32 size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags);
 void uploadBuffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer commandBuffer, VkQueue queue, const RenderVkBuffer& buffer, const RenderVkBuffer& scratch, void* data, u32 size);
@@ -226,6 +265,9 @@ SwapchainStatus recreateSwapchain(RenderVkSwapchain* oldSwapchain, VkPhysicalDev
 // Compares the passed in size with the stored state window's size to see if a swapchain recreation is necessary
 void recreateSwapchainIfNeeded(OSWindowHandle windowHandle, vec2 size);
 
+// Records and submits the packet on the calling thread
+void recordFrame(const RenderFramePacket* packet);
+
 // init helpers
 void initCommands();
 void initSync();
@@ -1,51 +1,31 @@
 #pragma once
 
-#include <fstream>
-#include <vector>
 #include <volk/volk.h>
 
+#include "core/coroutine.h"
 
-inline bool loadShaderModule(const char* filePath, VkDevice device, VkShaderModule* outShaderModule) {
-  std::ifstream file(filePath, std::ios::ate | std::ios::binary);
 
-  if (!file.is_open()) {
-    return false;
+// The file is read through the async I/O queue that taskPoll submits and completes, the module is created on the
+// thread running taskPoll once the read finishes
+inline Task<b32> loadShaderModule(Arena* arena, String8 filePath, VkDevice device, VkShaderModule* outShaderModule) {
+  String8 code = co_await taskReadFile(arena, filePath);
+  // SPIR-V is a stream of u32 words
+  if (code.size == 0 || code.size % sizeof(u32) != 0) {
+    co_return false;
   }
 
-  // find what the size of the file is by looking up the location of the cursor
-  // because the cursor is at the end, it gives the size directly in bytes
-  size_t fileSize = (size_t)file.tellg();
-
-  // spirv expects the buffer to be on uint32, so make sure to reserve a int
-  // vector big enough for the entire file
-  std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
-
-  // put file cursor at beginning
-  file.seekg(0);
-
-  // load the entire file into the buffer
-  file.read((char*)buffer.data(), fileSize);
-
-  // now that the file is loaded into the buffer, we can close it
-  file.close();
-
-  // create a new shader module, using the buffer we loaded
   VkShaderModuleCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   createInfo.pNext = nullptr;
+  createInfo.codeSize = code.size;
+  createInfo.pCode = (u32*)code.str;
 
-  // codeSize has to be in bytes, so multply the ints in the buffer by size of
-  // int to know the real size of the buffer
-  createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-  createInfo.pCode = buffer.data();
-
-  // check that the creation goes well.
   VkShaderModule shaderModule = nullptr;
   if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-    return false;
+    co_return false;
   }
   *outShaderModule = shaderModule;
-  return true;
+  co_return true;
 }
 
 inline VkPipelineShaderStageCreateInfo shaderStageCreateInfo(VkShaderStageFlagBits stage, VkShaderModule shaderModule) {